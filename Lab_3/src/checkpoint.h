@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#define CHECKPOINT_MAGIC 0x4B504331u // "1CPK"
+#define CHECKPOINT_VERSION 1u
+#define CHECKPOINT_SLOT_SIZE 4096   // One page per slot, so flushing one slot never touches the other
+#define CHECKPOINT_SLOTS 2
+
+// One checkpoint slot, the file holds two of them and writes alternate between them
+struct CheckpointSlot {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t generation;   // Increases with every checkpoint, the newest valid slot wins
+    std::int64_t counter;
+    std::int64_t savedAtMs;     // Wall clock time of the checkpoint (ms since epoch)
+    std::uint64_t updateCount;
+    std::uint32_t checksum;     // CRC-32 of all fields above
+};
+
+// File-backed mapping of the checkpoint slots
+struct CheckpointFile {
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+    unsigned char* base;
+    std::uint64_t generation;   // Generation of the last written or restored slot
+};
+
+// CRC-32 (IEEE 802.3, reflected)
+inline std::uint32_t checkpoint_crc32(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+inline std::uint32_t checkpoint_slot_checksum(const CheckpointSlot* slot) {
+    return checkpoint_crc32(slot, offsetof(CheckpointSlot, checksum));
+}
+
+inline CheckpointSlot* checkpoint_slot(CheckpointFile* checkpoint, int index) {
+    return reinterpret_cast<CheckpointSlot*>(checkpoint->base + index * CHECKPOINT_SLOT_SIZE);
+}
+
+inline bool checkpoint_slot_valid(const CheckpointSlot* slot) {
+    return slot->magic == CHECKPOINT_MAGIC && slot->version == CHECKPOINT_VERSION &&
+           slot->checksum == checkpoint_slot_checksum(slot);
+}
+
+// Open (or create) the checkpoint file and map it
+inline bool open_checkpoint_file(CheckpointFile* checkpoint, const std::string& path) {
+    const size_t size = CHECKPOINT_SLOT_SIZE * CHECKPOINT_SLOTS;
+    checkpoint->base = nullptr;
+    checkpoint->generation = 0;
+#ifdef _WIN32
+    checkpoint->file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (checkpoint->file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    checkpoint->mapping = CreateFileMappingA(checkpoint->file, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(size), NULL);
+    if (checkpoint->mapping == NULL) {
+        CloseHandle(checkpoint->file);
+        return false;
+    }
+    checkpoint->base = static_cast<unsigned char*>(MapViewOfFile(checkpoint->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+    if (checkpoint->base == nullptr) {
+        CloseHandle(checkpoint->mapping);
+        CloseHandle(checkpoint->file);
+        return false;
+    }
+#else
+    checkpoint->fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (checkpoint->fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(checkpoint->fd, &st) == -1 || (static_cast<size_t>(st.st_size) < size && ftruncate(checkpoint->fd, size) == -1)) {
+        close(checkpoint->fd);
+        return false;
+    }
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, checkpoint->fd, 0);
+    if (base == MAP_FAILED) {
+        close(checkpoint->fd);
+        return false;
+    }
+    checkpoint->base = static_cast<unsigned char*>(base);
+#endif
+    return true;
+}
+
+// Find the newest consistent slot, returns false if the file holds no valid checkpoint
+inline bool restore_checkpoint(CheckpointFile* checkpoint, CheckpointSlot* restored) {
+    const CheckpointSlot* newest = nullptr;
+    for (int i = 0; i < CHECKPOINT_SLOTS; ++i) {
+        const CheckpointSlot* slot = checkpoint_slot(checkpoint, i);
+        if (checkpoint_slot_valid(slot) && (newest == nullptr || slot->generation > newest->generation)) {
+            newest = slot;
+        }
+    }
+    if (newest == nullptr) {
+        return false;
+    }
+    *restored = *newest;
+    checkpoint->generation = newest->generation;
+    return true;
+}
+
+// Write the next generation into the older slot and flush it to disk
+inline bool write_checkpoint(CheckpointFile* checkpoint, std::int64_t counter, std::int64_t savedAtMs, std::uint64_t updateCount) {
+    std::uint64_t generation = checkpoint->generation + 1;
+    CheckpointSlot slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.magic = CHECKPOINT_MAGIC;
+    slot.version = CHECKPOINT_VERSION;
+    slot.generation = generation;
+    slot.counter = counter;
+    slot.savedAtMs = savedAtMs;
+    slot.updateCount = updateCount;
+    slot.checksum = checkpoint_slot_checksum(&slot);
+
+    int index = static_cast<int>(generation % CHECKPOINT_SLOTS);
+    CheckpointSlot* target = checkpoint_slot(checkpoint, index);
+    memcpy(target, &slot, sizeof(slot));
+#ifdef _WIN32
+    if (!FlushViewOfFile(target, CHECKPOINT_SLOT_SIZE) || !FlushFileBuffers(checkpoint->file)) {
+        return false;
+    }
+#else
+    if (msync(target, CHECKPOINT_SLOT_SIZE, MS_SYNC) == -1) {
+        return false;
+    }
+#endif
+    checkpoint->generation = generation;
+    return true;
+}
+
+// Unmap and close the checkpoint file
+inline void close_checkpoint_file(CheckpointFile* checkpoint) {
+    const size_t size = CHECKPOINT_SLOT_SIZE * CHECKPOINT_SLOTS;
+#ifdef _WIN32
+    if (checkpoint->base != nullptr) UnmapViewOfFile(checkpoint->base);
+    CloseHandle(checkpoint->mapping);
+    CloseHandle(checkpoint->file);
+#else
+    if (checkpoint->base != nullptr) munmap(checkpoint->base, size);
+    close(checkpoint->fd);
+#endif
+    checkpoint->base = nullptr;
+}
@@ -20,20 +20,18 @@
     #include <pthread.h>
 #endif
 
+#include "shared_data.h"
+#include "lock_profiler.h"
+
 // IPC Constants
 #define SHM_NAME "my_shared_memory"
 #define MUTEX_NAME "my_mutex"
 
-//Shared data
-struct SharedData {
-    std::int64_t counter;
-};
-
 // Cross-platform shared memory & mutex functions
 void* create_shared_memory(size_t size);
 void* map_shared_memory(void* shm);
 bool create_mutex(void** mutex);
-bool lock_mutex(void* mutex);
+bool lock_mutex(void* mutex, int site = LOCK_SITE_UNKNOWN);
 void unlock_mutex(void* mutex);
 void close_shared_memory(void* shm, void* sharedData);
 void close_mutex(void* mutex);
@@ -63,6 +61,8 @@ int main() {
            close_shared_memory(shm, nullptr);
         return 1;
     }
+    lock_profile_attach(&sharedData->lockProfile, "child2", getpid());
+
     //Mutex
     void* mutex = nullptr;
     if (!create_mutex(&mutex)) {
@@ -86,22 +86,25 @@ int main() {
     std::stringstream startMessage;
     startMessage << "Child 2 started. PID: " << getpid() << ", Time: " << get_current_time_ms() << std::endl;
     log_message(logFile, startMessage.str());
+    shared_table_add(&sharedData->table, "child2.runs", 1);
+    shared_table_set(&sharedData->table, "child2.status", 1); // Running
     
     //Modify counter
-    lock_mutex(mutex);
-    sharedData->counter *= 2;
+    lock_mutex(mutex, LOCK_SITE_CHILD2);
+    write_shared_counter(sharedData, read_counter_locked(sharedData) * 2);
     unlock_mutex(mutex);
     
     sleep_for_seconds(2);
 
-    lock_mutex(mutex);
-    sharedData->counter /= 2;
+    lock_mutex(mutex, LOCK_SITE_CHILD2);
+    write_shared_counter(sharedData, read_counter_locked(sharedData) / 2);
     unlock_mutex(mutex);
 
 
     std::stringstream exitMessage;
     exitMessage << "Child 2 exiting. PID: " << getpid() << ", Time: " << get_current_time_ms() << std::endl;
     log_message(logFile,exitMessage.str());
+    shared_table_set(&sharedData->table, "child2.status", 0); // Exited
 
     close_mutex(mutex);
     close_shared_memory(shm, sharedData);
@@ -183,16 +186,19 @@ std::string get_current_time_ms() {
         return true;
     }
 
-    bool lock_mutex(void* mutex) {
+    bool lock_mutex(void* mutex, int site) {
         HANDLE hMutex = static_cast<HANDLE>(mutex);
+        std::uint64_t waitStart = lock_profile_wait_begin();
         if (WaitForSingleObject(hMutex, INFINITE) == WAIT_FAILED) {
             return false;
         }
+        lock_profile_acquired(site, waitStart);
         return true;
     }
 
     void unlock_mutex(void* mutex) {
         HANDLE hMutex = static_cast<HANDLE>(mutex);
+        lock_profile_release();
         ReleaseMutex(hMutex);
     }
 
@@ -233,16 +239,19 @@ std::string get_current_time_ms() {
         return true;
     }
 
-    bool lock_mutex(void* mutex) {
+    bool lock_mutex(void* mutex, int site) {
         sem_t* sem = static_cast<sem_t*>(mutex);
+        std::uint64_t waitStart = lock_profile_wait_begin();
         if(sem_wait(sem) == -1){
         return false;
         }
+        lock_profile_acquired(site, waitStart);
         return true;
     }
 
     void unlock_mutex(void* mutex) {
         sem_t* sem = static_cast<sem_t*>(mutex);
+        lock_profile_release();
         sem_post(sem);
     }
 
@@ -0,0 +1,173 @@
+// Observer of the shared counter: sleeps until a relevant change happens and prints it
+// Usage: counter_watch [any | above <value> | below <value> | crossing <value>]
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <cstdint>
+#include <cstdlib>
+#include <csignal>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+#endif
+
+#include "shared_data.h"
+
+// IPC Constants
+#define SHM_NAME "my_shared_memory"
+#define WAIT_TIMEOUT_MS 500 // Wake up periodically to check for Ctrl+C
+
+volatile sig_atomic_t need_exit = 0; // Flag for program termination
+
+bool parse_predicate(int argc, char* argv[], NotifyPredicate* predicate, std::int64_t* threshold); // Parse the subscription predicate from the command line
+SharedData* attach_shared_data(void** shm); // Open and map the existing shared memory segment (Windows, Linux)
+void detach_shared_data(void* shm, SharedData* sharedData); // Unmap and close the shared memory segment (Windows, Linux)
+std::string format_time_ms(std::int64_t timeMs); // Format ms since epoch as YYYY-MM-DD hh:mm:ss.sss
+
+#ifdef _WIN32
+    BOOL WINAPI sig_handler(DWORD signal); // Ctrl+C handler (Windows)
+#else
+    void sig_handler(int sig); // SIGINT handler (Linux)
+#endif
+
+
+int main(int argc, char* argv[]) {
+    NotifyPredicate predicate;
+    std::int64_t threshold;
+    if (!parse_predicate(argc, argv, &predicate, &threshold)) {
+        std::cerr << "Usage: " << argv[0] << " [any | above <value> | below <value> | crossing <value>]" << std::endl;
+        return 1;
+    }
+
+#ifdef _WIN32
+    SetConsoleCtrlHandler(sig_handler, TRUE);
+#else
+    struct sigaction act;
+    act.sa_handler = sig_handler;
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = 0;
+    sigaction(SIGINT, &act, NULL);
+#endif
+
+    void* shm = nullptr;
+    SharedData* sharedData = attach_shared_data(&shm);
+    if (sharedData == nullptr) {
+        std::cerr << "Failed to attach to shared memory (is main running?)" << std::endl;
+        return 1;
+    }
+
+    int slot = notify_subscribe(&sharedData->notify, current_process_id(), predicate, threshold);
+    if (slot < 0) {
+        std::cerr << "No free subscription slots" << std::endl;
+        detach_shared_data(shm, sharedData);
+        return 1;
+    }
+    std::uint32_t seenSeq = sharedData->notify.subscribers[slot].wakeSeq.load();
+
+    while (!need_exit) {
+        if (!notify_wait(&sharedData->notify, slot, &seenSeq, WAIT_TIMEOUT_MS)) {
+            continue;
+        }
+        SharedSnapshot snapshot = read_shared_snapshot(sharedData);
+        std::cout << format_time_ms(snapshot.lastUpdateMs) << " - Counter: " << snapshot.counter
+                  << " (updates: " << snapshot.updateCount << ", writer: " << snapshot.lastWriterPid << ")" << std::endl;
+    }
+
+    notify_unsubscribe(&sharedData->notify, slot);
+    detach_shared_data(shm, sharedData);
+    return 0;
+}
+
+
+bool parse_predicate(int argc, char* argv[], NotifyPredicate* predicate, std::int64_t* threshold) {
+    *predicate = NotifyPredicate::ANY_CHANGE;
+    *threshold = 0;
+    if (argc < 2) return true;
+    std::string kind = argv[1];
+    if (kind == "any") return argc == 2;
+    if (argc != 3) return false;
+    if (kind == "above") *predicate = NotifyPredicate::ABOVE;
+    else if (kind == "below") *predicate = NotifyPredicate::BELOW;
+    else if (kind == "crossing") *predicate = NotifyPredicate::CROSSING;
+    else return false;
+    try {
+        *threshold = std::stoll(argv[2]);
+    }
+    catch (std::exception const& ex) {
+        return false;
+    }
+    return true;
+}
+
+std::string format_time_ms(std::int64_t timeMs) {
+    std::time_t timeSec = static_cast<std::time_t>(timeMs / 1000);
+    std::tm timeInfo;
+#ifdef _WIN32
+    localtime_s(&timeInfo, &timeSec);
+#else
+    localtime_r(&timeSec, &timeInfo);
+#endif
+    std::ostringstream oss;
+    oss << std::put_time(&timeInfo, "%Y-%m-%d %H:%M:%S") << "." << std::setfill('0') << std::setw(3) << (timeMs % 1000);
+    return oss.str();
+}
+
+#ifdef _WIN32
+    BOOL WINAPI sig_handler(DWORD signal) {
+        if (signal == CTRL_C_EVENT) {
+            need_exit = 1;
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    SharedData* attach_shared_data(void** shm) {
+        HANDLE hMapFile = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, SHM_NAME);
+        if (hMapFile == NULL) {
+            return nullptr;
+        }
+        void* shmem_ptr = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (shmem_ptr == NULL) {
+            CloseHandle(hMapFile);
+            return nullptr;
+        }
+        *shm = hMapFile;
+        return static_cast<SharedData*>(shmem_ptr);
+    }
+
+    void detach_shared_data(void* shm, SharedData* sharedData) {
+        UnmapViewOfFile(sharedData);
+        CloseHandle(static_cast<HANDLE>(shm));
+    }
+#else
+    void sig_handler(int sig) {
+        if (sig == SIGINT)
+            need_exit = 1;
+    }
+
+    SharedData* attach_shared_data(void** shm) {
+        int shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
+        if (shm_fd == -1) {
+            return nullptr;
+        }
+        void* shmem_ptr = mmap(NULL, sizeof(SharedData), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        if (shmem_ptr == MAP_FAILED) {
+            close(shm_fd);
+            return nullptr;
+        }
+        *shm = reinterpret_cast<void*>(static_cast<intptr_t>(shm_fd));
+        return static_cast<SharedData*>(shmem_ptr);
+    }
+
+    void detach_shared_data(void* shm, SharedData* sharedData) {
+        munmap(sharedData, sizeof(SharedData));
+        close(static_cast<int>(reinterpret_cast<intptr_t>(shm)));
+    }
+#endif
@@ -0,0 +1,475 @@
+// Benchmark of cross-process primitives for the shared counter update (Linux only)
+// Usage: ipc_benchmark [iterations_per_process] [max_processes] [primitive]
+// Results are printed to stdout as JSON, progress goes to stderr.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+
+#define BENCH_SEMAPHORE_NAME "/ipc_benchmark_sem"
+#define DEFAULT_ITERATIONS 20000
+#define DEFAULT_MAX_PROCESSES 64
+#define MAX_PROCESSES 64
+
+enum class Primitive {
+    NAMED_SEMAPHORE,
+    ROBUST_MUTEX,
+    FUTEX,
+    ATOMIC_CAS,
+    SHARDED,
+    PIPE,
+    UNIX_SOCKET
+};
+
+const Primitive ALL_PRIMITIVES[] = {
+    Primitive::NAMED_SEMAPHORE, Primitive::ROBUST_MUTEX, Primitive::FUTEX, Primitive::ATOMIC_CAS,
+    Primitive::SHARDED, Primitive::PIPE, Primitive::UNIX_SOCKET
+};
+
+struct alignas(64) ShardSlot { // One cache line per process
+    std::atomic<std::int64_t> value;
+};
+
+struct BenchArena { // Shared between the parent and all forked workers
+    alignas(64) std::atomic<std::int64_t> counter;
+    alignas(64) pthread_mutex_t mutex;
+    alignas(64) std::atomic<std::uint32_t> futexWord;
+    alignas(64) std::atomic<std::uint32_t> readyCount;
+    std::atomic<std::uint32_t> go;
+    ShardSlot shards[MAX_PROCESSES];
+};
+
+struct BenchResult { // Result of one configuration
+    Primitive primitive;
+    int processes;
+    bool pinned;
+    std::uint64_t ops;
+    double elapsedSec;
+    std::uint64_t p50Ns;
+    std::uint64_t p99Ns;
+    std::uint64_t maxNs;
+    double meanNs;
+    bool counterOk;
+};
+
+struct RoundTripChannel { // Request/reply descriptors of one worker (pipe or socket)
+    int workerRead;
+    int workerWrite;
+    int serverRead;
+    int serverWrite;
+};
+
+const char* primitive_name(Primitive primitive); // Name of the primitive used in the JSON output
+bool parse_primitive(const std::string& name, Primitive* primitive); // Parse a primitive name from the command line
+std::uint64_t now_ns(); // Monotonic time in nanoseconds
+void pin_to_cpu(int index); // Pin the calling process to CPU (index % online CPUs)
+void futex_lock(std::atomic<std::uint32_t>* word); // Lock a futex based mutex (0 - free, 1 - locked, 2 - contended)
+void futex_unlock(std::atomic<std::uint32_t>* word); // Unlock a futex based mutex
+bool write_full(int fd, const void* data, size_t size); // Write the whole buffer, retrying on partial writes
+bool read_full(int fd, void* data, size_t size); // Read the whole buffer, retrying on partial reads
+bool open_channels(Primitive primitive, std::vector<RoundTripChannel>& channels, int count); // Create a pipe pair or socketpair per worker
+void close_channels(std::vector<RoundTripChannel>& channels); // Close all channel descriptors
+void run_counter_server(BenchArena* arena, std::vector<RoundTripChannel>& channels, std::uint64_t totalRequests); // Serve counter increments over pipes/sockets
+void run_worker(Primitive primitive, BenchArena* arena, sem_t* sem, RoundTripChannel* channel, int index, bool pinned, int iterations, std::uint64_t* latencies); // Worker process body
+bool run_configuration(Primitive primitive, int processes, bool pinned, int iterations, BenchArena* arena, std::uint64_t* latencies, BenchResult* result); // Run one primitive/process-count/pinning combination
+void print_results_json(const std::vector<BenchResult>& results, int iterations); // Print all results as JSON
+
+
+int main(int argc, char* argv[]) {
+    int iterations = DEFAULT_ITERATIONS;
+    int maxProcesses = DEFAULT_MAX_PROCESSES;
+    std::vector<Primitive> primitives(std::begin(ALL_PRIMITIVES), std::end(ALL_PRIMITIVES));
+
+    if (argc > 1) iterations = std::atoi(argv[1]);
+    if (argc > 2) maxProcesses = std::atoi(argv[2]);
+    if (argc > 3) {
+        Primitive primitive;
+        if (!parse_primitive(argv[3], &primitive)) {
+            std::cerr << "Unknown primitive: " << argv[3] << std::endl;
+            return EXIT_FAILURE;
+        }
+        primitives.assign(1, primitive);
+    }
+    if (iterations <= 0 || maxProcesses <= 0 || maxProcesses > MAX_PROCESSES) {
+        std::cerr << "Usage: " << argv[0] << " [iterations_per_process] [max_processes (1-" << MAX_PROCESSES << ")] [primitive]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<int> processCounts; // 1, 2, 4, ... and always max_processes
+    for (int processes = 1; processes < maxProcesses; processes *= 2) processCounts.push_back(processes);
+    processCounts.push_back(maxProcesses);
+
+    void* arenaPtr = mmap(NULL, sizeof(BenchArena), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    size_t latenciesSize = sizeof(std::uint64_t) * static_cast<size_t>(iterations) * maxProcesses;
+    void* latenciesPtr = mmap(NULL, latenciesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (arenaPtr == MAP_FAILED || latenciesPtr == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    BenchArena* arena = static_cast<BenchArena*>(arenaPtr);
+    std::uint64_t* latencies = static_cast<std::uint64_t*>(latenciesPtr);
+
+    std::vector<BenchResult> results;
+    for (Primitive primitive : primitives) {
+        for (int processes : processCounts) {
+            for (bool pinned : {false, true}) {
+                BenchResult result;
+                std::cerr << primitive_name(primitive) << ": " << processes << " process(es), "
+                          << (pinned ? "pinned" : "unpinned") << std::endl;
+                if (!run_configuration(primitive, processes, pinned, iterations, arena, latencies, &result)) {
+                    std::cerr << "Benchmark failed for " << primitive_name(primitive) << std::endl;
+                    continue;
+                }
+                results.push_back(result);
+            }
+        }
+    }
+    print_results_json(results, iterations);
+
+    munmap(latenciesPtr, latenciesSize);
+    munmap(arenaPtr, sizeof(BenchArena));
+    return 0;
+}
+
+
+const char* primitive_name(Primitive primitive) {
+    switch (primitive) {
+    case Primitive::NAMED_SEMAPHORE: return "named_semaphore";
+    case Primitive::ROBUST_MUTEX: return "robust_mutex";
+    case Primitive::FUTEX: return "futex";
+    case Primitive::ATOMIC_CAS: return "atomic_cas";
+    case Primitive::SHARDED: return "sharded_counter";
+    case Primitive::PIPE: return "pipe_round_trip";
+    case Primitive::UNIX_SOCKET: return "unix_socket_round_trip";
+    }
+    return "unknown";
+}
+
+bool parse_primitive(const std::string& name, Primitive* primitive) {
+    for (Primitive candidate : ALL_PRIMITIVES) {
+        if (name == primitive_name(candidate)) {
+            *primitive = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+void pin_to_cpu(int index) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cpus, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+        perror("sched_setaffinity");
+    }
+}
+
+void futex_lock(std::atomic<std::uint32_t>* word) {
+    std::uint32_t state = 0;
+    if (word->compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+        return;
+    }
+    if (state != 2) {
+        state = word->exchange(2, std::memory_order_acquire);
+    }
+    while (state != 0) {
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAIT, 2, NULL, NULL, 0);
+        state = word->exchange(2, std::memory_order_acquire);
+    }
+}
+
+void futex_unlock(std::atomic<std::uint32_t>* word) {
+    if (word->exchange(0, std::memory_order_release) == 2) {
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+}
+
+bool write_full(int fd, const void* data, size_t size) {
+    const char* ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(fd, ptr, size);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        ptr += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool read_full(int fd, void* data, size_t size) {
+    char* ptr = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t bytesRead = read(fd, ptr, size);
+        if (bytesRead == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (bytesRead == 0) return false;
+        ptr += bytesRead;
+        size -= bytesRead;
+    }
+    return true;
+}
+
+bool open_channels(Primitive primitive, std::vector<RoundTripChannel>& channels, int count) {
+    channels.clear();
+    for (int i = 0; i < count; ++i) {
+        RoundTripChannel channel;
+        if (primitive == Primitive::PIPE) {
+            int request[2], reply[2];
+            if (pipe(request) == -1) return false;
+            if (pipe(reply) == -1) {
+                close(request[0]);
+                close(request[1]);
+                return false;
+            }
+            channel = {reply[0], request[1], request[0], reply[1]};
+        } else {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == -1) return false;
+            channel = {pair[0], pair[0], pair[1], pair[1]};
+        }
+        channels.push_back(channel);
+    }
+    return true;
+}
+
+void close_channels(std::vector<RoundTripChannel>& channels) {
+    for (RoundTripChannel& channel : channels) {
+        close(channel.workerRead);
+        if (channel.workerWrite != channel.workerRead) close(channel.workerWrite);
+        close(channel.serverRead);
+        if (channel.serverWrite != channel.serverRead) close(channel.serverWrite);
+    }
+    channels.clear();
+}
+
+void run_counter_server(BenchArena* arena, std::vector<RoundTripChannel>& channels, std::uint64_t totalRequests) {
+    std::vector<struct pollfd> fds(channels.size());
+    for (size_t i = 0; i < channels.size(); ++i) {
+        fds[i].fd = channels[i].serverRead;
+        fds[i].events = POLLIN;
+    }
+    std::uint64_t served = 0;
+    while (served < totalRequests) {
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return;
+        }
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if ((fds[i].revents & POLLIN) == 0) continue;
+            std::int64_t delta;
+            if (!read_full(channels[i].serverRead, &delta, sizeof(delta))) return;
+            std::int64_t value = arena->counter.load(std::memory_order_relaxed) + delta;
+            arena->counter.store(value, std::memory_order_relaxed);
+            if (!write_full(channels[i].serverWrite, &value, sizeof(value))) return;
+            ++served;
+        }
+    }
+}
+
+void run_worker(Primitive primitive, BenchArena* arena, sem_t* sem, RoundTripChannel* channel, int index, bool pinned, int iterations, std::uint64_t* latencies) {
+    if (pinned) pin_to_cpu(index);
+
+    arena->readyCount.fetch_add(1, std::memory_order_acq_rel);
+    while (arena->go.load(std::memory_order_acquire) == 0) {
+        sched_yield();
+    }
+
+    for (int i = 0; i < iterations; ++i) {
+        std::uint64_t start = now_ns();
+        switch (primitive) {
+        case Primitive::NAMED_SEMAPHORE:
+            sem_wait(sem);
+            arena->counter.store(arena->counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            sem_post(sem);
+            break;
+        case Primitive::ROBUST_MUTEX:
+            if (pthread_mutex_lock(&arena->mutex) == EOWNERDEAD) {
+                pthread_mutex_consistent(&arena->mutex);
+            }
+            arena->counter.store(arena->counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            pthread_mutex_unlock(&arena->mutex);
+            break;
+        case Primitive::FUTEX:
+            futex_lock(&arena->futexWord);
+            arena->counter.store(arena->counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            futex_unlock(&arena->futexWord);
+            break;
+        case Primitive::ATOMIC_CAS: {
+            std::int64_t value = arena->counter.load(std::memory_order_relaxed);
+            while (!arena->counter.compare_exchange_weak(value, value + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+            }
+            break;
+        }
+        case Primitive::SHARDED:
+            arena->shards[index].value.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case Primitive::PIPE:
+        case Primitive::UNIX_SOCKET: {
+            std::int64_t delta = 1, reply;
+            if (!write_full(channel->workerWrite, &delta, sizeof(delta)) || !read_full(channel->workerRead, &reply, sizeof(reply))) {
+                _exit(1);
+            }
+            break;
+        }
+        }
+        latencies[i] = now_ns() - start;
+    }
+}
+
+bool run_configuration(Primitive primitive, int processes, bool pinned, int iterations, BenchArena* arena, std::uint64_t* latencies, BenchResult* result) {
+    memset(static_cast<void*>(arena), 0, sizeof(BenchArena));
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&arena->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    sem_t* sem = SEM_FAILED;
+    if (primitive == Primitive::NAMED_SEMAPHORE) {
+        sem_unlink(BENCH_SEMAPHORE_NAME);
+        sem = sem_open(BENCH_SEMAPHORE_NAME, O_CREAT | O_EXCL, 0600, 1);
+        if (sem == SEM_FAILED) {
+            perror("sem_open");
+            return false;
+        }
+        sem_unlink(BENCH_SEMAPHORE_NAME);
+    }
+
+    bool roundTrip = primitive == Primitive::PIPE || primitive == Primitive::UNIX_SOCKET;
+    std::vector<RoundTripChannel> channels;
+    if (roundTrip && !open_channels(primitive, channels, processes)) {
+        perror("pipe/socketpair");
+        close_channels(channels);
+        return false;
+    }
+
+    std::uint64_t totalOps = static_cast<std::uint64_t>(processes) * iterations;
+    std::vector<pid_t> pids;
+    pid_t serverPid = -1;
+    if (roundTrip) {
+        serverPid = fork();
+        if (serverPid == 0) {
+            run_counter_server(arena, channels, totalOps);
+            _exit(0);
+        }
+        if (serverPid == -1) {
+            perror("fork (server)");
+            close_channels(channels);
+            return false;
+        }
+    }
+
+    bool ok = true;
+    for (int i = 0; i < processes; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_worker(primitive, arena, sem, roundTrip ? &channels[i] : nullptr, i, pinned,
+                       iterations, latencies + static_cast<size_t>(i) * iterations);
+            _exit(0);
+        }
+        if (pid == -1) {
+            perror("fork (worker)");
+            ok = false;
+            break;
+        }
+        pids.push_back(pid);
+    }
+
+    while (ok && arena->readyCount.load(std::memory_order_acquire) < static_cast<std::uint32_t>(processes)) {
+        sched_yield();
+    }
+    std::uint64_t start = now_ns();
+    arena->go.store(1, std::memory_order_release);
+
+    for (pid_t pid : pids) {
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    }
+    std::uint64_t elapsed = now_ns() - start;
+    if (serverPid > 0) {
+        if (!ok) kill(serverPid, SIGKILL);
+        waitpid(serverPid, NULL, 0);
+    }
+    close_channels(channels);
+    if (sem != SEM_FAILED) sem_close(sem);
+    pthread_mutex_destroy(&arena->mutex);
+    if (!ok) return false;
+
+    std::int64_t finalCount = arena->counter.load();
+    if (primitive == Primitive::SHARDED) {
+        finalCount = 0;
+        for (int i = 0; i < processes; ++i) finalCount += arena->shards[i].value.load();
+    }
+
+    std::vector<std::uint64_t> samples(latencies, latencies + totalOps);
+    double sum = 0.0;
+    for (std::uint64_t sample : samples) sum += static_cast<double>(sample);
+    size_t p50 = samples.size() / 2;
+    size_t p99 = std::min(samples.size() - 1, samples.size() * 99 / 100);
+    std::nth_element(samples.begin(), samples.begin() + p50, samples.end());
+    result->p50Ns = samples[p50];
+    std::nth_element(samples.begin(), samples.begin() + p99, samples.end());
+    result->p99Ns = samples[p99];
+    result->maxNs = *std::max_element(samples.begin(), samples.end());
+    result->meanNs = sum / samples.size();
+    result->primitive = primitive;
+    result->processes = processes;
+    result->pinned = pinned;
+    result->ops = totalOps;
+    result->elapsedSec = elapsed / 1e9;
+    result->counterOk = finalCount == static_cast<std::int64_t>(totalOps);
+    return true;
+}
+
+void print_results_json(const std::vector<BenchResult>& results, int iterations) {
+    printf("{\n  \"iterations_per_process\": %d,\n  \"online_cpus\": %ld,\n  \"results\": [\n",
+           iterations, sysconf(_SC_NPROCESSORS_ONLN));
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        printf("    {\"primitive\": \"%s\", \"processes\": %d, \"pinned\": %s, \"ops\": %llu, \"elapsed_s\": %.6f, "
+               "\"throughput_ops_s\": %.1f, \"latency_ns\": {\"p50\": %llu, \"p99\": %llu, \"max\": %llu, \"mean\": %.1f}, "
+               "\"counter_ok\": %s}%s\n",
+               primitive_name(r.primitive), r.processes, r.pinned ? "true" : "false",
+               static_cast<unsigned long long>(r.ops), r.elapsedSec,
+               r.elapsedSec > 0 ? r.ops / r.elapsedSec : 0.0,
+               static_cast<unsigned long long>(r.p50Ns), static_cast<unsigned long long>(r.p99Ns),
+               static_cast<unsigned long long>(r.maxNs), r.meanNs,
+               r.counterOk ? "true" : "false", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
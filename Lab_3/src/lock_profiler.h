@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#define LOCK_PROFILE_PROCESSES 16   // Distinct process names (main, child1, child2, ...)
+#define LOCK_PROFILE_NAME_SIZE 16
+#define LOCK_PROFILE_BUCKETS 24     // Bucket 0: < 1 us, bucket i: < 2^i us, last bucket: everything above
+
+// Call sites of lock_mutex
+enum LockSite : int {
+    LOCK_SITE_UNKNOWN = 0,
+    LOCK_SITE_INIT,        // main: shared data initialization
+    LOCK_SITE_TIMER,       // main: timer_thread
+    LOCK_SITE_USER_INPUT,  // main: process_user_input
+    LOCK_SITE_CHILD1,      // child1: counter += 10
+    LOCK_SITE_CHILD2,      // child2: counter *= 2 / counter /= 2
+    LOCK_SITE_COUNT
+};
+
+inline const char* lock_site_name(int site) {
+    static const char* names[LOCK_SITE_COUNT] = { "unknown", "init", "timer_thread", "user_input", "child1", "child2" };
+    return site >= 0 && site < LOCK_SITE_COUNT ? names[site] : "invalid";
+}
+
+// Wait and hold statistics of one call site
+struct LockSiteStats {
+    std::atomic<std::uint64_t> count;
+    std::atomic<std::uint64_t> waitTotalNs;
+    std::atomic<std::uint64_t> waitMaxNs;
+    std::atomic<std::uint64_t> holdTotalNs;
+    std::atomic<std::uint64_t> holdMaxNs;
+    std::atomic<std::uint64_t> waitBuckets[LOCK_PROFILE_BUCKETS];
+    std::atomic<std::uint64_t> holdBuckets[LOCK_PROFILE_BUCKETS];
+};
+
+// Statistics of one process name, accumulated over all runs of that process
+struct LockProcessProfile {
+    std::atomic<std::uint32_t> state;     // 0 - free, 1 - being claimed, 2 - ready
+    std::atomic<std::int32_t> lastPid;
+    char name[LOCK_PROFILE_NAME_SIZE];
+    LockSiteStats sites[LOCK_SITE_COUNT];
+};
+
+// Contention profile in the shared segment, enabled at run time by lock_stats
+struct LockProfile {
+    std::atomic<std::uint32_t> enabled;
+    LockProcessProfile processes[LOCK_PROFILE_PROCESSES];
+};
+
+// Per-process state of the profiler
+struct LockProfilerState {
+    LockProfile* profile = nullptr;
+    LockProcessProfile* self = nullptr;
+};
+
+inline LockProfilerState& lock_profiler_state() {
+    static LockProfilerState state;
+    return state;
+}
+
+inline std::uint64_t lock_profile_now_ns() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Find or claim the slot for processName and remember it for this process
+inline void lock_profile_attach(LockProfile* profile, const char* processName, std::int32_t pid) {
+    LockProfilerState& state = lock_profiler_state();
+    state.profile = profile;
+    state.self = nullptr;
+    for (LockProcessProfile& slot : profile->processes) {
+        std::uint32_t slotState = slot.state.load(std::memory_order_acquire);
+        if (slotState == 0 && slot.state.compare_exchange_strong(slotState, 1, std::memory_order_acq_rel)) {
+            strncpy(slot.name, processName, LOCK_PROFILE_NAME_SIZE - 1);
+            slot.name[LOCK_PROFILE_NAME_SIZE - 1] = '\0';
+            slot.state.store(2, std::memory_order_release);
+            slotState = 2;
+        }
+        while (slotState == 1) {
+            slotState = slot.state.load(std::memory_order_acquire);
+        }
+        if (strncmp(slot.name, processName, LOCK_PROFILE_NAME_SIZE - 1) == 0) {
+            slot.lastPid.store(pid, std::memory_order_relaxed);
+            state.self = &slot;
+            return;
+        }
+    }
+}
+
+inline void lock_profile_record(std::atomic<std::uint64_t>* buckets, std::atomic<std::uint64_t>* total, std::atomic<std::uint64_t>* maximum, std::uint64_t ns) {
+    std::uint64_t us = ns / 1000;
+    int bucket = 0;
+    while (us > 0 && bucket < LOCK_PROFILE_BUCKETS - 1) {
+        us >>= 1;
+        ++bucket;
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    total->fetch_add(ns, std::memory_order_relaxed);
+    std::uint64_t current = maximum->load(std::memory_order_relaxed);
+    while (ns > current && !maximum->compare_exchange_weak(current, ns, std::memory_order_relaxed)) {
+    }
+}
+
+// Thread-local hold bookkeeping between lock and unlock
+struct LockHoldState {
+    int site = LOCK_SITE_UNKNOWN;
+    std::uint64_t acquiredNs = 0;  // 0 if the current hold is not being profiled
+};
+
+inline LockHoldState& lock_hold_state() {
+    static thread_local LockHoldState state;
+    return state;
+}
+
+// Called before waiting on the mutex, returns 0 if profiling is off
+inline std::uint64_t lock_profile_wait_begin() {
+    LockProfilerState& state = lock_profiler_state();
+    if (state.self == nullptr || state.profile->enabled.load(std::memory_order_relaxed) == 0) {
+        return 0;
+    }
+    return lock_profile_now_ns();
+}
+
+// Called once the mutex is acquired
+inline void lock_profile_acquired(int site, std::uint64_t waitStartNs) {
+    LockHoldState& hold = lock_hold_state();
+    hold.acquiredNs = 0;
+    if (waitStartNs == 0) {
+        return;
+    }
+    if (site < 0 || site >= LOCK_SITE_COUNT) site = LOCK_SITE_UNKNOWN;
+    std::uint64_t now = lock_profile_now_ns();
+    LockSiteStats& stats = lock_profiler_state().self->sites[site];
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    lock_profile_record(stats.waitBuckets, &stats.waitTotalNs, &stats.waitMaxNs, now - waitStartNs);
+    hold.site = site;
+    hold.acquiredNs = now;
+}
+
+// Called right before the mutex is released
+inline void lock_profile_release() {
+    LockHoldState& hold = lock_hold_state();
+    if (hold.acquiredNs == 0) {
+        return;
+    }
+    LockSiteStats& stats = lock_profiler_state().self->sites[hold.site];
+    lock_profile_record(stats.holdBuckets, &stats.holdTotalNs, &stats.holdMaxNs, lock_profile_now_ns() - hold.acquiredNs);
+    hold.acquiredNs = 0;
+}
+
+// Upper bound (ns) of the bucket holding the given percentile, 0 if there are no samples
+inline std::uint64_t lock_profile_percentile(const std::atomic<std::uint64_t>* buckets, double percentile) {
+    std::uint64_t total = 0;
+    for (int i = 0; i < LOCK_PROFILE_BUCKETS; ++i) total += buckets[i].load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+    std::uint64_t rank = static_cast<std::uint64_t>(total * percentile / 100.0 + 0.5);
+    if (rank == 0) rank = 1;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < LOCK_PROFILE_BUCKETS; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return (1ULL << i) * 1000;
+    }
+    return (1ULL << (LOCK_PROFILE_BUCKETS - 1)) * 1000;
+}
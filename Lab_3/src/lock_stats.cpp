@@ -0,0 +1,198 @@
+// Live contention statistics of MUTEX_NAME collected by lock_mutex/unlock_mutex
+// Usage: lock_stats [show [interval_sec] | enable | disable | reset]
+
+#include <iostream>
+#include <string>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+#endif
+
+#include "shared_data.h"
+
+// IPC Constants
+#define SHM_NAME "my_shared_memory"
+
+volatile sig_atomic_t need_exit = 0; // Flag for program termination
+
+void print_lock_stats(const LockProfile* profile); // Print the statistics of every process and call site
+void reset_lock_stats(LockProfile* profile); // Zero all statistics, process slots are kept
+SharedData* attach_shared_data(void** shm); // Open and map the existing shared memory segment (Windows, Linux)
+void detach_shared_data(void* shm, SharedData* sharedData); // Unmap and close the shared memory segment (Windows, Linux)
+void sleep_for_seconds(int seconds); // Pause execution for a specified number of seconds (Windows, Linux)
+
+#ifdef _WIN32
+    BOOL WINAPI sig_handler(DWORD signal); // Ctrl+C handler (Windows)
+#else
+    void sig_handler(int sig); // SIGINT handler (Linux)
+#endif
+
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "show";
+    int interval = argc > 2 ? std::atoi(argv[2]) : 0;
+    if ((command != "show" && command != "enable" && command != "disable" && command != "reset") || interval < 0) {
+        std::cerr << "Usage: " << argv[0] << " [show [interval_sec] | enable | disable | reset]" << std::endl;
+        return 1;
+    }
+
+#ifdef _WIN32
+    SetConsoleCtrlHandler(sig_handler, TRUE);
+#else
+    struct sigaction act;
+    act.sa_handler = sig_handler;
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = 0;
+    sigaction(SIGINT, &act, NULL);
+#endif
+
+    void* shm = nullptr;
+    SharedData* sharedData = attach_shared_data(&shm);
+    if (sharedData == nullptr) {
+        std::cerr << "Failed to attach to shared memory (is main running?)" << std::endl;
+        return 1;
+    }
+    LockProfile* profile = &sharedData->lockProfile;
+
+    if (command == "enable") {
+        profile->enabled.store(1);
+        std::cout << "Lock profiling enabled" << std::endl;
+    }
+    else if (command == "disable") {
+        profile->enabled.store(0);
+        std::cout << "Lock profiling disabled" << std::endl;
+    }
+    else if (command == "reset") {
+        reset_lock_stats(profile);
+        std::cout << "Lock statistics reset" << std::endl;
+    }
+    else {
+        print_lock_stats(profile);
+        while (interval > 0 && !need_exit) {
+            sleep_for_seconds(interval);
+            if (need_exit) break;
+            std::cout << std::endl;
+            print_lock_stats(profile);
+        }
+    }
+
+    detach_shared_data(shm, sharedData);
+    return 0;
+}
+
+
+void print_lock_stats(const LockProfile* profile) {
+    std::cout << "Lock profiling: " << (profile->enabled.load() ? "enabled" : "disabled (run 'lock_stats enable')") << std::endl;
+    std::cout << std::left << std::setw(10) << "process" << std::setw(8) << "pid" << std::setw(14) << "site"
+              << std::right << std::setw(10) << "count"
+              << "   wait us avg/p50/p99/max" << "          hold us avg/p50/p99/max" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const LockProcessProfile& process : profile->processes) {
+        if (process.state.load(std::memory_order_acquire) != 2) continue;
+        for (int site = 0; site < LOCK_SITE_COUNT; ++site) {
+            const LockSiteStats& stats = process.sites[site];
+            std::uint64_t count = stats.count.load(std::memory_order_relaxed);
+            if (count == 0) continue;
+            double waitAvg = stats.waitTotalNs.load(std::memory_order_relaxed) / 1000.0 / count;
+            double holdAvg = stats.holdTotalNs.load(std::memory_order_relaxed) / 1000.0 / count;
+            std::uint64_t waitMax = stats.waitMaxNs.load(std::memory_order_relaxed);
+            std::uint64_t holdMax = stats.holdMaxNs.load(std::memory_order_relaxed);
+            // Percentiles are bucket upper bounds, never report them above the observed maximum
+            std::uint64_t waitP50 = std::min(lock_profile_percentile(stats.waitBuckets, 50), waitMax);
+            std::uint64_t waitP99 = std::min(lock_profile_percentile(stats.waitBuckets, 99), waitMax);
+            std::uint64_t holdP50 = std::min(lock_profile_percentile(stats.holdBuckets, 50), holdMax);
+            std::uint64_t holdP99 = std::min(lock_profile_percentile(stats.holdBuckets, 99), holdMax);
+            std::cout << std::left << std::setw(10) << process.name << std::setw(8) << process.lastPid.load()
+                      << std::setw(14) << lock_site_name(site) << std::right << std::setw(10) << count << "   "
+                      << std::setw(8) << waitAvg << "/" << waitP50 / 1000 << "/" << waitP99 / 1000 << "/" << waitMax / 1000 << "   "
+                      << std::setw(8) << holdAvg << "/" << holdP50 / 1000 << "/" << holdP99 / 1000 << "/" << holdMax / 1000 << std::endl;
+        }
+    }
+}
+
+void reset_lock_stats(LockProfile* profile) {
+    for (LockProcessProfile& process : profile->processes) {
+        for (LockSiteStats& stats : process.sites) {
+            stats.count.store(0);
+            stats.waitTotalNs.store(0);
+            stats.waitMaxNs.store(0);
+            stats.holdTotalNs.store(0);
+            stats.holdMaxNs.store(0);
+            for (int i = 0; i < LOCK_PROFILE_BUCKETS; ++i) {
+                stats.waitBuckets[i].store(0);
+                stats.holdBuckets[i].store(0);
+            }
+        }
+    }
+}
+
+#ifdef _WIN32
+    BOOL WINAPI sig_handler(DWORD signal) {
+        if (signal == CTRL_C_EVENT) {
+            need_exit = 1;
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    void sleep_for_seconds(int seconds) {
+        Sleep(seconds * 1000);
+    }
+
+    SharedData* attach_shared_data(void** shm) {
+        HANDLE hMapFile = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, SHM_NAME);
+        if (hMapFile == NULL) {
+            return nullptr;
+        }
+        void* shmem_ptr = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (shmem_ptr == NULL) {
+            CloseHandle(hMapFile);
+            return nullptr;
+        }
+        *shm = hMapFile;
+        return static_cast<SharedData*>(shmem_ptr);
+    }
+
+    void detach_shared_data(void* shm, SharedData* sharedData) {
+        UnmapViewOfFile(sharedData);
+        CloseHandle(static_cast<HANDLE>(shm));
+    }
+#else
+    void sig_handler(int sig) {
+        if (sig == SIGINT)
+            need_exit = 1;
+    }
+
+    void sleep_for_seconds(int seconds) {
+        sleep(seconds);
+    }
+
+    SharedData* attach_shared_data(void** shm) {
+        int shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
+        if (shm_fd == -1) {
+            return nullptr;
+        }
+        void* shmem_ptr = mmap(NULL, sizeof(SharedData), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        if (shmem_ptr == MAP_FAILED) {
+            close(shm_fd);
+            return nullptr;
+        }
+        *shm = reinterpret_cast<void*>(static_cast<intptr_t>(shm_fd));
+        return static_cast<SharedData*>(shmem_ptr);
+    }
+
+    void detach_shared_data(void* shm, SharedData* sharedData) {
+        munmap(sharedData, sizeof(SharedData));
+        close(static_cast<int>(reinterpret_cast<intptr_t>(shm)));
+    }
+#endif
@@ -6,6 +6,7 @@
 #include <iomanip>
 #include <ctime>
 #include <cstdint>
+#include <csignal>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -23,25 +24,35 @@
     #include <termios.h>
     #include <sys/select.h>
     #include <cstdint>
-    #include <csignal>
     #include <pthread.h>
 #endif
 #include <limits>
 
+#include "shared_data.h"
+#include "tick_engine.h"
+#include "checkpoint.h"
+#include "lock_profiler.h"
+
 // IPC Constants
 #define SHM_NAME "my_shared_memory"
 #define MUTEX_NAME "my_mutex"
 #define LEADER_MUTEX_NAME "leader_mutex"
 
-struct SharedData { // Shared data
-    std::int64_t counter;
+#define DEFAULT_TICK_PERIOD_MS 300 // Counter tick period unless --tick-hz is given
+#define JITTER_LOG_INTERVAL_SEC 10 // How often the leader writes the tick jitter histogram
+#define DEFAULT_CHECKPOINT_INTERVAL_MS 1000 // How often the leader checkpoints the counter in --persist mode
+
+struct Options { // Command line options
+    std::int64_t tickPeriodNs;    // --tick-hz <rate>
+    std::string persistPath;      // --persist <file>, empty if the counter is not persisted
+    int checkpointIntervalMs;     // --checkpoint-ms <interval>
 };
 
 // Cross-platform shared memory & mutex functions
-void* create_shared_memory(size_t size);
+void* create_shared_memory(size_t size, bool* created);
 void* map_shared_memory(void* shm);
 bool create_mutex(void** mutex);
-bool lock_mutex(void* mutex);
+bool lock_mutex(void* mutex, int site = LOCK_SITE_UNKNOWN);
 void unlock_mutex(void* mutex);
 void close_shared_memory(void* shm, void* sharedData);
 void close_mutex(void* mutex);
@@ -65,6 +76,8 @@ std::string get_current_time_ms(); // Get current time with milliseconds (Window
 #endif
 
 void process_user_input(SharedData* sharedData, void* mutex); // Handle user input (Windows, Linux)
+bool parse_options(int argc, char* argv[], Options* options); // Parse command line options (Windows, Linux)
+void checkpoint_counter(CheckpointFile* checkpoint, SharedData* sharedData); // Save a snapshot of the counter to the checkpoint file (Windows, Linux)
 
 // Child Process spawning
 #ifdef _WIN32
@@ -88,16 +101,22 @@ extern SharedData* sharedData_global;
 extern void* shm_global;
 extern void* mutex_global;
 extern void* leaderMutex_global;
+extern CheckpointFile* checkpoint_global;
+extern volatile sig_atomic_t stop_requested;
 #endif // GLOBALS_H
 
 SharedData* sharedData_global = nullptr;
 void* shm_global = nullptr;
 void* mutex_global = nullptr;
 void* leaderMutex_global = nullptr;
+CheckpointFile* checkpoint_global = nullptr;
+volatile sig_atomic_t stop_requested = 0; // Signal to handle once the main loop has saved the final checkpoint (Linux)
 
 struct ThreadData { // Struct to pass data to the thread
     SharedData* sharedData;
     void* mutex;
+    std::int64_t tickPeriodNs;
+    JitterHistogram* jitter;
 };
 
 
@@ -105,8 +124,17 @@ int main(int argc, char* argv[]) {
     // Get application path
     std::string appPath = argv[0];
 
+    // Command line options
+    Options options;
+    if (!parse_options(argc, argv, &options)) {
+        std::cerr << "Usage: " << argv[0] << " [--tick-hz <rate, up to " << MAX_TICK_RATE_HZ << ">]"
+                  << " [--persist <file>] [--checkpoint-ms <interval>]" << std::endl;
+        return 1;
+    }
+
     // Shared Memory
-    void* shm = create_shared_memory(sizeof(SharedData));
+    bool shmCreated = false;
+    void* shm = create_shared_memory(sizeof(SharedData), &shmCreated);
     if (shm == nullptr) {
         std::cerr << "Failed to create shared memory" << std::endl;
         return 1;
@@ -125,6 +153,8 @@ int main(int argc, char* argv[]) {
         close_shared_memory(shm, sharedData);
         return 1;
     }
+    lock_profile_attach(&sharedData->lockProfile, "main", getpid());
+
     // Mutex for leader
     void* leaderMutex = nullptr;
     if (!acquire_leader_mutex(&leaderMutex)) {
@@ -149,8 +179,38 @@ int main(int argc, char* argv[]) {
     sigIntHandler.sa_flags = 0;
     sigaction(SIGINT, &sigIntHandler, NULL);
 #endif
-    // Initialize shared data
-    sharedData->counter = 0;
+    // Initialize shared data: a new segment starts at 0, or from the last checkpoint if the leader runs in --persist
+    // mode. A segment that is already in use holds the live counter and is left alone
+    std::int64_t initialCounter = 0;
+    CheckpointFile checkpoint;
+    bool persistent = false;
+    if (!options.persistPath.empty() && is_leader(leaderMutex)) {
+        if (!open_checkpoint_file(&checkpoint, options.persistPath)) {
+            std::cerr << "Failed to open checkpoint file " << options.persistPath << std::endl;
+            release_leader_mutex(leaderMutex);
+            close_mutex(mutex);
+            close_shared_memory(shm, sharedData);
+            return 1;
+        }
+        CheckpointSlot restored;
+        if (!shmCreated) {
+            std::cout << "Shared counter already live, checkpoint not restored" << std::endl;
+        }
+        else if (restore_checkpoint(&checkpoint, &restored)) {
+            initialCounter = restored.counter;
+            std::cout << "Counter restored from checkpoint: " << initialCounter << std::endl;
+        }
+        persistent = true;
+        checkpoint_global = &checkpoint;
+    }
+    if (shmCreated) {
+        lock_mutex(mutex, LOCK_SITE_INIT);
+        write_shared_counter(sharedData, initialCounter);
+        unlock_mutex(mutex);
+    }
+    if (is_leader(leaderMutex)) {
+        shared_table_set(&sharedData->table, "leader.pid", getpid());
+    }
 
     // Create log file
     std::ofstream logFile;
@@ -171,7 +231,8 @@ int main(int argc, char* argv[]) {
     // Timer Thread
 #ifdef _WIN32
     HANDLE timer_handle;
-    ThreadData* threadData = new ThreadData{ sharedData,mutex };
+    JitterHistogram* jitter = new JitterHistogram();
+    ThreadData* threadData = new ThreadData{ sharedData, mutex, options.tickPeriodNs, jitter };
     timer_handle = CreateThread(NULL, 0, timer_thread, (LPVOID)threadData, 0, NULL);
     if (timer_handle == NULL) {
         std::cerr << "Failed to create timer thread" << std::endl;
@@ -183,7 +244,8 @@ int main(int argc, char* argv[]) {
     CloseHandle(timer_handle);
 #else
     pthread_t timer_thread_id;
-    ThreadData* threadData = new ThreadData{ sharedData,mutex };
+    JitterHistogram* jitter = new JitterHistogram();
+    ThreadData* threadData = new ThreadData{ sharedData, mutex, options.tickPeriodNs, jitter };
     int result = pthread_create(&timer_thread_id, NULL, timer_thread, (void*)threadData);
     if (result != 0) {
         std::cerr << "Failed to create timer thread" << std::endl;
@@ -206,12 +268,25 @@ int main(int argc, char* argv[]) {
 #ifdef _WIN32
     LARGE_INTEGER last_spawn_time = get_current_time_large_integer();
     LARGE_INTEGER last_log_time = get_current_time_large_integer();
+    LARGE_INTEGER last_jitter_log_time = get_current_time_large_integer();
+    LARGE_INTEGER last_checkpoint_time = get_current_time_large_integer();
 #else
     struct timeval last_spawn_time = get_current_time_timeval();
     struct timeval last_log_time = get_current_time_timeval();
+    struct timeval last_jitter_log_time = get_current_time_timeval();
+    struct timeval last_checkpoint_time = get_current_time_timeval();
 #endif
     // Main Loop
     while (true) {
+#ifndef _WIN32
+        // SIGINT in --persist mode: save the final checkpoint here, msync is no call for a signal handler
+        if (stop_requested != 0) {
+            checkpoint_counter(&checkpoint, sharedData);
+            close_checkpoint_file(&checkpoint);
+            checkpoint_global = nullptr;
+            signal_handler(stop_requested);
+        }
+#endif
         process_user_input(sharedData, mutex);
         if (is_leader(leaderMutex)) {
             // Write counter to log every 1 sec
@@ -219,11 +294,24 @@ int main(int argc, char* argv[]) {
             LARGE_INTEGER now = get_current_time_large_integer();
             double duration = get_time_diff_seconds(last_log_time, now);
             if (duration >= 1.0) {
+                SharedSnapshot snapshot = read_shared_snapshot(sharedData);
                 std::stringstream log_message_str;
-                log_message_str << get_current_time_ms() << " - PID: " << getpid() << " - Counter: " << sharedData->counter << std::endl;
+                log_message_str << get_current_time_ms() << " - PID: " << getpid() << " - Counter: " << snapshot.counter
+                                << " (updates: " << snapshot.updateCount << ", last writer: " << snapshot.lastWriterPid << ")" << std::endl;
                 log_message(logFile, log_message_str.str());
                 last_log_time = now;
             }
+            // Write tick jitter histogram
+            if (get_time_diff_seconds(last_jitter_log_time, now) >= JITTER_LOG_INTERVAL_SEC) {
+                log_message(logFile, get_current_time_ms() + " - Tick jitter: " + format_jitter_histogram(jitter) + "\n");
+                log_message(logFile, get_current_time_ms() + " - Shared state: " + format_shared_table(&sharedData->table) + "\n");
+                last_jitter_log_time = now;
+            }
+            // Checkpoint the counter
+            if (persistent && get_time_diff_seconds(last_checkpoint_time, now) * 1000.0 >= options.checkpointIntervalMs) {
+                checkpoint_counter(&checkpoint, sharedData);
+                last_checkpoint_time = now;
+            }
             // Launch child processes every 3 sec
             duration = get_time_diff_seconds(last_spawn_time, now);
             if (duration >= 3.0) {
@@ -231,11 +319,24 @@ int main(int argc, char* argv[]) {
             struct timeval now = get_current_time_timeval();
             double duration = get_time_diff_seconds(last_log_time, now);
             if (duration >= 1.0) {
+                SharedSnapshot snapshot = read_shared_snapshot(sharedData);
                 std::stringstream log_message_str;
-                log_message_str << get_current_time_ms() << " - PID: " << getpid() << " - Counter: " << sharedData->counter << std::endl;
+                log_message_str << get_current_time_ms() << " - PID: " << getpid() << " - Counter: " << snapshot.counter
+                                << " (updates: " << snapshot.updateCount << ", last writer: " << snapshot.lastWriterPid << ")" << std::endl;
                 log_message(logFile, log_message_str.str());
                 last_log_time = now;
             }
+            // Write tick jitter histogram
+            if (get_time_diff_seconds(last_jitter_log_time, now) >= JITTER_LOG_INTERVAL_SEC) {
+                log_message(logFile, get_current_time_ms() + " - Tick jitter: " + format_jitter_histogram(jitter) + "\n");
+                log_message(logFile, get_current_time_ms() + " - Shared state: " + format_shared_table(&sharedData->table) + "\n");
+                last_jitter_log_time = now;
+            }
+            // Checkpoint the counter
+            if (persistent && get_time_diff_seconds(last_checkpoint_time, now) * 1000.0 >= options.checkpointIntervalMs) {
+                checkpoint_counter(&checkpoint, sharedData);
+                last_checkpoint_time = now;
+            }
 
             duration = get_time_diff_seconds(last_spawn_time, now);
             if (duration >= 3.0) {
@@ -336,6 +437,12 @@ int main(int argc, char* argv[]) {
         case CTRL_C_EVENT:
         case CTRL_CLOSE_EVENT:
             std::cout << "Ctrl+C or Close event detected. Cleaning up..." << std::endl;
+            // Save the final checkpoint
+            if (checkpoint_global != nullptr && sharedData_global != nullptr) {
+                checkpoint_counter(checkpoint_global, sharedData_global);
+                close_checkpoint_file(checkpoint_global);
+                checkpoint_global = nullptr;
+            }
             // Release leader mutex
             if (leaderMutex_global != nullptr) {
                 release_leader_mutex(leaderMutex_global);
@@ -366,10 +473,12 @@ int main(int argc, char* argv[]) {
         ThreadData* data = (ThreadData*)lpParam;
         SharedData* sharedData = data->sharedData;
         void* mutex = data->mutex;
+        TickEngine engine;
+        tick_engine_init(&engine, data->tickPeriodNs, data->jitter);
         while (true) {
-            Sleep(300);
-            lock_mutex(mutex);
-            sharedData->counter++;
+            std::uint64_t ticks = tick_engine_wait(&engine);
+            lock_mutex(mutex, LOCK_SITE_TIMER);
+            write_shared_counter(sharedData, read_counter_locked(sharedData) + static_cast<std::int64_t>(ticks));
             unlock_mutex(mutex);
         }
         return 0;
@@ -382,8 +491,8 @@ int main(int argc, char* argv[]) {
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
             try {
                 std::int64_t new_count = std::stoll(input);
-                lock_mutex(mutex);
-                sharedData->counter = new_count;
+                lock_mutex(mutex, LOCK_SITE_USER_INPUT);
+                write_shared_counter(sharedData, new_count);
                 unlock_mutex(mutex);
                 std::cout << "Counter set to: " << new_count << std::endl;
             }
@@ -408,15 +517,17 @@ int main(int argc, char* argv[]) {
         return converter.to_bytes(wstr);
     }
 
-    void* create_shared_memory(size_t size) {
+    void* create_shared_memory(size_t size, bool* created) {
         std::string shm_name = wstring_to_string(to_wstring(SHM_NAME));
         HANDLE hMapFile = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, shm_name.c_str());
+        *created = false;
 
         if (hMapFile == NULL) {
             hMapFile = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size, to_wstring(SHM_NAME).c_str());
             if (hMapFile == NULL) {
                 return nullptr;
             }
+            *created = GetLastError() != ERROR_ALREADY_EXISTS;
         }
         return hMapFile;
     }
@@ -450,16 +561,19 @@ int main(int argc, char* argv[]) {
         return true;
     }
 
-    bool lock_mutex(void* mutex) {
+    bool lock_mutex(void* mutex, int site) {
         HANDLE hMutex = static_cast<HANDLE>(mutex);
+        std::uint64_t waitStart = lock_profile_wait_begin();
         if (WaitForSingleObject(hMutex, INFINITE) == WAIT_FAILED) {
             return false;
         }
+        lock_profile_acquired(site, waitStart);
         return true;
     }
 
     void unlock_mutex(void* mutex) {
         HANDLE hMutex = static_cast<HANDLE>(mutex);
+        lock_profile_release();
         ReleaseMutex(hMutex);
     }
 
@@ -543,6 +657,12 @@ int main(int argc, char* argv[]) {
     }
 #else
     void signal_handler(int signum) {
+        // The main loop saves the final checkpoint and comes back here; a second signal does not wait for it
+        if (checkpoint_global != nullptr && stop_requested == 0) {
+            stop_requested = signum;
+            return;
+        }
+
         // Release leader mutex
         if (leaderMutex_global != nullptr) {
             release_leader_mutex(leaderMutex_global);
@@ -581,10 +701,12 @@ int main(int argc, char* argv[]) {
         ThreadData* data = (ThreadData*)arg;
         SharedData* sharedData = data->sharedData;
         void* mutex = data->mutex;
+        TickEngine engine;
+        tick_engine_init(&engine, data->tickPeriodNs, data->jitter);
         while (true) {
-            usleep(300000);
-            lock_mutex(mutex);
-            sharedData->counter++;
+            std::uint64_t ticks = tick_engine_wait(&engine);
+            lock_mutex(mutex, LOCK_SITE_TIMER);
+            write_shared_counter(sharedData, read_counter_locked(sharedData) + static_cast<std::int64_t>(ticks));
             unlock_mutex(mutex);
         }
         return nullptr;
@@ -612,8 +734,8 @@ int main(int argc, char* argv[]) {
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
             try {
                 std::int64_t new_count = std::stoll(input);
-                lock_mutex(mutex);
-                sharedData->counter = new_count;
+                lock_mutex(mutex, LOCK_SITE_USER_INPUT);
+                write_shared_counter(sharedData, new_count);
                 unlock_mutex(mutex);
                 std::cout << "Counter set to: " << new_count << std::endl;
             }
@@ -627,8 +749,13 @@ int main(int argc, char* argv[]) {
         tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
     }
 
-    void* create_shared_memory(size_t size) {
-        int shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
+    void* create_shared_memory(size_t size, bool* created) {
+        // O_EXCL tells which of the processes started together created the segment
+        int shm_fd = shm_open(SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+        *created = shm_fd != -1;
+        if (shm_fd == -1 && errno == EEXIST) {
+            shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
+        }
         if (shm_fd == -1) {
             return nullptr;
         }
@@ -657,16 +784,19 @@ int main(int argc, char* argv[]) {
         return true;
     }
 
-    bool lock_mutex(void* mutex) {
+    bool lock_mutex(void* mutex, int site) {
         sem_t* sem = static_cast<sem_t*>(mutex);
+        std::uint64_t waitStart = lock_profile_wait_begin();
         if (sem_wait(sem) == -1) {
             return false;
         }
+        lock_profile_acquired(site, waitStart);
         return true;
     }
 
     void unlock_mutex(void* mutex) {
         sem_t* sem = static_cast<sem_t*>(mutex);
+        lock_profile_release();
         sem_post(sem);
     }
 
@@ -760,6 +890,50 @@ int main(int argc, char* argv[]) {
 #endif
 
 
+bool parse_options(int argc, char* argv[], Options* options) {
+    options->tickPeriodNs = static_cast<std::int64_t>(DEFAULT_TICK_PERIOD_MS) * 1000000;
+    options->persistPath.clear();
+    options->checkpointIntervalMs = DEFAULT_CHECKPOINT_INTERVAL_MS;
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (name == "--tick-hz") {
+                size_t parsed = 0;
+                double rate = std::stod(value, &parsed);
+                if (parsed != value.size()) return false;   // "10x"
+                options->tickPeriodNs = tick_period_from_rate(rate);
+                if (options->tickPeriodNs == 0) return false;
+            }
+            else if (name == "--persist") {
+                options->persistPath = value;
+            }
+            else if (name == "--checkpoint-ms") {
+                size_t parsed = 0;
+                options->checkpointIntervalMs = std::stoi(value, &parsed);
+                if (parsed != value.size() || options->checkpointIntervalMs <= 0) return false;
+            }
+            else {
+                return false;
+            }
+        }
+        catch (std::exception const& ex) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void checkpoint_counter(CheckpointFile* checkpoint, SharedData* sharedData) {
+    SharedSnapshot snapshot = read_shared_snapshot(sharedData);
+    if (!write_checkpoint(checkpoint, snapshot.counter, current_time_ms_since_epoch(), snapshot.updateCount)) {
+        std::cerr << "Failed to write checkpoint" << std::endl;
+    }
+}
+
 void log_message(std::ofstream& logFile, const std::string& message) {
     logFile << message;
     logFile.flush();
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <cerrno>
+#    include <csignal>
+#    include <ctime>
+#    include <unistd.h>
+#    include <sys/syscall.h>
+#    include <linux/futex.h>
+#endif
+
+#define MAX_SUBSCRIBERS 16
+
+// Condition under which a subscriber is woken up
+enum class NotifyPredicate : std::int32_t {
+    ANY_CHANGE = 0, // Every update
+    ABOVE = 1,      // New value >= threshold
+    BELOW = 2,      // New value <= threshold
+    CROSSING = 3    // Old and new value are on different sides of the threshold
+};
+
+// Subscription slot in shared memory
+struct Subscription {
+    std::atomic<std::int32_t> ownerPid;   // 0 - free, -1 - being claimed, > 0 - active
+    std::atomic<std::int32_t> predicate;
+    std::atomic<std::int64_t> threshold;
+    std::atomic<std::uint32_t> wakeSeq;   // Futex word, bumped every time the predicate matches
+};
+
+// Change notification hub, lives in the shared segment next to the counter
+struct NotifyHub {
+    std::atomic<std::uint32_t> generation;        // Futex word, bumped on every update
+    std::atomic<std::uint32_t> generationWaiters; // Processes sleeping on generation
+    std::atomic<std::uint32_t> activeSubscribers;
+    Subscription subscribers[MAX_SUBSCRIBERS];
+};
+
+// Sleep while *word == expected, returns false on timeout (timeoutMs < 0 - wait forever)
+inline bool shared_futex_wait(std::atomic<std::uint32_t>* word, std::uint32_t expected, int timeoutMs) {
+#ifdef _WIN32
+    // WaitOnAddress does not work across processes, poll instead
+    DWORD waited = 0;
+    while (word->load(std::memory_order_acquire) == expected) {
+        if (timeoutMs >= 0 && waited >= static_cast<DWORD>(timeoutMs)) return false;
+        Sleep(1);
+        ++waited;
+    }
+    return true;
+#else
+    struct timespec timeout;
+    struct timespec* timeoutPtr = NULL;
+    if (timeoutMs >= 0) {
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        timeoutPtr = &timeout;
+    }
+    long result = syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAIT, expected, timeoutPtr, NULL, 0);
+    return !(result == -1 && errno == ETIMEDOUT);
+#endif
+}
+
+// Wake all processes sleeping on word
+inline void shared_futex_wake(std::atomic<std::uint32_t>* word) {
+#ifndef _WIN32
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)word;
+#endif
+}
+
+inline bool process_alive(std::int32_t pid) {
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+    if (process == NULL) return false;
+    bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+#else
+    return kill(pid, 0) == 0 || errno != ESRCH;
+#endif
+}
+
+inline bool notify_predicate_matches(NotifyPredicate predicate, std::int64_t threshold, std::int64_t oldValue, std::int64_t newValue) {
+    switch (predicate) {
+    case NotifyPredicate::ANY_CHANGE: return oldValue != newValue;
+    case NotifyPredicate::ABOVE: return newValue >= threshold;
+    case NotifyPredicate::BELOW: return newValue <= threshold;
+    case NotifyPredicate::CROSSING: return (oldValue < threshold) != (newValue < threshold);
+    }
+    return false;
+}
+
+// Claim a subscription slot for the calling process, slots of dead processes are reclaimed; returns -1 if all slots are busy
+inline int notify_subscribe(NotifyHub* hub, std::int32_t pid, NotifyPredicate predicate, std::int64_t threshold) {
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < MAX_SUBSCRIBERS; ++i) {
+            Subscription* slot = &hub->subscribers[i];
+            std::int32_t owner = slot->ownerPid.load(std::memory_order_acquire);
+            bool reclaim = pass == 1 && owner > 0 && !process_alive(owner);
+            if (owner != 0 && !reclaim) continue;
+            if (!slot->ownerPid.compare_exchange_strong(owner, -1, std::memory_order_acq_rel)) continue;
+            slot->predicate.store(static_cast<std::int32_t>(predicate), std::memory_order_relaxed);
+            slot->threshold.store(threshold, std::memory_order_relaxed);
+            slot->ownerPid.store(pid, std::memory_order_release);
+            if (!reclaim) hub->activeSubscribers.fetch_add(1, std::memory_order_acq_rel);
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Release a subscription slot
+inline void notify_unsubscribe(NotifyHub* hub, int slotIndex) {
+    if (slotIndex < 0 || slotIndex >= MAX_SUBSCRIBERS) return;
+    hub->subscribers[slotIndex].ownerPid.store(0, std::memory_order_release);
+    hub->activeSubscribers.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// Called by a writer after the update is visible, wakes generation waiters and matching subscribers
+inline void notify_publish(NotifyHub* hub, std::int64_t oldValue, std::int64_t newValue) {
+    hub->generation.fetch_add(1); // seq_cst: pairs with the waiter's generationWaiters increment
+    if (hub->generationWaiters.load() != 0) {
+        shared_futex_wake(&hub->generation);
+    }
+    if (hub->activeSubscribers.load(std::memory_order_acquire) == 0) {
+        return;
+    }
+    for (int i = 0; i < MAX_SUBSCRIBERS; ++i) {
+        Subscription* slot = &hub->subscribers[i];
+        if (slot->ownerPid.load(std::memory_order_acquire) <= 0) continue;
+        NotifyPredicate predicate = static_cast<NotifyPredicate>(slot->predicate.load(std::memory_order_relaxed));
+        if (notify_predicate_matches(predicate, slot->threshold.load(std::memory_order_relaxed), oldValue, newValue)) {
+            slot->wakeSeq.fetch_add(1, std::memory_order_acq_rel);
+            shared_futex_wake(&slot->wakeSeq);
+        }
+    }
+}
+
+// Wait until the generation moves past *seenGeneration, returns false on timeout
+inline bool notify_wait_change(NotifyHub* hub, std::uint32_t* seenGeneration, int timeoutMs) {
+    std::uint32_t current = hub->generation.load(std::memory_order_acquire);
+    if (current == *seenGeneration) {
+        hub->generationWaiters.fetch_add(1);
+        bool woken = shared_futex_wait(&hub->generation, current, timeoutMs);
+        hub->generationWaiters.fetch_sub(1, std::memory_order_acq_rel);
+        current = hub->generation.load(std::memory_order_acquire);
+        if (!woken && current == *seenGeneration) return false;
+    }
+    *seenGeneration = current;
+    return true;
+}
+
+// Wait until the subscription's predicate matches, returns false on timeout
+inline bool notify_wait(NotifyHub* hub, int slotIndex, std::uint32_t* seenSeq, int timeoutMs) {
+    Subscription* slot = &hub->subscribers[slotIndex];
+    for (;;) {
+        std::uint32_t current = slot->wakeSeq.load(std::memory_order_acquire);
+        if (current != *seenSeq) {
+            *seenSeq = current;
+            return true;
+        }
+        if (!shared_futex_wait(&slot->wakeSeq, current, timeoutMs) &&
+            slot->wakeSeq.load(std::memory_order_acquire) == current) {
+            return false;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "notify.h"
+#include "shared_table.h"
+#include "lock_profiler.h"
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <unistd.h>
+#endif
+
+// Shared data
+// Writers are serialized by MUTEX_NAME and publish through the seqlock below,
+// readers take consistent snapshots without touching the mutex.
+struct SharedData {
+    std::atomic<std::uint32_t> sequence;      // Seqlock sequence, odd while a write is in progress
+    std::atomic<std::int64_t> counter;        // Counter value
+    std::atomic<std::int64_t> lastUpdateMs;   // Time of the last update (ms since epoch)
+    std::atomic<std::int32_t> lastWriterPid;  // PID of the last writer
+    std::atomic<std::uint64_t> updateCount;   // Total number of updates
+    NotifyHub notify;                         // Change notification for observers
+    SharedTable table;                        // Keyed state published by main, child1 and child2
+    LockProfile lockProfile;                  // Contention statistics of MUTEX_NAME, see lock_stats
+};
+
+// Consistent copy of the shared data taken by a reader
+struct SharedSnapshot {
+    std::int64_t counter;
+    std::int64_t lastUpdateMs;
+    std::int32_t lastWriterPid;
+    std::uint64_t updateCount;
+};
+
+inline std::int32_t current_process_id() {
+#ifdef _WIN32
+    return static_cast<std::int32_t>(GetCurrentProcessId());
+#else
+    return static_cast<std::int32_t>(getpid());
+#endif
+}
+
+inline std::int64_t current_time_ms_since_epoch() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Start a write section (caller must hold the writer mutex)
+inline void seqlock_write_begin(SharedData* sharedData) {
+    // A writer that died inside the section leaves the sequence odd; "| 1" keeps it odd instead of flipping it even
+    std::uint32_t seq = sharedData->sequence.load(std::memory_order_relaxed);
+    sharedData->sequence.store(seq | 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+// Finish a write section and make the new values visible to readers
+inline void seqlock_write_end(SharedData* sharedData) {
+    std::uint32_t seq = sharedData->sequence.load(std::memory_order_relaxed);
+    sharedData->sequence.store(seq + 1, std::memory_order_release);
+}
+
+// Read the current counter value (caller must hold the writer mutex)
+inline std::int64_t read_counter_locked(const SharedData* sharedData) {
+    return sharedData->counter.load(std::memory_order_relaxed);
+}
+
+// Set the counter, stamp the update metadata and wake observers (caller must hold the writer mutex)
+inline void write_shared_counter(SharedData* sharedData, std::int64_t value) {
+    std::int64_t oldValue = sharedData->counter.load(std::memory_order_relaxed);
+    seqlock_write_begin(sharedData);
+    sharedData->counter.store(value, std::memory_order_relaxed);
+    sharedData->lastUpdateMs.store(current_time_ms_since_epoch(), std::memory_order_relaxed);
+    sharedData->lastWriterPid.store(current_process_id(), std::memory_order_relaxed);
+    sharedData->updateCount.store(sharedData->updateCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    seqlock_write_end(sharedData);
+    notify_publish(&sharedData->notify, oldValue, value);
+}
+
+// Take a consistent snapshot of the shared data, never blocks writers
+inline SharedSnapshot read_shared_snapshot(const SharedData* sharedData) {
+    SharedSnapshot snapshot;
+    for (unsigned attempt = 0;; ++attempt) {
+        std::uint32_t begin = sharedData->sequence.load(std::memory_order_acquire);
+        if ((begin & 1u) == 0) {
+            snapshot.counter = sharedData->counter.load(std::memory_order_relaxed);
+            snapshot.lastUpdateMs = sharedData->lastUpdateMs.load(std::memory_order_relaxed);
+            snapshot.lastWriterPid = sharedData->lastWriterPid.load(std::memory_order_relaxed);
+            snapshot.updateCount = sharedData->updateCount.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sharedData->sequence.load(std::memory_order_relaxed) == begin) {
+                return snapshot;
+            }
+        }
+        if (attempt >= 64) {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#define SHARED_TABLE_CAPACITY 256  // Must be a power of two
+#define SHARED_TABLE_KEY_SIZE 32   // Including the terminating zero
+#define SHARED_TABLE_CLAIM_SPINS 100000 // Give up waiting on a slot whose writer never finished (crashed process)
+
+// Slot states, a slot only moves forward: EMPTY -> CLAIMED -> READY
+enum SharedTableSlotState : std::uint32_t {
+    SLOT_EMPTY = 0,
+    SLOT_CLAIMED = 1,  // Key is being written by the process that won the CAS
+    SLOT_READY = 2     // Key is immutable from now on
+};
+
+// One table entry, the key never changes once the slot is READY
+struct SharedTableEntry {
+    std::atomic<std::uint32_t> state;
+    std::atomic<std::uint32_t> hash;
+    char key[SHARED_TABLE_KEY_SIZE];
+    std::atomic<std::int64_t> value;
+    std::atomic<std::int64_t> updatedAtMs;
+};
+
+// Fixed capacity open addressing hash table that lives in the shared segment.
+// Lookups are lock-free, inserts claim a slot with CAS, value updates are atomic stores/adds.
+// Entries are never removed.
+struct SharedTable {
+    std::atomic<std::uint32_t> size;
+    SharedTableEntry entries[SHARED_TABLE_CAPACITY];
+};
+
+// FNV-1a hash of the key
+inline std::uint32_t shared_table_hash(const char* key) {
+    std::uint32_t hash = 2166136261u;
+    for (; *key != '\0'; ++key) {
+        hash ^= static_cast<unsigned char>(*key);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+inline std::int64_t shared_table_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Wait until a claimed slot becomes READY, returns false if its writer seems to have died
+inline bool shared_table_wait_ready(const SharedTableEntry* entry) {
+    for (int spin = 0; spin < SHARED_TABLE_CLAIM_SPINS; ++spin) {
+        if (entry->state.load(std::memory_order_acquire) == SLOT_READY) {
+            return true;
+        }
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+// Find the entry for key, inserting it if create is true; returns nullptr if the key is absent/too long or the table is full
+inline SharedTableEntry* shared_table_find(SharedTable* table, const char* key, bool create) {
+    size_t keyLength = strlen(key);
+    if (keyLength == 0 || keyLength >= SHARED_TABLE_KEY_SIZE) {
+        return nullptr;
+    }
+    std::uint32_t hash = shared_table_hash(key);
+    for (std::uint32_t probe = 0; probe < SHARED_TABLE_CAPACITY; ++probe) {
+        SharedTableEntry* entry = &table->entries[(hash + probe) & (SHARED_TABLE_CAPACITY - 1)];
+        std::uint32_t state = entry->state.load(std::memory_order_acquire);
+        if (state == SLOT_EMPTY) {
+            if (!create) {
+                return nullptr;
+            }
+            if (entry->state.compare_exchange_strong(state, SLOT_CLAIMED, std::memory_order_acq_rel)) {
+                memcpy(entry->key, key, keyLength + 1);
+                entry->hash.store(hash, std::memory_order_relaxed);
+                entry->updatedAtMs.store(shared_table_now_ms(), std::memory_order_relaxed);
+                entry->state.store(SLOT_READY, std::memory_order_release);
+                table->size.fetch_add(1, std::memory_order_relaxed);
+                return entry;
+            }
+            // Lost the race, state now holds the winner's state
+        }
+        if (state == SLOT_CLAIMED && !shared_table_wait_ready(entry)) {
+            continue;
+        }
+        if (entry->hash.load(std::memory_order_relaxed) == hash && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+// Set the value of key, inserting it if needed
+inline bool shared_table_set(SharedTable* table, const char* key, std::int64_t value) {
+    SharedTableEntry* entry = shared_table_find(table, key, true);
+    if (entry == nullptr) {
+        return false;
+    }
+    entry->value.store(value, std::memory_order_release);
+    entry->updatedAtMs.store(shared_table_now_ms(), std::memory_order_relaxed);
+    return true;
+}
+
+// Atomically add delta to the value of key (inserting it with 0 first), returns the new value
+inline std::int64_t shared_table_add(SharedTable* table, const char* key, std::int64_t delta) {
+    SharedTableEntry* entry = shared_table_find(table, key, true);
+    if (entry == nullptr) {
+        return 0;
+    }
+    std::int64_t value = entry->value.fetch_add(delta, std::memory_order_acq_rel) + delta;
+    entry->updatedAtMs.store(shared_table_now_ms(), std::memory_order_relaxed);
+    return value;
+}
+
+// Look up key without inserting it
+inline bool shared_table_get(SharedTable* table, const char* key, std::int64_t* value) {
+    SharedTableEntry* entry = shared_table_find(table, key, false);
+    if (entry == nullptr) {
+        return false;
+    }
+    *value = entry->value.load(std::memory_order_acquire);
+    return true;
+}
+
+// All READY entries as "key=value" pairs for the log
+inline std::string format_shared_table(const SharedTable* table) {
+    std::ostringstream oss;
+    bool first = true;
+    for (const SharedTableEntry& entry : table->entries) {
+        if (entry.state.load(std::memory_order_acquire) != SLOT_READY) continue;
+        oss << (first ? "" : ", ") << entry.key << "=" << entry.value.load(std::memory_order_relaxed);
+        first = false;
+    }
+    return oss.str();
+}
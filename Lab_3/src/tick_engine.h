@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <cerrno>
+#    include <time.h>
+#endif
+
+constexpr std::int64_t NS_IN_SEC = 1000000000LL;
+constexpr double MAX_TICK_RATE_HZ = 10000.0;
+constexpr int JITTER_BUCKETS = 24; // Bucket 0: < 1 us, bucket i: < 2^i us, last bucket: everything above
+
+// Histogram of tick lateness, written by the tick thread and read by the logger
+struct JitterHistogram {
+    std::atomic<std::uint64_t> buckets[JITTER_BUCKETS];
+    std::atomic<std::uint64_t> ticks;        // Number of wake-ups
+    std::atomic<std::uint64_t> missedTicks;  // Periods that were caught up in a later wake-up
+    std::atomic<std::uint64_t> maxLatenessNs;
+};
+
+// Drift-free periodic tick source based on absolute deadlines
+struct TickEngine {
+    std::int64_t periodNs;
+    std::int64_t nextDeadlineNs; // Monotonic clock
+    JitterHistogram* histogram;
+};
+
+// Monotonic clock in nanoseconds
+inline std::int64_t monotonic_now_ns() {
+#ifdef _WIN32
+    static LARGE_INTEGER freq = [] { LARGE_INTEGER f; QueryPerformanceFrequency(&f); return f; }();
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<std::int64_t>((counter.QuadPart / freq.QuadPart) * NS_IN_SEC +
+                                     (counter.QuadPart % freq.QuadPart) * NS_IN_SEC / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * NS_IN_SEC + ts.tv_nsec;
+#endif
+}
+
+// Convert a tick rate to a period, returns 0 if the rate is out of (0, MAX_TICK_RATE_HZ]
+inline std::int64_t tick_period_from_rate(double rateHz) {
+    if (!(rateHz > 0.0) || rateHz > MAX_TICK_RATE_HZ) {
+        return 0;
+    }
+    return static_cast<std::int64_t>(NS_IN_SEC / rateHz + 0.5);
+}
+
+// Start the engine, the first deadline is one period from now
+inline void tick_engine_init(TickEngine* engine, std::int64_t periodNs, JitterHistogram* histogram) {
+    engine->periodNs = periodNs;
+    engine->nextDeadlineNs = monotonic_now_ns() + periodNs;
+    engine->histogram = histogram;
+}
+
+// Record the lateness of one wake-up
+inline void record_jitter(JitterHistogram* histogram, std::int64_t latenessNs, std::uint64_t missed) {
+    std::uint64_t lateUs = latenessNs > 0 ? static_cast<std::uint64_t>(latenessNs) / 1000 : 0;
+    int bucket = 0;
+    while (lateUs > 0 && bucket < JITTER_BUCKETS - 1) {
+        lateUs >>= 1;
+        ++bucket;
+    }
+    histogram->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram->ticks.fetch_add(1, std::memory_order_relaxed);
+    histogram->missedTicks.fetch_add(missed, std::memory_order_relaxed);
+    std::uint64_t lateness = latenessNs > 0 ? static_cast<std::uint64_t>(latenessNs) : 0;
+    std::uint64_t currentMax = histogram->maxLatenessNs.load(std::memory_order_relaxed);
+    while (lateness > currentMax &&
+           !histogram->maxLatenessNs.compare_exchange_weak(currentMax, lateness, std::memory_order_relaxed)) {
+    }
+}
+
+// Sleep until the next deadline and return how many periods have elapsed (>= 1, more if ticks were missed)
+inline std::uint64_t tick_engine_wait(TickEngine* engine) {
+#ifdef _WIN32
+    for (;;) {
+        std::int64_t remainingNs = engine->nextDeadlineNs - monotonic_now_ns();
+        if (remainingNs <= 0) break;
+        if (remainingNs > 2000000) Sleep(static_cast<DWORD>(remainingNs / 1000000 - 1));
+        else SwitchToThread();
+    }
+#else
+    struct timespec deadline;
+    deadline.tv_sec = engine->nextDeadlineNs / NS_IN_SEC;
+    deadline.tv_nsec = engine->nextDeadlineNs % NS_IN_SEC;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+#endif
+    std::int64_t latenessNs = monotonic_now_ns() - engine->nextDeadlineNs;
+    std::uint64_t elapsed = 1;
+    if (latenessNs >= engine->periodNs) {
+        elapsed += static_cast<std::uint64_t>(latenessNs / engine->periodNs);
+    }
+    engine->nextDeadlineNs += static_cast<std::int64_t>(elapsed) * engine->periodNs;
+    if (engine->histogram != nullptr) {
+        record_jitter(engine->histogram, latenessNs, elapsed - 1);
+    }
+    return elapsed;
+}
+
+// Human readable histogram for the log, empty buckets are skipped
+inline std::string format_jitter_histogram(const JitterHistogram* histogram) {
+    std::ostringstream oss;
+    oss << "ticks: " << histogram->ticks.load(std::memory_order_relaxed)
+        << ", missed: " << histogram->missedTicks.load(std::memory_order_relaxed)
+        << ", max: " << histogram->maxLatenessNs.load(std::memory_order_relaxed) / 1000 << " us, lateness:";
+    for (int i = 0; i < JITTER_BUCKETS; ++i) {
+        std::uint64_t count = histogram->buckets[i].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        if (i == JITTER_BUCKETS - 1) oss << " >=" << (1ULL << (i - 1)) << "us:" << count;
+        else oss << " <" << (1ULL << i) << "us:" << count;
+    }
+    return oss.str();
+}
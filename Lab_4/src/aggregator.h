@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <thread>
+#include <vector>
+
+// Per-sensor statistics of one period (count, sum, min, max and M2 for the variance, Welford's method)
+struct PeriodStats {
+    std::uint64_t count = 0;
+    double sum = 0.0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double value) {
+        ++count;
+        sum += value;
+        double delta = value - mean;
+        mean += delta / static_cast<double>(count);
+        m2 += delta * (value - mean);
+        if (value < min) min = value;
+        if (value > max) max = value;
+    }
+
+    // Combine with the statistics of other values (Chan et al.'s parallel variance)
+    void merge(const PeriodStats& other) {
+        if (other.count == 0) return;
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        double total = static_cast<double>(count + other.count);
+        double delta = other.mean - mean;
+        m2 += other.m2 + delta * delta * static_cast<double>(count) * static_cast<double>(other.count) / total;
+        mean += delta * static_cast<double>(other.count) / total;
+        count += other.count;
+        sum += other.sum;
+        if (other.min < min) min = other.min;
+        if (other.max > max) max = other.max;
+    }
+
+    double average() const { return count > 0 ? mean : 0.0; }
+    double minimum() const { return count > 0 ? min : 0.0; }
+    double maximum() const { return count > 0 ? max : 0.0; }
+    double stddev() const { return count > 1 ? std::sqrt(m2 / static_cast<double>(count)) : 0.0; }  // Population
+};
+
+// Accumulators of all sensors for one period kind (hour, day), updated by a single reader thread without locks.
+// There are two generations of accumulators: the reader adds to the current one, rollover() switches the
+// generation atomically and hands the finished one to the emitting thread. Each generation carries the time
+// its period ends, so a snapshot of the period in progress knows when it is due.
+//
+// state: high 32 bits - generation, low 32 bits - updates in progress. An update announces itself with one
+// fetch_add that also tells it which generation to use; rollover() bumps the generation and waits only for an
+// update that may still be writing to the old one.
+class Aggregator {
+public:
+    explicit Aggregator(size_t sensors) {
+        generations[0].resize(sensors);
+        generations[1].resize(sensors);
+    }
+
+    // Reader thread
+    void add(size_t sensor, double value) {
+        std::uint64_t current = state.fetch_add(1, std::memory_order_acquire);
+        generations[(current >> 32) & 1][sensor].add(value);
+        state.fetch_sub(1, std::memory_order_release);
+    }
+
+    // Reader thread: statistics and end time of the period in progress (checkpoints)
+    std::time_t snapshot(std::vector<PeriodStats>& current) {
+        std::uint64_t now = state.fetch_add(1, std::memory_order_acquire);
+        size_t generation = (now >> 32) & 1;
+        current = generations[generation];
+        std::time_t end = periodEnds[generation].load(std::memory_order_relaxed);
+        state.fetch_sub(1, std::memory_order_release);
+        return end;
+    }
+
+    // Before the threads start: continue a period (restored statistics may be empty)
+    void restore(const std::vector<PeriodStats>& current, std::time_t end) {
+        size_t generation = (state.load(std::memory_order_relaxed) >> 32) & 1;
+        if (current.size() == generations[generation].size()) generations[generation] = current;
+        periodEnds[generation].store(end, std::memory_order_relaxed);
+    }
+
+    std::time_t period_end() const { return periodEnds[(state.load(std::memory_order_acquire) >> 32) & 1].load(std::memory_order_relaxed); }
+
+    // Emitting thread: close the period, copy out its statistics and clear them for reuse; the next one ends at nextEnd
+    void rollover(std::vector<PeriodStats>& finished, std::time_t nextEnd) {
+        periodEnds[((state.load(std::memory_order_relaxed) >> 32) + 1) & 1].store(nextEnd, std::memory_order_relaxed);
+        std::uint64_t previous = state.fetch_add(GENERATION, std::memory_order_acq_rel);
+        while ((state.load(std::memory_order_acquire) & IN_PROGRESS_MASK) != 0) {
+            std::this_thread::yield();
+        }
+        std::vector<PeriodStats>& old = generations[(previous >> 32) & 1];
+        finished = old;
+        for (PeriodStats& stats : old) stats = PeriodStats();
+    }
+
+    size_t sensors() const { return generations[0].size(); }
+
+private:
+    static constexpr std::uint64_t GENERATION = std::uint64_t(1) << 32;
+    static constexpr std::uint64_t IN_PROGRESS_MASK = GENERATION - 1;
+
+    std::atomic<std::uint64_t> state{0};
+    std::vector<PeriodStats> generations[2];
+    std::atomic<std::time_t> periodEnds[2] = {{0}, {0}};
+};
@@ -0,0 +1,165 @@
+// Size and speed of the compressed archive blocks against the binary and text logs, for samples like temperature_simulator's
+// Usage: archive_bench [--samples <n>] [--sensors <n>] [--period <ms>] [--jitter <ms>] [--seed <n>]
+// Meaningful with optimizations only: cmake -DCMAKE_BUILD_TYPE=Release
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include "archive_log.h"
+
+#define BENCH_TEXT_RECORD_LENGTH 48   // SerialLogger RECORD_LENGTH
+
+struct BenchOptions {
+    long long samples = 2000000;   // Per sensor
+    int sensors = 4;
+    int periodMs = 100;            // PORT_SPEED_MS
+    int jitterMs = 3;              // Arrival jitter of the timestamps
+    std::uint32_t seed = 1;
+};
+
+// Readings of every sensor in arrival order: a random walk of +-0.3 sent with one decimal
+std::vector<BinaryLogRecord> generate_samples(const BenchOptions& options) {
+    std::vector<BinaryLogRecord> records;
+    records.reserve(static_cast<size_t>(options.samples) * options.sensors);
+    std::mt19937 gen(options.seed);
+    std::uniform_real_distribution<> start(5, 25), change(-0.3, 0.3);
+    std::uniform_int_distribution<> jitter(0, options.jitterMs);
+    std::vector<double> temps(options.sensors);
+    for (double& temp : temps) temp = start(gen);
+    std::int64_t baseMs = 1704067200000;   // 2024-01-01
+    char text[32];
+    for (long long i = 0; i < options.samples; ++i) {
+        for (int sensor = 0; sensor < options.sensors; ++sensor) {
+            snprintf(text, sizeof(text), "%.1f", temps[sensor]);
+            records.push_back({baseMs + i * options.periodMs + jitter(gen), static_cast<std::uint16_t>(sensor), strtof(text, nullptr)});
+            temps[sensor] += change(gen);
+        }
+    }
+    return records;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    bool validArgs = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        long long number = i + 1 < argc ? atoll(argv[i + 1]) : -1;
+        if (arg == "--samples" && number > 0) options.samples = number;
+        else if (arg == "--sensors" && number > 0 && number <= BINARY_LOG_MAX_SENSORS) options.sensors = static_cast<int>(number);
+        else if (arg == "--period" && number > 0) options.periodMs = static_cast<int>(number);
+        else if (arg == "--jitter" && number >= 0) options.jitterMs = static_cast<int>(number);
+        else if (arg == "--seed" && number >= 0) options.seed = static_cast<std::uint32_t>(number);
+        else validArgs = false;
+        ++i;
+    }
+    if (!validArgs) {
+        std::cerr << "Usage: " << argv[0] << " [--samples <n>] [--sensors <n>] [--period <ms>] [--jitter <ms>] [--seed <n>]" << std::endl;
+        return 1;
+    }
+
+    std::vector<BinaryLogRecord> samples = generate_samples(options);
+    double total = static_cast<double>(samples.size());
+
+    // Encode the way ArchiveLogWriter does, into memory
+    std::vector<unsigned char> archive;
+    archive.reserve(samples.size() * 4);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<ArchiveBlockEncoder> encoders(options.sensors);
+    for (const BinaryLogRecord& sample : samples) {
+        ArchiveBlockEncoder& encoder = encoders[sample.sensor];
+        if (!encoder.accepts(sample.timeMs)) encoder.finish(sample.sensor, archive);
+        encoder.append(sample.timeMs, sample.value);
+    }
+    for (int sensor = 0; sensor < options.sensors; ++sensor) {
+        if (encoders[sensor].count() > 0) encoders[sensor].finish(static_cast<std::uint16_t>(sensor), archive);
+    }
+    double encodeSeconds = seconds_since(start);
+
+    // Decode every block
+    std::vector<ArchiveBlock> blocks;
+    for (size_t offset = 0; offset < archive.size();) {
+        ArchiveBlock block;
+        if (!archive_log_parse_block(&archive[offset], archive.size() - offset, block)) {
+            std::cerr << "Bad block at " << offset << std::endl;
+            return 1;
+        }
+        blocks.push_back(block);
+        offset += ARCHIVE_LOG_BLOCK_HEADER_SIZE + block.payloadSize;
+    }
+    std::vector<BinaryLogRecord> decoded;
+    decoded.reserve(samples.size());
+    start = std::chrono::steady_clock::now();
+    for (const ArchiveBlock& block : blocks) {
+        if (!archive_log_decode(block, decoded)) {
+            std::cerr << "Cannot decode a block" << std::endl;
+            return 1;
+        }
+    }
+    double decodeSeconds = seconds_since(start);
+
+    // Every sample comes back, per sensor in its order
+    std::vector<std::vector<BinaryLogRecord>> expected(options.sensors), actual(options.sensors);
+    for (const BinaryLogRecord& sample : samples) expected[sample.sensor].push_back(sample);
+    for (const BinaryLogRecord& sample : decoded) actual[sample.sensor].push_back(sample);
+    for (int sensor = 0; sensor < options.sensors; ++sensor) {
+        for (size_t i = 0; i < expected[sensor].size(); ++i) {
+            if (actual[sensor].size() != expected[sensor].size() || actual[sensor][i].timeMs != expected[sensor][i].timeMs ||
+                actual[sensor][i].value != expected[sensor][i].value) {
+                std::cerr << "Sensor " << sensor << " differs at sample " << i << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Statistics of all samples: from the block headers, and by decoding
+    start = std::chrono::steady_clock::now();
+    std::vector<PeriodStats> fromHeaders(options.sensors);
+    for (const ArchiveBlock& block : blocks) fromHeaders[block.sensor].merge(block.stats);
+    double headerSeconds = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    std::vector<PeriodStats> fromSamples(options.sensors);
+    decoded.clear();
+    for (const ArchiveBlock& block : blocks) {
+        archive_log_decode(block, decoded);
+        for (const BinaryLogRecord& sample : decoded) fromSamples[sample.sensor].add(sample.value);
+        decoded.clear();
+    }
+    double scanSeconds = seconds_since(start);
+
+    double archiveBytes = static_cast<double>(archive.size());
+    std::cout << samples.size() << " samples, " << options.sensors << " sensors, every " << options.periodMs << " ms +- "
+              << options.jitterMs << " ms, " << blocks.size() << " blocks" << std::endl << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(24) << "bytes/sample" << std::right << std::setw(10) << archiveBytes / total
+              << "  (binary log " << BINARY_LOG_RECORD_SIZE << ", " << BINARY_LOG_RECORD_SIZE * total / archiveBytes << "x; text log "
+              << BENCH_TEXT_RECORD_LENGTH << ", " << BENCH_TEXT_RECORD_LENGTH * total / archiveBytes << "x)" << std::endl;
+    std::cout << std::left << std::setw(24) << "encode" << std::right << std::setw(10) << total / encodeSeconds / 1e6
+              << " M samples/s" << std::endl;
+    std::cout << std::left << std::setw(24) << "decode" << std::right << std::setw(10) << total / decodeSeconds / 1e6
+              << " M samples/s" << std::endl;
+    std::cout << std::left << std::setw(24) << "stats from headers" << std::right << std::setw(10) << headerSeconds * 1e3
+              << " ms" << std::endl;
+    std::cout << std::left << std::setw(24) << "stats by decoding" << std::right << std::setw(10) << scanSeconds * 1e3
+              << " ms" << std::endl;
+    for (int sensor = 0; sensor < options.sensors; ++sensor) {
+        if (fromHeaders[sensor].count != fromSamples[sensor].count || fromHeaders[sensor].minimum() != fromSamples[sensor].minimum() ||
+            fromHeaders[sensor].maximum() != fromSamples[sensor].maximum() ||
+            std::abs(fromHeaders[sensor].average() - fromSamples[sensor].average()) > 1e-6 ||
+            std::abs(fromHeaders[sensor].stddev() - fromSamples[sensor].stddev()) > 1e-6) {
+            std::cerr << "Statistics of sensor " << sensor << " differ" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
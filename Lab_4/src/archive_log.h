@@ -0,0 +1,560 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+#include "binary_log.h"
+#include "aggregator.h"
+#include "log_query.h"
+
+// Long-term archive of the samples, compressed like Gorilla (delta-of-delta times, XOR-ed values):
+//   file header  (ARCHIVE_LOG_HEADER_SIZE bytes, CRC-32 protected) followed by the sensor id table
+//                (BINARY_LOG_SENSOR_ID_SIZE bytes per sensor, zero padded), as in binary_log.h
+//   blocks       samples of one sensor in time order: block header (ARCHIVE_LOG_BLOCK_HEADER_SIZE bytes) + payload
+//   block header sensor, count, first and last time (ms), min, max, sum and M2 of the values, payload size,
+//                payload CRC-32 and its own CRC-32. Aggregates over whole blocks come from the headers alone
+//   payload      bit stream, most significant bit first: the first value as 32 raw bits, then for every other
+//                sample the delta-of-delta of the time in ms (the first delta counts from 0)
+//                  '0'                        0
+//                  '10'   + 7 bits            [-64, 63]
+//                  '110'  + 9 bits            [-256, 255]
+//                  '1110' + 12 bits           [-2048, 2047]
+//                  '1111' + 32 bits           any other 32-bit value
+//                and the XOR of the float32 value with the previous one
+//                  '0'                        same value
+//                  '10'   + meaningful bits   inside the previous window of leading and trailing zeros
+//                  '11'   + 5 bits leading zeros + 5 bits length - 1 + meaningful bits
+// All integers in headers are little-endian.
+
+#define ARCHIVE_LOG_MAGIC "SENSARC1"
+#define ARCHIVE_LOG_VERSION 1
+#define ARCHIVE_LOG_HEADER_SIZE 64
+#define ARCHIVE_LOG_BLOCK_MAGIC 0x43524153u  // "SARC"
+#define ARCHIVE_LOG_BLOCK_HEADER_SIZE 64
+#define ARCHIVE_LOG_BLOCK_SAMPLES 1024       // Samples per block at most
+#define ARCHIVE_LOG_BLOCK_MS 600000          // A partial block is written once its first sample is this old
+
+inline int archive_log_leading_zeros(std::uint32_t value) {   // value != 0
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return 31 - static_cast<int>(index);
+#else
+    return __builtin_clz(value);
+#endif
+}
+
+inline int archive_log_trailing_zeros(std::uint32_t value) {   // value != 0
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+// Appends bits, most significant first
+class ArchiveBitWriter {
+public:
+    void clear() {
+        bytes.clear();
+        buffer = 0;
+        used = 0;
+    }
+
+    // The low count bits of value, count <= 32
+    void write(std::uint64_t value, int count) {
+        buffer = (buffer << count) | (value & ((1ULL << count) - 1));
+        used += count;
+        while (used >= 8) {
+            used -= 8;
+            bytes.push_back(static_cast<unsigned char>(buffer >> used));
+        }
+    }
+
+    // The stream with its last byte padded with zeros; clear() before writing again
+    const std::vector<unsigned char>& finish() {
+        if (used > 0) {
+            bytes.push_back(static_cast<unsigned char>(buffer << (8 - used)));
+            used = 0;
+        }
+        return bytes;
+    }
+
+private:
+    std::vector<unsigned char> bytes;
+    std::uint64_t buffer = 0;
+    int used = 0;   // Bits of buffer not yet in bytes
+};
+
+class ArchiveBitReader {
+public:
+    ArchiveBitReader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    // count <= 32 bits; false past the end of the stream
+    bool read(int count, std::uint32_t& value) {
+        if (available < count) {
+            // Top up to 57..64 bits at once; the bits above them were read already
+            while (available <= 56 && offset < size) {
+                buffer = (buffer << 8) | data[offset++];
+                available += 8;
+            }
+            if (available < count) return false;
+        }
+        available -= count;
+        value = static_cast<std::uint32_t>((buffer >> available) & ((1ULL << count) - 1));
+        return true;
+    }
+
+private:
+    const unsigned char* data;
+    size_t size;
+    size_t offset = 0;
+    std::uint64_t buffer = 0;
+    int available = 0;
+};
+
+// Header of a block; the payload is not copied
+struct ArchiveBlock {
+    std::uint16_t sensor = 0;
+    std::uint32_t count = 0;
+    std::int64_t firstMs = 0;
+    std::int64_t lastMs = 0;
+    PeriodStats stats;
+    const unsigned char* payload = nullptr;
+    size_t payloadSize = 0;
+    std::uint32_t payloadCrc = 0;
+};
+
+// Samples of one sensor, encoded as they come
+class ArchiveBlockEncoder {
+public:
+    size_t count() const { return stats.count; }
+    std::int64_t first_time() const { return firstMs; }
+
+    // Whether the sample may join the block: blocks are in time order and hold up to ARCHIVE_LOG_BLOCK_SAMPLES
+    bool accepts(std::int64_t timeMs) const {
+        if (stats.count == 0) return true;
+        if (stats.count >= ARCHIVE_LOG_BLOCK_SAMPLES || timeMs < lastMs) return false;
+        std::int64_t deltaOfDelta = timeMs - lastMs - lastDelta;
+        return deltaOfDelta >= INT32_MIN && deltaOfDelta <= INT32_MAX;
+    }
+
+    void append(std::int64_t timeMs, float value) {
+        std::uint32_t valueBits;
+        memcpy(&valueBits, &value, sizeof(valueBits));
+        if (stats.count == 0) {
+            bits.clear();
+            bits.write(valueBits, 32);
+            firstMs = timeMs;
+            lastDelta = 0;
+            leading = -1;
+        }
+        else {
+            std::int64_t delta = timeMs - lastMs;
+            write_time(delta - lastDelta);
+            write_value(valueBits ^ lastBits);
+            lastDelta = delta;
+        }
+        lastMs = timeMs;
+        lastBits = valueBits;
+        stats.add(value);
+    }
+
+    // Appends the block of sensor (header and payload) to out and starts a new one
+    void finish(std::uint16_t sensor, std::vector<unsigned char>& out) {
+        const std::vector<unsigned char>& payload = bits.finish();
+        unsigned char header[ARCHIVE_LOG_BLOCK_HEADER_SIZE] = {};
+        float minValue = static_cast<float>(stats.min);
+        float maxValue = static_cast<float>(stats.max);
+        std::uint32_t minBits, maxBits;
+        std::uint64_t sumBits, m2Bits;
+        memcpy(&minBits, &minValue, sizeof(minBits));
+        memcpy(&maxBits, &maxValue, sizeof(maxBits));
+        memcpy(&sumBits, &stats.sum, sizeof(sumBits));
+        memcpy(&m2Bits, &stats.m2, sizeof(m2Bits));
+        binary_log_put32(&header[0], ARCHIVE_LOG_BLOCK_MAGIC);
+        binary_log_put16(&header[4], sensor);
+        binary_log_put16(&header[6], static_cast<std::uint16_t>(stats.count));
+        binary_log_put64(&header[8], static_cast<std::uint64_t>(firstMs));
+        binary_log_put64(&header[16], static_cast<std::uint64_t>(lastMs));
+        binary_log_put32(&header[24], minBits);
+        binary_log_put32(&header[28], maxBits);
+        binary_log_put64(&header[32], sumBits);
+        binary_log_put64(&header[40], m2Bits);
+        binary_log_put32(&header[48], static_cast<std::uint32_t>(payload.size()));
+        binary_log_put32(&header[52], binary_log_crc32(payload.data(), payload.size()));
+        binary_log_put32(&header[56], binary_log_crc32(header, 56));
+        out.insert(out.end(), header, header + ARCHIVE_LOG_BLOCK_HEADER_SIZE);
+        out.insert(out.end(), payload.begin(), payload.end());
+        stats = PeriodStats();
+    }
+
+private:
+    void write_time(std::int64_t deltaOfDelta) {
+        std::uint64_t bitsOf = static_cast<std::uint64_t>(deltaOfDelta);
+        if (deltaOfDelta == 0) {
+            bits.write(0, 1);
+        }
+        else if (deltaOfDelta >= -64 && deltaOfDelta <= 63) {
+            bits.write(0x2, 2);
+            bits.write(bitsOf, 7);
+        }
+        else if (deltaOfDelta >= -256 && deltaOfDelta <= 255) {
+            bits.write(0x6, 3);
+            bits.write(bitsOf, 9);
+        }
+        else if (deltaOfDelta >= -2048 && deltaOfDelta <= 2047) {
+            bits.write(0xE, 4);
+            bits.write(bitsOf, 12);
+        }
+        else {
+            bits.write(0xF, 4);
+            bits.write(bitsOf, 32);
+        }
+    }
+
+    void write_value(std::uint32_t xored) {
+        if (xored == 0) {
+            bits.write(0, 1);
+            return;
+        }
+        int lead = archive_log_leading_zeros(xored);
+        int trail = archive_log_trailing_zeros(xored);
+        if (leading >= 0 && lead >= leading && trail >= trailing) {
+            bits.write(0x2, 2);
+            bits.write(xored >> trailing, 32 - leading - trailing);
+            return;
+        }
+        leading = lead;
+        trailing = trail;
+        int length = 32 - lead - trail;
+        bits.write(0x3, 2);
+        bits.write(static_cast<std::uint64_t>(lead), 5);
+        bits.write(static_cast<std::uint64_t>(length - 1), 5);
+        bits.write(xored >> trail, length);
+    }
+
+    ArchiveBitWriter bits;
+    PeriodStats stats;
+    std::int64_t firstMs = 0;
+    std::int64_t lastMs = 0;
+    std::int64_t lastDelta = 0;
+    std::uint32_t lastBits = 0;
+    int leading = -1;   // Window of the last '11' value, none yet
+    int trailing = 0;
+};
+
+// Block header at data (available bytes); false if it is not one or its CRC does not match
+inline bool archive_log_parse_block(const unsigned char* data, size_t available, ArchiveBlock& block) {
+    if (available < ARCHIVE_LOG_BLOCK_HEADER_SIZE || binary_log_get32(data) != ARCHIVE_LOG_BLOCK_MAGIC ||
+        binary_log_crc32(data, 56) != binary_log_get32(data + 56)) {
+        return false;
+    }
+    block.sensor = binary_log_get16(data + 4);
+    block.count = binary_log_get16(data + 6);
+    block.firstMs = static_cast<std::int64_t>(binary_log_get64(data + 8));
+    block.lastMs = static_cast<std::int64_t>(binary_log_get64(data + 16));
+    std::uint32_t minBits = binary_log_get32(data + 24), maxBits = binary_log_get32(data + 28);
+    std::uint64_t sumBits = binary_log_get64(data + 32), m2Bits = binary_log_get64(data + 40);
+    float minValue, maxValue;
+    memcpy(&minValue, &minBits, sizeof(minValue));
+    memcpy(&maxValue, &maxBits, sizeof(maxValue));
+    block.stats = PeriodStats();
+    block.stats.count = block.count;
+    block.stats.min = minValue;
+    block.stats.max = maxValue;
+    memcpy(&block.stats.sum, &sumBits, sizeof(block.stats.sum));
+    memcpy(&block.stats.m2, &m2Bits, sizeof(block.stats.m2));
+    block.stats.mean = block.count > 0 ? block.stats.sum / block.count : 0.0;
+    block.payload = data + ARCHIVE_LOG_BLOCK_HEADER_SIZE;
+    block.payloadSize = binary_log_get32(data + 48);
+    block.payloadCrc = binary_log_get32(data + 52);
+    return block.count > 0;
+}
+
+// Appends the samples of a block to records; false if the payload is damaged
+inline bool archive_log_decode(const ArchiveBlock& block, std::vector<BinaryLogRecord>& records) {
+    if (binary_log_crc32(block.payload, block.payloadSize) != block.payloadCrc) {
+        return false;
+    }
+    ArchiveBitReader in(block.payload, block.payloadSize);
+    std::uint32_t valueBits, bits;
+    if (!in.read(32, valueBits)) return false;
+    std::int64_t timeMs = block.firstMs;
+    std::int64_t delta = 0;
+    int leading = -1, trailing = 0;
+    float value;
+    memcpy(&value, &valueBits, sizeof(value));
+    records.push_back({timeMs, block.sensor, value});
+    for (std::uint32_t i = 1; i < block.count; ++i) {
+        int ones = 0;
+        while (ones < 4) {
+            if (!in.read(1, bits)) return false;
+            if (bits == 0) break;
+            ++ones;
+        }
+        if (ones > 0) {
+            static const int widths[] = {0, 7, 9, 12, 32};
+            int width = widths[ones];
+            if (!in.read(width, bits)) return false;
+            // Sign-extend width bits
+            delta += static_cast<std::int32_t>(bits << (32 - width)) >> (32 - width);
+        }
+        timeMs += delta;
+
+        if (!in.read(1, bits)) return false;
+        if (bits != 0) {
+            if (!in.read(1, bits)) return false;
+            if (bits != 0) {
+                std::uint32_t lead, length;
+                if (!in.read(5, lead) || !in.read(5, length)) return false;
+                leading = static_cast<int>(lead);
+                trailing = 32 - leading - static_cast<int>(length + 1);
+                if (trailing < 0) return false;
+            }
+            else if (leading < 0) {
+                return false;
+            }
+            std::uint32_t meaningful;
+            if (!in.read(32 - leading - trailing, meaningful)) return false;
+            valueBits ^= meaningful << trailing;
+        }
+        memcpy(&value, &valueBits, sizeof(value));
+        records.push_back({timeMs, block.sensor, value});
+    }
+    return timeMs == block.lastMs;
+}
+
+// Walks the blocks of an archive, mapped rather than read; blocks with a bad header are skipped and counted
+class ArchiveLogReader {
+public:
+    // Returns false if the file cannot be read or its header is invalid
+    bool open(const std::string& path) {
+        if (!file.open(path)) {
+            error = "cannot open " + path;
+            return false;
+        }
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+        size = static_cast<size_t>(file.file_size());
+        if (size < ARCHIVE_LOG_HEADER_SIZE || memcmp(data, ARCHIVE_LOG_MAGIC, 8) != 0) {
+            error = "not a sensor archive";
+            return false;
+        }
+        size_t headerSize = binary_log_get16(data + 10);
+        size_t sensorCount = binary_log_get16(data + 16);
+        if (binary_log_get16(data + 8) != ARCHIVE_LOG_VERSION ||
+            headerSize != ARCHIVE_LOG_HEADER_SIZE + sensorCount * BINARY_LOG_SENSOR_ID_SIZE || size < headerSize) {
+            error = "unsupported header";
+            return false;
+        }
+        std::vector<unsigned char> check(data, data + headerSize);
+        binary_log_put32(&check[60], 0);
+        if (binary_log_crc32(check.data(), check.size()) != binary_log_get32(data + 60)) {
+            error = "header CRC mismatch";
+            return false;
+        }
+        sensors.clear();
+        for (size_t i = 0; i < sensorCount; ++i) {
+            const char* id = reinterpret_cast<const char*>(data + ARCHIVE_LOG_HEADER_SIZE + i * BINARY_LOG_SENSOR_ID_SIZE);
+            sensors.emplace_back(id, strnlen(id, BINARY_LOG_SENSOR_ID_SIZE));
+        }
+        firstBlock = headerSize;
+        rewind();
+        return true;
+    }
+
+    void rewind() {
+        offset = firstBlock;
+        validEnd = firstBlock;
+        badBlocks = 0;
+        truncated = false;
+    }
+
+    // The next block with a valid header, false at the end of the file
+    bool next_block(ArchiveBlock& block) {
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+        while (offset + ARCHIVE_LOG_BLOCK_HEADER_SIZE <= size) {
+            if (!archive_log_parse_block(data + offset, size - offset, block) || block.sensor >= sensors.size()) {
+                if (binary_log_get32(data + offset) == ARCHIVE_LOG_BLOCK_MAGIC) ++badBlocks;
+                ++offset;   // Lost sync, look for the next block header
+                continue;
+            }
+            if (offset + ARCHIVE_LOG_BLOCK_HEADER_SIZE + block.payloadSize > size) {
+                truncated = true;   // Last block was cut short (crash while writing)
+                break;
+            }
+            offset += ARCHIVE_LOG_BLOCK_HEADER_SIZE + block.payloadSize;
+            validEnd = offset;
+            return true;
+        }
+        offset = size;
+        return false;
+    }
+
+    const std::vector<std::string>& sensor_ids() const { return sensors; }
+    std::uint64_t valid_end() const { return validEnd; }   // End of the last whole block read so far
+    std::uint64_t file_size() const { return size; }
+    size_t bad_blocks() const { return badBlocks; }
+    bool is_truncated() const { return truncated; }
+    const std::string& last_error() const { return error; }
+
+private:
+    MappedFile file;
+    size_t size = 0;
+    std::vector<std::string> sensors;
+    size_t firstBlock = 0;
+    size_t offset = 0;
+    size_t validEnd = 0;
+    size_t badBlocks = 0;
+    bool truncated = false;
+    std::string error;
+};
+
+// Appends samples to an archive that is never rotated. Each sensor fills its own block, which is written
+// when full, when the next sample does not fit it, or ARCHIVE_LOG_BLOCK_MS after its first sample
+class ArchiveLogWriter {
+public:
+    ~ArchiveLogWriter() { close(); }
+
+    // Continue the archive at path, or create it if it is missing or empty. An archive of other sensors, or a
+    // file that is not an archive, is left alone
+    bool open(const std::string& path, const std::vector<std::string>& sensorIds) {
+        close();
+        if (sensorIds.size() > BINARY_LOG_MAX_SENSORS) {
+            error = "too many sensors";
+            return false;
+        }
+        std::uint64_t validEnd = 0;
+        std::ifstream existing(path, std::ios::binary | std::ios::ate);
+        if (existing.is_open() && existing.tellg() > 0) {
+            existing.close();
+            ArchiveLogReader reader;
+            if (!reader.open(path)) {
+                error = path + ": " + reader.last_error();
+                return false;
+            }
+            if (reader.sensor_ids() != sensorIds) {
+                error = path + " holds other sensors";
+                return false;
+            }
+            ArchiveBlock block;
+            while (reader.next_block(block)) {}
+            validEnd = reader.valid_end();
+        }
+        if (validEnd > 0) {
+            // Drop a block cut short by a crash
+            std::error_code ec;
+            std::filesystem::resize_file(path, validEnd, ec);
+            file.open(path, std::ios::binary | std::ios::app);
+            if (ec || !file.is_open()) {
+                error = "cannot append to " + path;
+                return false;
+            }
+        }
+        else {
+            file.open(path, std::ios::binary | std::ios::trunc | std::ios::out);
+            if (!file.is_open()) {
+                error = "cannot create " + path;
+                return false;
+            }
+            std::vector<unsigned char> header(ARCHIVE_LOG_HEADER_SIZE + sensorIds.size() * BINARY_LOG_SENSOR_ID_SIZE, 0);
+            memcpy(header.data(), ARCHIVE_LOG_MAGIC, 8);
+            binary_log_put16(&header[8], ARCHIVE_LOG_VERSION);
+            binary_log_put16(&header[10], static_cast<std::uint16_t>(header.size()));
+            binary_log_put16(&header[12], ARCHIVE_LOG_BLOCK_SAMPLES);
+            binary_log_put16(&header[16], static_cast<std::uint16_t>(sensorIds.size()));
+            binary_log_put64(&header[20], static_cast<std::uint64_t>(binary_log_now_ms()));
+            for (size_t i = 0; i < sensorIds.size(); ++i) {
+                memcpy(&header[ARCHIVE_LOG_HEADER_SIZE + i * BINARY_LOG_SENSOR_ID_SIZE], sensorIds[i].c_str(),
+                       std::min(sensorIds[i].size(), static_cast<size_t>(BINARY_LOG_SENSOR_ID_SIZE - 1)));
+            }
+            binary_log_put32(&header[60], binary_log_crc32(header.data(), header.size()));
+            file.write(reinterpret_cast<const char*>(header.data()), header.size());
+            file.flush();
+        }
+        encoders.assign(sensorIds.size(), ArchiveBlockEncoder());
+        nextDueMs = INT64_MAX;
+        return file.good();
+    }
+
+    bool is_open() const { return file.is_open(); }
+
+    bool append(std::int64_t timeMs, std::uint16_t sensor, float value) {
+        ArchiveBlockEncoder& encoder = encoders[sensor];
+        if (!encoder.accepts(timeMs) && !write_block(sensor)) {
+            return false;
+        }
+        if (encoder.count() == 0) {
+            nextDueMs = std::min(nextDueMs, timeMs + ARCHIVE_LOG_BLOCK_MS);
+        }
+        encoder.append(timeMs, value);
+        return true;
+    }
+
+    // Write the blocks whose first sample is ARCHIVE_LOG_BLOCK_MS old
+    bool flush_if_due(std::int64_t nowMs) {
+        if (nowMs < nextDueMs) {
+            return true;
+        }
+        bool written = true;
+        nextDueMs = INT64_MAX;
+        for (size_t i = 0; i < encoders.size(); ++i) {
+            if (encoders[i].count() == 0) continue;
+            if (nowMs - encoders[i].first_time() >= ARCHIVE_LOG_BLOCK_MS)
+                written = write_block(static_cast<std::uint16_t>(i)) && written;
+            else
+                nextDueMs = std::min(nextDueMs, encoders[i].first_time() + ARCHIVE_LOG_BLOCK_MS);
+        }
+        return written;
+    }
+
+    // When flush_if_due() will write the next block, INT64_MAX if there is none
+    std::int64_t due_ms() const { return nextDueMs; }
+
+    // Write every pending block
+    bool flush() {
+        bool written = true;
+        for (size_t i = 0; i < encoders.size(); ++i) {
+            if (encoders[i].count() > 0)
+                written = write_block(static_cast<std::uint16_t>(i)) && written;
+        }
+        nextDueMs = INT64_MAX;
+        return written;
+    }
+
+    void close() {
+        if (file.is_open()) {
+            flush();
+            file.close();
+        }
+    }
+
+    const std::string& last_error() const { return error; }
+
+private:
+    bool write_block(std::uint16_t sensor) {
+        pending.clear();
+        encoders[sensor].finish(sensor, pending);
+        file.write(reinterpret_cast<const char*>(pending.data()), static_cast<std::streamsize>(pending.size()));
+        file.flush();
+        return file.good();
+    }
+
+    std::ofstream file;
+    std::vector<ArchiveBlockEncoder> encoders;
+    std::vector<unsigned char> pending;
+    std::int64_t nextDueMs = INT64_MAX;   // Earliest time a partial block is due
+    std::string error;
+};
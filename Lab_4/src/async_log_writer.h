@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <cerrno>
+#    include <fcntl.h>
+#    include <unistd.h>
+#endif
+
+#define ASYNC_WRITER_FLUSH_MS 100                 // Longest time a record waits in memory
+#define ASYNC_WRITER_FLUSH_BYTES (64 * 1024)      // Wake the writer early once this much is pending
+#define ASYNC_WRITER_MAX_BYTES (16 * 1024 * 1024) // The reader waits for the writer beyond this
+
+enum class Durability {
+    NONE,       // Written to the page cache, never synced
+    INTERVAL,   // fdatasync after the writes of every `every` ms, also once the input pauses
+    RECORDS,    // Group commit: fdatasync once `every` records are pending, or the oldest of them waited ASYNC_WRITER_FLUSH_MS
+    DSYNC       // O_DSYNC, each record is durable when append() returns (written by the caller, not the thread)
+};
+
+struct DurabilityPolicy {
+    Durability mode = Durability::NONE;
+    std::uint64_t every = 0;            // ms (INTERVAL) or records (RECORDS)
+};
+
+struct AsyncWriterStats {
+    std::uint64_t flushes = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t records = 0;
+    std::uint64_t maxQueueBytes = 0;    // Largest buffer handed to the writer
+    std::uint64_t lastFlushUs = 0;
+    std::uint64_t maxFlushUs = 0;
+    std::uint64_t totalFlushUs = 0;     // Write and sync
+    std::uint64_t syncs = 0;
+    std::uint64_t maxLossWindowUs = 0;  // Longest a record waited to become durable (NONE: to reach the page cache)
+    std::uint64_t maxLossRecords = 0;   // Most records appended but not durable yet
+    std::uint64_t stalls = 0;           // append() calls that had to wait for the writer
+    std::uint64_t errors = 0;
+};
+
+// "none", "time:<ms>", "records:<n>" or "dsync"
+inline bool parse_durability(const std::string& text, DurabilityPolicy& policy) {
+    size_t separator = text.find(':');
+    std::string mode = text.substr(0, separator);
+    std::uint64_t every = 0;
+    if (separator != std::string::npos) {
+        try {
+            every = std::stoull(text.substr(separator + 1));
+        }
+        catch (std::exception const& ex) {
+            return false;
+        }
+    }
+    if (mode == "none" && separator == std::string::npos) policy = {Durability::NONE, 0};
+    else if (mode == "time" && every > 0) policy = {Durability::INTERVAL, every};
+    else if (mode == "records" && every > 0) policy = {Durability::RECORDS, every};
+    else if (mode == "dsync" && separator == std::string::npos) policy = {Durability::DSYNC, 0};
+    else return false;
+    return true;
+}
+
+// Double-buffered log writer: the reader thread appends into the front buffer, a writer thread swaps it
+// with the back buffer and writes it out, so a slow disk never blocks the serial reads. Writes are positional,
+// a rewind (restarting the log from offset 0) starts a new segment of the buffer. The durability policy
+// decides when the written data is synced.
+class AsyncLogWriter {
+public:
+    ~AsyncLogWriter() { close(); }
+
+    // Start a new file, or with resume continue the existing one at resumeOffset
+    bool open(const std::string& path, DurabilityPolicy durability = DurabilityPolicy(), bool resume = false, std::uint64_t resumeOffset = 0) {
+        policy = durability;
+#ifdef _WIN32
+        DWORD flags = FILE_ATTRIBUTE_NORMAL | (policy.mode == Durability::DSYNC ? FILE_FLAG_WRITE_THROUGH : 0);
+        file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, resume ? OPEN_ALWAYS : CREATE_ALWAYS, flags, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+#else
+        int flags = O_WRONLY | O_CREAT | (resume ? 0 : O_TRUNC) | O_CLOEXEC | (policy.mode == Durability::DSYNC ? O_DSYNC : 0);
+        fd = ::open(path.c_str(), flags, 0644);
+        if (fd == -1) {
+            return false;
+        }
+#endif
+        stopping = false;
+        offset = resume ? resumeOffset : 0;
+        pendingRecords = 0;
+        counters = AsyncWriterStats();
+        opened = true;
+        if (policy.mode != Durability::DSYNC) {
+            writer = std::thread(&AsyncLogWriter::run, this);
+        }
+        return true;
+    }
+
+    bool is_open() const { return opened; }
+
+    // File offset the next record goes to
+    std::uint64_t appended_offset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return offset;
+    }
+
+    // Queue one record, at the start of the file if rewind is set
+    void append(const char* data, size_t size, bool rewind) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (rewind) {
+            offset = 0;
+        }
+        if (policy.mode == Durability::DSYNC) {
+            // Synchronous by definition: the record is on disk before the caller goes on
+            std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+            bool written = write_at(data, size, offset);
+            offset += size;
+            account_flush(size, 1, started, written, true);
+            account_loss(1, started);
+            return;
+        }
+        if (front.data.size() >= ASYNC_WRITER_MAX_BYTES) {
+            ++counters.stalls;
+            drained.wait(lock, [this] { return front.data.size() < ASYNC_WRITER_MAX_BYTES || stopping; });
+        }
+        if (front.data.empty()) {
+            front.firstAppend = std::chrono::steady_clock::now();
+        }
+        if (front.segments.empty() || rewind) {
+            front.segments.push_back(Segment{offset, front.data.size()});
+        }
+        front.data.append(data, size);
+        offset += size;
+        ++front.records;
+        ++pendingRecords;
+        counters.maxLossRecords = std::max(counters.maxLossRecords, pendingRecords);
+        if ((front.data.size() >= ASYNC_WRITER_FLUSH_BYTES && front.data.size() - size < ASYNC_WRITER_FLUSH_BYTES) ||
+            (policy.mode == Durability::RECORDS && front.records == policy.every)) {
+            pending.notify_one();
+        }
+    }
+
+    AsyncWriterStats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    // Write out everything queued and stop the writer thread
+    void close() {
+        if (!opened) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        pending.notify_one();
+        drained.notify_all();
+        if (writer.joinable()) writer.join();
+        opened = false;
+#ifdef _WIN32
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+#else
+        ::close(fd);
+        fd = -1;
+#endif
+    }
+
+private:
+    struct Segment {
+        std::uint64_t fileOffset;   // Where the bytes from start on go
+        size_t start;
+    };
+
+    struct Batch {
+        std::string data;
+        std::vector<Segment> segments;
+        std::uint64_t records = 0;
+        std::chrono::steady_clock::time_point firstAppend;
+    };
+
+    void run() {
+        Batch back;
+        std::chrono::milliseconds period(policy.mode == Durability::INTERVAL ? policy.every : ASYNC_WRITER_FLUSH_MS);
+        std::chrono::steady_clock::time_point lastSync = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point unsyncedSince;   // Append time of the oldest record written but not synced
+        std::uint64_t unsyncedRecords = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            pending.wait_for(lock, period, [this] {
+                return stopping || front.data.size() >= ASYNC_WRITER_FLUSH_BYTES ||
+                       (policy.mode == Durability::RECORDS && front.records >= policy.every);
+            });
+            bool stop = stopping;
+            // An idle wake still has to sync what earlier batches left unsynced once it is due
+            if (front.data.empty() && !stop && unsyncedRecords == 0) continue;
+            std::swap(front, back);
+            counters.maxQueueBytes = std::max<std::uint64_t>(counters.maxQueueBytes, back.data.size());
+            drained.notify_all();
+
+            lock.unlock();
+            std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+            bool written = write_batch(back);
+            if (back.records > 0 && unsyncedRecords == 0) unsyncedSince = back.firstAppend;
+            unsyncedRecords += back.records;
+            // Writes follow the flush cadence, syncs follow the policy; everything is synced before stopping
+            bool sync = unsyncedRecords > 0 && policy.mode != Durability::NONE &&
+                        (stop || (policy.mode == Durability::INTERVAL && started - lastSync >= std::chrono::milliseconds(policy.every)) ||
+                         (policy.mode == Durability::RECORDS && (unsyncedRecords >= policy.every ||
+                                                                 started - unsyncedSince >= std::chrono::milliseconds(ASYNC_WRITER_FLUSH_MS))));
+            if (sync) {
+                written = sync_data() && written;
+                lastSync = std::chrono::steady_clock::now();
+            }
+            lock.lock();
+
+            if (back.records > 0) {
+                account_flush(back.data.size(), back.records, started, written, sync);
+            }
+            else if (sync) {
+                ++counters.syncs;   // Only what earlier batches wrote
+                if (!written) ++counters.errors;
+            }
+            if (policy.mode == Durability::NONE || sync) {
+                // Records are safe from here on (NONE: from a crash of the process only)
+                account_loss(unsyncedRecords, unsyncedSince);
+                unsyncedRecords = 0;
+            }
+            back.data.clear();
+            back.segments.clear();
+            back.records = 0;
+            if (stop && front.data.empty()) break;   // Drain what was queued meanwhile before stopping
+        }
+    }
+
+    // Called with the mutex held after a batch was written (and synced)
+    void account_flush(std::uint64_t bytes, std::uint64_t records, std::chrono::steady_clock::time_point started, bool written, bool synced) {
+        std::uint64_t elapsedUs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started).count());
+        ++counters.flushes;
+        counters.bytes += bytes;
+        counters.records += records;
+        counters.lastFlushUs = elapsedUs;
+        counters.totalFlushUs += elapsedUs;
+        counters.maxFlushUs = std::max(counters.maxFlushUs, elapsedUs);
+        if (synced) ++counters.syncs;
+        if (!written) ++counters.errors;
+    }
+
+    // Called with the mutex held once records appended since `since` became durable
+    void account_loss(std::uint64_t records, std::chrono::steady_clock::time_point since) {
+        if (records == 0) return;
+        std::uint64_t windowUs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - since).count());
+        counters.maxLossWindowUs = std::max(counters.maxLossWindowUs, windowUs);
+        pendingRecords -= std::min(pendingRecords, records);
+    }
+
+    // One positional write per segment, normally the whole buffer at once
+    bool write_batch(const Batch& batch) {
+        bool ok = true;
+        for (size_t i = 0; i < batch.segments.size(); ++i) {
+            size_t start = batch.segments[i].start;
+            size_t end = i + 1 < batch.segments.size() ? batch.segments[i + 1].start : batch.data.size();
+            ok = write_at(batch.data.data() + start, end - start, batch.segments[i].fileOffset) && ok;
+        }
+        return ok;
+    }
+
+#ifdef _WIN32
+    bool sync_data() { return FlushFileBuffers(file) != 0; }
+
+    bool write_at(const char* data, size_t size, std::uint64_t position) {
+        while (size > 0) {
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(position);
+            overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+            DWORD written;
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+            if (!WriteFile(file, data, chunk, &written, &overlapped)) {
+                return false;
+            }
+            data += written;
+            size -= written;
+            position += written;
+        }
+        return true;
+    }
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    bool sync_data() { return fdatasync(fd) == 0; }
+
+    bool write_at(const char* data, size_t size, std::uint64_t position) {
+        while (size > 0) {
+            ssize_t written = pwrite(fd, data, size, static_cast<off_t>(position));
+            if (written == -1) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            position += static_cast<std::uint64_t>(written);
+        }
+        return true;
+    }
+
+    int fd = -1;
+#endif
+    DurabilityPolicy policy;
+    bool opened = false;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable pending;   // Writer: data to flush or stop
+    std::condition_variable drained;   // Reader: the front buffer was taken
+    Batch front;
+    std::uint64_t offset = 0;          // File offset of the next appended byte
+    std::uint64_t pendingRecords = 0;  // Appended, not durable yet
+    bool stopping = false;
+    AsyncWriterStats counters;
+};
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Binary sensor log:
+//   file header  (BINARY_LOG_HEADER_SIZE bytes, CRC-32 protected) followed by the sensor id table
+//                (BINARY_LOG_SENSOR_ID_SIZE bytes per sensor, zero padded)
+//   blocks       block header (BINARY_LOG_BLOCK_HEADER_SIZE bytes) + count records, CRC-32 over both
+//   record       uint16 delta ms from the previous record of the block (the first one: from the block base time),
+//                uint16 sensor index, float32 value
+// All integers are little-endian.
+
+#define BINARY_LOG_MAGIC "SENSLOG1"
+#define BINARY_LOG_VERSION 1
+#define BINARY_LOG_HEADER_SIZE 64
+#define BINARY_LOG_SENSOR_ID_SIZE 16
+#define BINARY_LOG_MAX_SENSORS 1024
+#define BINARY_LOG_BLOCK_MAGIC 0x4B4C4253u  // "SBLK"
+#define BINARY_LOG_BLOCK_HEADER_SIZE 20
+#define BINARY_LOG_RECORD_SIZE 8
+#define BINARY_LOG_BLOCK_RECORDS 256
+#define BINARY_LOG_MAX_DELTA_MS 0xFFFF     // A longer gap starts a new block
+#define BINARY_LOG_FLUSH_MS 1000           // A partial block is written once its first record is this old
+
+inline void binary_log_put16(unsigned char* out, std::uint16_t value) {
+    out[0] = static_cast<unsigned char>(value);
+    out[1] = static_cast<unsigned char>(value >> 8);
+}
+
+inline void binary_log_put32(unsigned char* out, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) out[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+inline void binary_log_put64(unsigned char* out, std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) out[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+inline std::uint16_t binary_log_get16(const unsigned char* in) {
+    return static_cast<std::uint16_t>(in[0] | (in[1] << 8));
+}
+
+inline std::uint32_t binary_log_get32(const unsigned char* in) {
+    std::uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) value = (value << 8) | in[i];
+    return value;
+}
+
+inline std::uint64_t binary_log_get64(const unsigned char* in) {
+    std::uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) value = (value << 8) | in[i];
+    return value;
+}
+
+// CRC-32 (IEEE 802.3), table driven
+inline std::uint32_t binary_log_crc32(const unsigned char* data, size_t size, std::uint32_t crc = 0) {
+    static const std::vector<std::uint32_t> table = [] {
+        std::vector<std::uint32_t> t(256);
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline std::int64_t binary_log_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Appends samples to a binary log, a block is written when full, on a long time gap or when it gets old
+class BinaryLogWriter {
+public:
+    ~BinaryLogWriter() { close(); }
+
+    // Create (truncate) the file and write the header
+    bool open(const std::string& path, const std::vector<std::string>& sensorIds) {
+        close();
+        if (sensorIds.size() > BINARY_LOG_MAX_SENSORS) {
+            return false;
+        }
+        filePath = path;
+        sensors = sensorIds;
+        return restart();
+    }
+
+    // Continue the file after its last valid block, a block torn by a crash is cut off. A missing or unreadable
+    // file, or one of other sensors, is started over
+    bool resume(const std::string& path, const std::vector<std::string>& sensorIds);
+
+    // Start the file over (log rotation), pending records are dropped
+    bool restart() {
+        file.close();
+        file.clear();
+        file.open(filePath, std::ios::binary | std::ios::trunc | std::ios::out);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::vector<unsigned char> header(BINARY_LOG_HEADER_SIZE + sensors.size() * BINARY_LOG_SENSOR_ID_SIZE, 0);
+        memcpy(header.data(), BINARY_LOG_MAGIC, 8);
+        binary_log_put16(&header[8], BINARY_LOG_VERSION);
+        binary_log_put16(&header[10], static_cast<std::uint16_t>(header.size()));
+        binary_log_put16(&header[12], BINARY_LOG_RECORD_SIZE);
+        binary_log_put16(&header[14], BINARY_LOG_BLOCK_RECORDS);
+        binary_log_put16(&header[16], static_cast<std::uint16_t>(sensors.size()));
+        binary_log_put64(&header[20], static_cast<std::uint64_t>(binary_log_now_ms()));
+        for (size_t i = 0; i < sensors.size(); ++i) {
+            memcpy(&header[BINARY_LOG_HEADER_SIZE + i * BINARY_LOG_SENSOR_ID_SIZE], sensors[i].c_str(),
+                   std::min(sensors[i].size(), static_cast<size_t>(BINARY_LOG_SENSOR_ID_SIZE - 1)));
+        }
+        binary_log_put32(&header[60], binary_log_crc32(header.data(), header.size()));
+        file.write(reinterpret_cast<const char*>(header.data()), header.size());
+        file.flush();
+        count = 0;
+        return file.good();
+    }
+
+    bool is_open() const { return file.is_open(); }
+
+    bool append(std::int64_t timeMs, std::uint16_t sensor, float value) {
+        if (count > 0 && (timeMs < lastTimeMs || timeMs - lastTimeMs > BINARY_LOG_MAX_DELTA_MS) && !flush()) {
+            return false;
+        }
+        if (count == 0) {
+            baseTimeMs = timeMs;
+            lastTimeMs = timeMs;
+        }
+        unsigned char* record = &block[BINARY_LOG_BLOCK_HEADER_SIZE + count * BINARY_LOG_RECORD_SIZE];
+        std::uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        binary_log_put16(record, static_cast<std::uint16_t>(timeMs - lastTimeMs));
+        binary_log_put16(record + 2, sensor);
+        binary_log_put32(record + 4, bits);
+        lastTimeMs = timeMs;
+        ++count;
+        if (count == BINARY_LOG_BLOCK_RECORDS) {
+            return flush();
+        }
+        return flush_if_due(timeMs);
+    }
+
+    // Write the pending block if its first record is older than BINARY_LOG_FLUSH_MS
+    bool flush_if_due(std::int64_t nowMs) {
+        return count == 0 || nowMs - baseTimeMs < BINARY_LOG_FLUSH_MS || flush();
+    }
+
+    // When flush_if_due() will write the pending block, INT64_MAX if there is none
+    std::int64_t due_ms() const { return count == 0 ? INT64_MAX : baseTimeMs + BINARY_LOG_FLUSH_MS; }
+
+    // Write the pending block
+    bool flush() {
+        if (count == 0) {
+            return true;
+        }
+        size_t size = BINARY_LOG_BLOCK_HEADER_SIZE + count * BINARY_LOG_RECORD_SIZE;
+        binary_log_put32(&block[0], BINARY_LOG_BLOCK_MAGIC);
+        binary_log_put16(&block[4], static_cast<std::uint16_t>(count));
+        binary_log_put16(&block[6], 0);
+        binary_log_put64(&block[8], static_cast<std::uint64_t>(baseTimeMs));
+        binary_log_put32(&block[16], 0);
+        binary_log_put32(&block[16], binary_log_crc32(block, size));
+        file.write(reinterpret_cast<const char*>(block), size);
+        file.flush();
+        count = 0;
+        return file.good();
+    }
+
+    void close() {
+        if (file.is_open()) {
+            flush();
+            file.close();
+        }
+    }
+
+private:
+    std::string filePath;
+    std::vector<std::string> sensors;
+    std::ofstream file;
+    unsigned char block[BINARY_LOG_BLOCK_HEADER_SIZE + BINARY_LOG_BLOCK_RECORDS * BINARY_LOG_RECORD_SIZE];
+    size_t count = 0;
+    std::int64_t baseTimeMs = 0;
+    std::int64_t lastTimeMs = 0;
+};
+
+struct BinaryLogRecord {
+    std::int64_t timeMs;
+    std::uint16_t sensor;
+    float value;
+};
+
+// Reads a whole binary log, blocks with a bad CRC are skipped and counted
+class BinaryLogReader {
+public:
+    // Returns false if the file cannot be read or its header is invalid
+    bool open(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            error = "cannot open " + path;
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (data.size() < BINARY_LOG_HEADER_SIZE || memcmp(data.data(), BINARY_LOG_MAGIC, 8) != 0) {
+            error = "not a binary sensor log";
+            return false;
+        }
+        const unsigned char* header = data.data();
+        size_t headerSize = binary_log_get16(header + 10);
+        size_t sensorCount = binary_log_get16(header + 16);
+        if (binary_log_get16(header + 8) != BINARY_LOG_VERSION || binary_log_get16(header + 12) != BINARY_LOG_RECORD_SIZE ||
+            headerSize != BINARY_LOG_HEADER_SIZE + sensorCount * BINARY_LOG_SENSOR_ID_SIZE || data.size() < headerSize) {
+            error = "unsupported header";
+            return false;
+        }
+        std::vector<unsigned char> check(header, header + headerSize);
+        binary_log_put32(&check[60], 0);
+        if (binary_log_crc32(check.data(), check.size()) != binary_log_get32(header + 60)) {
+            error = "header CRC mismatch";
+            return false;
+        }
+        blockRecords = binary_log_get16(header + 14);
+        createdMs = static_cast<std::int64_t>(binary_log_get64(header + 20));
+        sensors.clear();
+        for (size_t i = 0; i < sensorCount; ++i) {
+            const char* id = reinterpret_cast<const char*>(header + BINARY_LOG_HEADER_SIZE + i * BINARY_LOG_SENSOR_ID_SIZE);
+            sensors.emplace_back(id, strnlen(id, BINARY_LOG_SENSOR_ID_SIZE));
+        }
+        offset = headerSize;
+        validEnd = headerSize;
+        badBlocks = 0;
+        truncated = false;
+        return true;
+    }
+
+    // Decode the next valid block into records, false at the end of the file
+    bool next_block(std::vector<BinaryLogRecord>& records) {
+        records.clear();
+        while (offset + BINARY_LOG_BLOCK_HEADER_SIZE <= data.size()) {
+            const unsigned char* block = data.data() + offset;
+            size_t count = binary_log_get16(block + 4);
+            if (binary_log_get32(block) != BINARY_LOG_BLOCK_MAGIC || count == 0 || count > blockRecords) {
+                ++offset;  // Lost sync, look for the next block header
+                continue;
+            }
+            size_t size = BINARY_LOG_BLOCK_HEADER_SIZE + count * BINARY_LOG_RECORD_SIZE;
+            if (offset + size > data.size()) {
+                truncated = true;  // Last block was cut short (crash while writing)
+                break;
+            }
+            std::vector<unsigned char> check(block, block + size);
+            binary_log_put32(&check[16], 0);
+            if (binary_log_crc32(check.data(), size) != binary_log_get32(block + 16)) {
+                ++badBlocks;
+                ++offset;
+                continue;
+            }
+            std::int64_t timeMs = static_cast<std::int64_t>(binary_log_get64(block + 8));
+            for (size_t i = 0; i < count; ++i) {
+                const unsigned char* record = block + BINARY_LOG_BLOCK_HEADER_SIZE + i * BINARY_LOG_RECORD_SIZE;
+                std::uint32_t bits = binary_log_get32(record + 4);
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                timeMs += binary_log_get16(record);
+                records.push_back({timeMs, binary_log_get16(record + 2), value});
+            }
+            offset += size;
+            validEnd = offset;
+            return true;
+        }
+        offset = data.size();
+        return false;
+    }
+
+    const std::vector<std::string>& sensor_ids() const { return sensors; }
+    std::int64_t created_ms() const { return createdMs; }
+    size_t bad_blocks() const { return badBlocks; }
+    bool is_truncated() const { return truncated; }
+    size_t valid_end() const { return validEnd; }   // End of the last valid block read so far, or of the header
+    const std::string& last_error() const { return error; }
+
+private:
+    std::vector<unsigned char> data;
+    std::vector<std::string> sensors;
+    size_t offset = 0;
+    size_t validEnd = 0;
+    size_t blockRecords = BINARY_LOG_BLOCK_RECORDS;
+    std::int64_t createdMs = 0;
+    size_t badBlocks = 0;
+    bool truncated = false;
+    std::string error;
+};
+
+inline bool BinaryLogWriter::resume(const std::string& path, const std::vector<std::string>& sensorIds) {
+    BinaryLogReader reader;
+    if (!reader.open(path) || reader.sensor_ids() != sensorIds) {
+        return open(path, sensorIds);
+    }
+    std::vector<BinaryLogRecord> records;
+    while (reader.next_block(records)) {
+    }
+    close();
+    filePath = path;
+    sensors = sensorIds;
+    std::error_code error;
+    std::filesystem::resize_file(path, reader.valid_end(), error);
+    if (error) {
+        return false;
+    }
+    file.clear();
+    file.open(filePath, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.seekp(0, std::ios::end);
+    count = 0;
+    return file.good();
+}
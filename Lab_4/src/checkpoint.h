@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <unistd.h>
+#endif
+
+#include "aggregator.h"
+
+// Logger state needed to continue after a restart: the statistics of the periods in progress, when they end
+// and where each log continues. Saved as "<key> <values>" text lines, replaced atomically.
+
+#define CHECKPOINT_VERSION 1
+
+struct LoggerCheckpoint {
+    std::vector<std::string> sensorIds;
+    std::int64_t savedTime = 0;             // When the state was captured
+    std::uint64_t logOffset = 0;            // Next byte of the sample log
+    std::int64_t logStartTime = 0;          // Start of its current 24 hour cycle
+    std::int64_t hourlyEnd = 0;             // Next hourly and daily emission
+    std::int64_t dailyEnd = 0;
+    std::uint64_t hourlyLogOffset = 0;
+    std::int64_t hourlyLogStartTime = 0;    // Start of the current month of the hourly log
+    std::uint64_t dailyLogOffset = 0;
+    int dailyLogYear = -1;
+    std::vector<PeriodStats> hourly;
+    std::vector<PeriodStats> daily;
+};
+
+inline void checkpoint_write_stats(std::ostringstream& out, const char* key, const std::vector<PeriodStats>& stats) {
+    char line[256];
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const PeriodStats& s = stats[i];
+        snprintf(line, sizeof(line), "%s %zu %llu %.17g %.17g %.17g %.17g %.17g\n", key, i, static_cast<unsigned long long>(s.count),
+                 s.sum, s.mean, s.m2, s.min, s.max);
+        out << line;
+    }
+}
+
+inline std::string checkpoint_serialize(const LoggerCheckpoint& checkpoint) {
+    std::ostringstream out;
+    out << "version " << CHECKPOINT_VERSION << "\n";
+    out << "sensors";
+    for (const std::string& id : checkpoint.sensorIds) out << " " << id;
+    out << "\n";
+    out << "saved_time " << checkpoint.savedTime << "\n";
+    out << "log_offset " << checkpoint.logOffset << "\n";
+    out << "log_start_time " << checkpoint.logStartTime << "\n";
+    out << "hourly_end " << checkpoint.hourlyEnd << "\n";
+    out << "daily_end " << checkpoint.dailyEnd << "\n";
+    out << "hourly_log_offset " << checkpoint.hourlyLogOffset << "\n";
+    out << "hourly_log_start_time " << checkpoint.hourlyLogStartTime << "\n";
+    out << "daily_log_offset " << checkpoint.dailyLogOffset << "\n";
+    out << "daily_log_year " << checkpoint.dailyLogYear << "\n";
+    checkpoint_write_stats(out, "hourly", checkpoint.hourly);
+    checkpoint_write_stats(out, "daily", checkpoint.daily);
+    out << "end\n";   // A checkpoint without it is incomplete
+    return out.str();
+}
+
+inline bool checkpoint_parse(const std::string& text, LoggerCheckpoint& checkpoint) {
+    std::istringstream in(text);
+    std::string line;
+    bool versionOk = false, complete = false;
+    checkpoint = LoggerCheckpoint();
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        // Numbers go through strtod/strtoll so that "inf" (min/max of an empty period) reads back
+        std::vector<std::string> values{std::istream_iterator<std::string>(fields), std::istream_iterator<std::string>()};
+        auto integer = [&](size_t i) { return i < values.size() ? std::strtoll(values[i].c_str(), nullptr, 10) : 0LL; };
+        auto real = [&](size_t i) { return i < values.size() ? std::strtod(values[i].c_str(), nullptr) : 0.0; };
+        if (key == "version") versionOk = integer(0) == CHECKPOINT_VERSION;
+        else if (key == "sensors") checkpoint.sensorIds = values;
+        else if (key == "saved_time") checkpoint.savedTime = integer(0);
+        else if (key == "log_offset") checkpoint.logOffset = static_cast<std::uint64_t>(integer(0));
+        else if (key == "log_start_time") checkpoint.logStartTime = integer(0);
+        else if (key == "hourly_end") checkpoint.hourlyEnd = integer(0);
+        else if (key == "daily_end") checkpoint.dailyEnd = integer(0);
+        else if (key == "hourly_log_offset") checkpoint.hourlyLogOffset = static_cast<std::uint64_t>(integer(0));
+        else if (key == "hourly_log_start_time") checkpoint.hourlyLogStartTime = integer(0);
+        else if (key == "daily_log_offset") checkpoint.dailyLogOffset = static_cast<std::uint64_t>(integer(0));
+        else if (key == "daily_log_year") checkpoint.dailyLogYear = static_cast<int>(integer(0));
+        else if ((key == "hourly" || key == "daily") && values.size() == 7) {
+            std::vector<PeriodStats>& stats = key == "hourly" ? checkpoint.hourly : checkpoint.daily;
+            size_t index = static_cast<size_t>(integer(0));
+            if (index != stats.size()) return false;
+            PeriodStats s;
+            s.count = static_cast<std::uint64_t>(integer(1));
+            s.sum = real(2);
+            s.mean = real(3);
+            s.m2 = real(4);
+            s.min = real(5);
+            s.max = real(6);
+            stats.push_back(s);
+        }
+        else if (key == "end") complete = true;
+    }
+    return versionOk && complete && checkpoint.hourly.size() == checkpoint.sensorIds.size() &&
+           checkpoint.daily.size() == checkpoint.sensorIds.size();
+}
+
+// Write to "<path>.tmp", sync it and rename it over path: a crash leaves either the old or the new checkpoint
+inline bool checkpoint_save(const std::string& path, const std::string& text) {
+    std::string tmpPath = path + ".tmp";
+#ifdef _WIN32
+    HANDLE file = CreateFileA(tmpPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    DWORD written;
+    bool ok = WriteFile(file, text.data(), static_cast<DWORD>(text.size()), &written, NULL) && written == text.size() &&
+              FlushFileBuffers(file);
+    CloseHandle(file);
+    return ok && MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()) && fdatasync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    return ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+}
+
+inline bool checkpoint_load(const std::string& path, LoggerCheckpoint& checkpoint) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return checkpoint_parse(text, checkpoint);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#    include <nmmintrin.h>
+#    ifdef _MSC_VER
+#        include <intrin.h>
+#    endif
+#    define CRC32C_X86 1
+#endif
+
+// CRC-32C (Castagnoli, as in iSCSI and ext4): reflected polynomial 0x82F63B78, initial value and final xor 0xFFFFFFFF.
+// x86 CPUs with SSE4.2 compute it with the crc32 instruction, detected at run time since the build does not assume
+// SSE4.2; other CPUs use a table.
+
+#define CRC32C_POLYNOMIAL 0x82F63B78u
+
+inline const std::uint32_t* crc32c_table() {
+    static const struct Table {
+        std::uint32_t entries[256];
+        Table() {
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                std::uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0u - (crc & 1)));
+                entries[i] = crc;
+            }
+        }
+    } table;
+    return table.entries;
+}
+
+inline std::uint32_t crc32c_update_table(std::uint32_t crc, const unsigned char* data, size_t size) {
+    const std::uint32_t* table = crc32c_table();
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC32C_X86
+#    if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#    endif
+inline std::uint32_t crc32c_update_sse42(std::uint32_t crc, const unsigned char* data, size_t size) {
+#    if defined(__x86_64__) || defined(_M_X64)
+    std::uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8) {
+        std::uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+#    endif
+    for (; size > 0; ++data, --size) crc = _mm_crc32_u8(crc, *data);
+    return crc;
+}
+
+inline bool crc32c_has_sse42() {
+#    ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#    else
+    return __builtin_cpu_supports("sse4.2");
+#    endif
+}
+#endif
+
+// CRC-32C of size bytes; hardware = false always uses the table
+inline std::uint32_t crc32c(const void* data, size_t size, bool hardware = true) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+#ifdef CRC32C_X86
+    static const bool sse42 = crc32c_has_sse42();
+    if (hardware && sse42) return ~crc32c_update_sse42(0xFFFFFFFFu, bytes, size);
+#else
+    (void)hardware;
+#endif
+    return ~crc32c_update_table(0xFFFFFFFFu, bytes, size);
+}
@@ -0,0 +1,80 @@
+// Throughput and loss window of the log.txt durability policies
+// Usage: durability_bench [--seconds <n>] [--file <path>] [<policy> ...]
+// <policy> is none, time:<ms>, records:<n> or dsync, as in SerialLogger --durability
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "async_log_writer.h"
+
+#define BENCH_RECORD_LENGTH 48   // SerialLogger RECORD_LENGTH
+
+
+int main(int argc, char* argv[]) {
+    double seconds = 2.0;
+    std::string path = "durability_bench.tmp";
+    std::vector<std::string> policies;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (arg == "--file" && i + 1 < argc) path = argv[++i];
+        else policies.push_back(arg);
+    }
+    if (policies.empty()) {
+        policies = {"none", "time:1000", "time:100", "time:10", "records:10000", "records:1000", "records:100", "dsync"};
+    }
+    if (seconds <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [--seconds <n>] [--file <path>] [none|time:<ms>|records:<n>|dsync ...]" << std::endl;
+        return 1;
+    }
+
+    // One sample record as SerialLogger writes it
+    std::string record = "2024-01-01 00:00:00.000 0 21.5";
+    record.resize(BENCH_RECORD_LENGTH - 1, ' ');
+    record += '\n';
+
+    std::cout << std::left << std::setw(16) << "policy" << std::right << std::setw(14) << "samples/s" << std::setw(10) << "syncs"
+              << std::setw(16) << "loss window ms" << std::setw(14) << "loss records" << std::setw(10) << "stalls" << std::endl;
+    for (const std::string& text : policies) {
+        DurabilityPolicy policy;
+        if (!parse_durability(text, policy)) {
+            std::cerr << "Unknown policy " << text << std::endl;
+            return 1;
+        }
+        AsyncLogWriter writer;
+        if (!writer.open(path, policy)) {
+            perror(path.c_str());
+            return 1;
+        }
+        // Append as fast as the policy allows; the writer's backpressure limits the rate of the slow ones
+        std::uint64_t appended = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(seconds));
+        while (std::chrono::steady_clock::now() < deadline) {
+            for (int i = 0; i < 64; ++i) {
+                writer.append(record.data(), record.size(), false);
+            }
+            appended += 64;
+        }
+        writer.close();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        AsyncWriterStats stats = writer.stats();
+
+        std::cout << std::left << std::setw(16) << text << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(14) << appended / elapsed << std::setw(10) << stats.syncs
+                  << std::setprecision(1) << std::setw(16) << stats.maxLossWindowUs / 1000.0
+                  << std::setw(14) << stats.maxLossRecords << std::setw(10) << stats.stalls
+                  << (policy.mode == Durability::NONE ? "  (page cache only, not durable)" : "") << std::endl;
+        if (stats.errors > 0) {
+            std::cerr << text << ": " << stats.errors << " write errors" << std::endl;
+        }
+    }
+    std::remove(path.c_str());
+    return 0;
+}
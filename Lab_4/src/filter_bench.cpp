@@ -0,0 +1,151 @@
+// Throughput of the filter stage with the SSE2 kernels against the scalar ones, for sensors like temperature_simulator's
+// with spikes and unparsable readings mixed in, and how far each filter keeps the average from the clean one
+// Usage: filter_bench [--samples <n>] [--sensors <n>] [--batch <n>] [--spikes <per mille>] [--seed <n>]
+// Meaningful with optimizations only: cmake -DCMAKE_BUILD_TYPE=Release
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include "signal_filter.h"
+
+struct BenchOptions {
+    long long samples = 1000000;   // Per sensor
+    int sensors = 8;
+    int batch = 256;               // Samples of a sensor filtered together
+    int spikes = 5;                // Bad readings per 1000: half spikes of +-50, half 0.0 as the old parsing made of garbage
+    std::uint32_t seed = 1;
+};
+
+struct SensorSeries {
+    std::vector<double> clean;   // What the sensor measured
+    std::vector<double> noisy;   // What the logger got
+};
+
+// A random walk of +-0.3 sent with one decimal, per sensor
+std::vector<SensorSeries> generate_series(const BenchOptions& options) {
+    std::vector<SensorSeries> series(options.sensors);
+    std::mt19937 gen(options.seed);
+    std::uniform_real_distribution<> start(5, 25), change(-0.3, 0.3), spike(-50, 50);
+    std::uniform_int_distribution<> fault(0, 1999);
+    char text[32];
+    for (SensorSeries& sensor : series) {
+        double temp = start(gen);
+        sensor.clean.reserve(static_cast<size_t>(options.samples));
+        sensor.noisy.reserve(static_cast<size_t>(options.samples));
+        for (long long i = 0; i < options.samples; ++i) {
+            snprintf(text, sizeof(text), "%.1f", temp);
+            double value = strtod(text, nullptr);
+            sensor.clean.push_back(value);
+            int roll = fault(gen);
+            sensor.noisy.push_back(roll < options.spikes ? value + spike(gen) : roll < 2 * options.spikes ? 0.0 : value);
+            temp += change(gen);
+        }
+    }
+    return series;
+}
+
+// All sensors through one stage, batch by batch and sensor by sensor as the logger hands them over; samples per second
+double run_stage(const std::vector<FilterSpec>& chain, const std::vector<SensorSeries>& series, const BenchOptions& options,
+                 bool simd, std::vector<std::vector<double>>& outputs) {
+    FilterStage stage(chain, series.size());
+    outputs.assign(series.size(), std::vector<double>());
+    for (size_t sensor = 0; sensor < series.size(); ++sensor) outputs[sensor] = series[sensor].noisy;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t first = 0; first < static_cast<size_t>(options.samples); first += static_cast<size_t>(options.batch)) {
+        size_t count = std::min(static_cast<size_t>(options.batch), static_cast<size_t>(options.samples) - first);
+        for (size_t sensor = 0; sensor < series.size(); ++sensor)
+            stage.process(sensor, outputs[sensor].data() + first, count, simd);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(options.samples) * static_cast<double>(series.size()) / seconds;
+}
+
+// Largest difference of the SSE2 output from the scalar one
+double max_difference(const std::vector<std::vector<double>>& a, const std::vector<std::vector<double>>& b) {
+    double difference = 0.0;
+    for (size_t sensor = 0; sensor < a.size(); ++sensor) {
+        for (size_t i = 0; i < a[sensor].size(); ++i) difference = std::max(difference, std::fabs(a[sensor][i] - b[sensor][i]));
+    }
+    return difference;
+}
+
+// Mean over the sensors of |average of the output - average of the clean series|
+double average_error(const std::vector<std::vector<double>>& outputs, const std::vector<SensorSeries>& series) {
+    double error = 0.0;
+    for (size_t sensor = 0; sensor < series.size(); ++sensor) {
+        double output = 0.0, clean = 0.0;
+        for (size_t i = 0; i < outputs[sensor].size(); ++i) {
+            output += outputs[sensor][i];
+            clean += series[sensor].clean[i];
+        }
+        error += std::fabs(output - clean) / static_cast<double>(outputs[sensor].size());
+    }
+    return error / static_cast<double>(series.size());
+}
+
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    bool validArgs = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        long long number = i + 1 < argc ? atoll(argv[i + 1]) : -1;
+        if (arg == "--samples" && number > 0) options.samples = number;
+        else if (arg == "--sensors" && number > 0) options.sensors = static_cast<int>(number);
+        else if (arg == "--batch" && number > 0) options.batch = static_cast<int>(number);
+        else if (arg == "--spikes" && number >= 0 && number <= 500) options.spikes = static_cast<int>(number);
+        else if (arg == "--seed" && number >= 0) options.seed = static_cast<std::uint32_t>(number);
+        else validArgs = false;
+        ++i;
+    }
+    if (!validArgs) {
+        std::cerr << "Usage: " << argv[0] << " [--samples <n>] [--sensors <n>] [--batch <n>] [--spikes <per mille>] [--seed <n>]" << std::endl;
+        return 1;
+    }
+
+    std::vector<SensorSeries> series = generate_series(options);
+    static const char* const chains[] = {"median:5", "median:9", "median:15", "hampel:7", "hampel:15:3", "ema:0.2", "hampel:7,ema:0.2"};
+
+#ifdef SIGNAL_FILTER_SSE2
+    const char* kernels = "SSE2";
+#else
+    const char* kernels = "scalar fallback";
+#endif
+    std::cout << options.samples << " samples x " << options.sensors << " sensors, batches of " << options.batch << ", "
+              << options.spikes << "+" << options.spikes << " bad per 1000, kernels: " << kernels << std::endl << std::fixed;
+    std::cout << std::left << std::setw(20) << "filter" << std::right << std::setw(12) << "simd M/s" << std::setw(12) << "scalar M/s"
+              << std::setw(10) << "speedup" << std::setw(14) << "avg error" << std::endl;
+
+    std::vector<std::vector<double>> raw;
+    for (const SensorSeries& sensor : series) raw.push_back(sensor.noisy);
+    std::cout << std::left << std::setw(20) << "none" << std::right << std::setw(44) << std::setprecision(4)
+              << average_error(raw, series) << std::endl;
+
+    bool same = true;
+    std::vector<std::vector<double>> simdOutputs, scalarOutputs;
+    for (const char* text : chains) {
+        std::vector<FilterSpec> chain;
+        parse_filter_chain(text, chain);
+        double scalarRate = run_stage(chain, series, options, false, scalarOutputs);
+        double simdRate = run_stage(chain, series, options, true, simdOutputs);
+        // Median and Hampel pick the same samples either way; the blocked EMA rounds differently
+        bool exact = chain.back().kind != FilterKind::EMA && chain.front().kind != FilterKind::EMA;
+        double difference = max_difference(simdOutputs, scalarOutputs);
+        if (exact ? difference != 0.0 : difference > 1e-9) {
+            std::cerr << text << ": SSE2 and scalar outputs differ by " << difference << std::endl;
+            same = false;
+        }
+        std::cout << std::left << std::setw(20) << text << std::right << std::setprecision(2) << std::setw(12) << simdRate / 1e6
+                  << std::setw(12) << scalarRate / 1e6 << std::setw(9) << simdRate / scalarRate << "x" << std::setprecision(4)
+                  << std::setw(14) << average_error(simdOutputs, series) << std::endl;
+    }
+    return same ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Cost per sample of turning a reading into a log record, as the loggers did it before and as they do it now
+// Usage: format_bench [--samples <n>]
+// Meaningful with optimizations only: cmake -DCMAKE_BUILD_TYPE=Release
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "sample_format.h"
+
+#define BENCH_RECORD_LENGTH 48      // SerialLogger RECORD_LENGTH
+#define BENCH_DB_RECORD_LENGTH 30   // Lab_5 RECORD_LENGTH
+
+static const std::string_view frames[] = {"21.5", "-3.25", "101.75", "19.0", " 22.125\r", "0.5", "-40.0", "37.2"};
+static const std::string sensorId = "boiler";
+
+// Previous per-sample code: iostream timestamp, temporary strings, atof / stod and to_string
+
+std::string legacy_format_time(std::chrono::system_clock::time_point now) {
+    std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+    std::tm* tmp = std::localtime(&now_c);
+    std::ostringstream oss;
+    oss << std::put_time(tmp, "%Y-%m-%d %H:%M:%S");
+    long ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+    oss << "." << std::setfill('0') << std::setw(3) << ms;
+    return oss.str();
+}
+
+std::string legacy_current_time() {
+    return legacy_format_time(std::chrono::system_clock::now());
+}
+
+void legacy_fixed_length_record(std::string& fixed_record, const std::string& record, size_t length) {
+    fixed_record.assign(length - 1, ' ');
+    fixed_record.append("\n");
+    size_t copy_len = std::min(record.size(), length - 1);
+    fixed_record.replace(0, copy_len, record.substr(0, copy_len));
+}
+
+// Lab_4: "<time> <sensor_id> <value>" text log record
+size_t legacy_text_record(std::string_view frame, std::string& value) {
+    value.assign(frame.data(), frame.size());
+    double temperature = atof(value.c_str());
+    std::string currentTime = legacy_current_time();
+    std::string logRecord = currentTime + " " + sensorId + " " + value;
+    std::string fixed_record;
+    legacy_fixed_length_record(fixed_record, logRecord, BENCH_RECORD_LENGTH);
+    return fixed_record.size() + fixed_record[3] + static_cast<size_t>(temperature);
+}
+
+size_t text_record(std::string_view frame, TimestampCache& timestamps, FixedRecordBuilder& logRecord) {
+    double temperature;
+    parse_sample_value(frame, temperature);
+    const char* fixed_record = logRecord.clear().append(std::string_view(timestamps.now(), TIMESTAMP_LENGTH))
+        .append(' ').append(sensorId).append(' ').append(frame).finish();
+    return logRecord.size() + fixed_record[3] + static_cast<size_t>(temperature);
+}
+
+// Lab_5: trimmed value, reformatted with six decimals for the database and the web page
+size_t legacy_db_record(std::string_view frame) {
+    std::string currentTime = legacy_current_time();
+    std::string tempStr(frame);
+    size_t first = tempStr.find_first_not_of(" \t\n\r");
+    size_t last = tempStr.find_last_not_of(" \t\n\r");
+    tempStr = first != std::string::npos ? tempStr.substr(first, last - first + 1) : "";
+    double temperature = std::stod(tempStr);
+    std::string logRecord = std::to_string(temperature);
+    std::string fixed_record;
+    legacy_fixed_length_record(fixed_record, logRecord, BENCH_DB_RECORD_LENGTH);
+    std::string portData = std::to_string(temperature);
+    return fixed_record.size() + currentTime.size() + portData.size();
+}
+
+size_t db_record(std::string_view frame, TimestampCache& timestamps, FixedRecordBuilder& logRecord) {
+    const char* currentTime = timestamps.now();
+    double temperature;
+    parse_sample_value(frame, temperature);
+    logRecord.clear().append_fixed(temperature, 6).finish();
+    return logRecord.size() + static_cast<size_t>(currentTime[0]) + logRecord.text().size();
+}
+
+template <typename Function>
+double ns_per_sample(long long samples, Function function) {
+    size_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < samples; ++i) {
+        sink += function(frames[i % (sizeof(frames) / sizeof(frames[0]))]);
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (sink == 0) std::cerr << "";   // Keep the results alive
+    return elapsed / static_cast<double>(samples);
+}
+
+
+int main(int argc, char* argv[]) {
+    long long samples = 2000000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--samples" && i + 1 < argc) samples = atoll(argv[++i]);
+        else samples = 0;
+    }
+    if (samples <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [--samples <n>]" << std::endl;
+        return 1;
+    }
+
+    std::string value;
+    TimestampCache timestamps;
+    FixedRecordBuilder textRecord(BENCH_RECORD_LENGTH);
+    FixedRecordBuilder dbRecord(BENCH_DB_RECORD_LENGTH);
+
+    // Same records both ways, across second boundaries
+    TimestampCache check;
+    std::chrono::system_clock::time_point base = std::chrono::system_clock::now();
+    for (int ms : {0, 1, 999, 1000, 1999, 61001, 3600999}) {
+        std::chrono::system_clock::time_point time = base + std::chrono::milliseconds(ms);
+        for (std::string_view frame : frames) {
+            std::string expected;
+            legacy_fixed_length_record(expected, legacy_format_time(time) + " " + sensorId + " " + std::string(frame), BENCH_RECORD_LENGTH);
+            std::string actual(textRecord.clear().append(std::string_view(check.format(time), TIMESTAMP_LENGTH)).append(' ')
+                                   .append(sensorId).append(' ').append(frame).finish(), textRecord.size());
+            if (expected != actual) {
+                std::cerr << "Records differ:\n" << expected << actual;
+                return 1;
+            }
+        }
+    }
+
+    double textBefore = ns_per_sample(samples, [&](std::string_view frame) { return legacy_text_record(frame, value); });
+    double textAfter = ns_per_sample(samples, [&](std::string_view frame) { return text_record(frame, timestamps, textRecord); });
+    double dbBefore = ns_per_sample(samples, [&](std::string_view frame) { return legacy_db_record(frame); });
+    double dbAfter = ns_per_sample(samples, [&](std::string_view frame) { return db_record(frame, timestamps, dbRecord); });
+
+    std::cout << std::left << std::setw(28) << "ns/sample" << std::right << std::setw(10) << "before" << std::setw(10) << "after"
+              << std::setw(10) << "speedup" << std::endl << std::fixed;
+    std::cout << std::left << std::setw(28) << "text log record (Lab_4)" << std::right << std::setprecision(1) << std::setw(10)
+              << textBefore << std::setw(10) << textAfter << std::setw(9) << textBefore / textAfter << "x" << std::endl;
+    std::cout << std::left << std::setw(28) << "database value (Lab_5)" << std::right << std::setprecision(1) << std::setw(10)
+              << dbBefore << std::setw(10) << dbAfter << std::setw(9) << dbBefore / dbAfter << "x" << std::endl;
+    return 0;
+}
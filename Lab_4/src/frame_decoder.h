@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crc32c.h"
+
+#define FRAME_DECODER_CAPACITY 4096  // Ring size in bytes, must be a power of two
+#define FRAME_MAX_SIZE 256           // Longer frames are discarded
+#define FRAME_DELIMITER '\n'
+#define FRAME_LENGTH_PREFIX_SIZE 2   // Little-endian payload length in front of each length-prefixed frame
+#define FRAME_SYNC_0 '\xA5'           // Sync word at the start of each sequenced frame
+#define FRAME_SYNC_1 '\x5A'
+#define FRAME_SEQUENCED_HEADER_SIZE 5  // Sync word, uint16 sequence number, uint8 payload length
+#define FRAME_CRC_SIZE 4               // CRC-32C of the header and the payload
+#define FRAME_SEQUENCE_WINDOW 256      // A frame at most this far behind the expected sequence number is a duplicate
+
+enum class FrameMode {
+    DELIMITED,        // "<payload>\n", a trailing '\r' is stripped
+    LENGTH_PREFIXED,  // "<uint16 length><payload>"
+    SEQUENCED         // "<sync A5 5A><uint16 sequence><uint8 length><payload><uint32 crc32c>", little-endian
+};
+
+// Append a sequenced frame carrying payload (1..255 bytes) to out
+inline void append_sequenced_frame(std::string& out, std::uint16_t sequence, const char* payload, size_t size) {
+    size_t start = out.size();
+    char header[FRAME_SEQUENCED_HEADER_SIZE] = {FRAME_SYNC_0, FRAME_SYNC_1, static_cast<char>(sequence & 0xFF),
+                                                static_cast<char>(sequence >> 8), static_cast<char>(size)};
+    out.append(header, FRAME_SEQUENCED_HEADER_SIZE);
+    out.append(payload, size);
+    std::uint32_t crc = crc32c(out.data() + start, out.size() - start);
+    for (int i = 0; i < FRAME_CRC_SIZE; ++i) out.push_back(static_cast<char>((crc >> (8 * i)) & 0xFF));
+}
+
+// Streaming decoder for the serial input: bytes are read straight into a ring buffer and
+// complete frames are extracted across read boundaries, any number of frames per read.
+// Sequenced frames are checked against their CRC and their sequence numbers: a gap counts the frames lost on the
+// way, a frame that repeats one of the last FRAME_SEQUENCE_WINDOW is a duplicate and is skipped. Gaps are counted
+// modulo 65536, so an outage longer than that many frames is undercounted.
+class FrameDecoder {
+public:
+    explicit FrameDecoder(FrameMode mode = FrameMode::DELIMITED, char delimiter = FRAME_DELIMITER)
+        : mode(mode), delimiter(delimiter), ring(FRAME_DECODER_CAPACITY),
+          scratch(FRAME_SEQUENCED_HEADER_SIZE + FRAME_MAX_SIZE + FRAME_CRC_SIZE) {}
+
+    // Contiguous free space to read into; call commit() with the number of bytes actually read
+    char* write_ptr() { return ring.data() + (head & MASK); }
+
+    size_t write_space() const {
+        size_t freeBytes = FRAME_DECODER_CAPACITY - static_cast<size_t>(head - tail);
+        size_t toEnd = FRAME_DECODER_CAPACITY - static_cast<size_t>(head & MASK);
+        return freeBytes < toEnd ? freeBytes : toEnd;
+    }
+
+    void commit(size_t size) { head += size; }
+
+    // Copy bytes into the ring, returns how many fit
+    size_t push(const char* data, size_t size) {
+        size_t pushed = 0;
+        while (pushed < size && write_space() > 0) {
+            size_t chunk = write_space() < size - pushed ? write_space() : size - pushed;
+            memcpy(write_ptr(), data + pushed, chunk);
+            commit(chunk);
+            pushed += chunk;
+        }
+        return pushed;
+    }
+
+    // Extract the next complete frame; the view stays valid until the next call or write
+    bool next_frame(std::string_view* frame) {
+        if (mode == FrameMode::SEQUENCED) return next_sequenced(frame);
+        return mode == FrameMode::DELIMITED ? next_delimited(frame) : next_length_prefixed(frame);
+    }
+
+    size_t buffered() const { return static_cast<size_t>(head - tail); }
+    std::uint64_t frames() const { return frameCount; }
+    std::uint64_t dropped_bytes() const { return droppedBytes; }
+    // SEQUENCED
+    std::uint64_t lost_frames() const { return lostFrames; }
+    std::uint64_t duplicate_frames() const { return duplicateFrames; }
+    std::uint64_t crc_errors() const { return crcErrors; }
+
+private:
+    static constexpr std::uint64_t MASK = FRAME_DECODER_CAPACITY - 1;
+
+    char at(std::uint64_t position) const { return ring[position & MASK]; }
+
+    // View of [tail, tail + size), copied to scratch only if it wraps around the end of the ring
+    std::string_view view(size_t offset, size_t size) {
+        size_t start = static_cast<size_t>((tail + offset) & MASK);
+        if (start + size <= FRAME_DECODER_CAPACITY) {
+            return std::string_view(ring.data() + start, size);
+        }
+        size_t first = FRAME_DECODER_CAPACITY - start;
+        memcpy(scratch.data(), ring.data() + start, first);
+        memcpy(scratch.data() + first, ring.data(), size - first);
+        return std::string_view(scratch.data(), size);
+    }
+
+    void drop(size_t size) {
+        tail += size;
+        droppedBytes += size;
+    }
+
+    bool next_delimited(std::string_view* frame) {
+        while (scanned < head) {
+            // Search the contiguous part of the unscanned bytes with memchr
+            size_t start = static_cast<size_t>(scanned & MASK);
+            size_t toEnd = FRAME_DECODER_CAPACITY - start;
+            size_t available = static_cast<size_t>(head - scanned);
+            size_t chunk = available < toEnd ? available : toEnd;
+            const char* found = static_cast<const char*>(memchr(ring.data() + start, delimiter, chunk));
+            if (found == nullptr) {
+                scanned += chunk;
+                continue;
+            }
+            std::uint64_t delimiterPos = scanned + static_cast<size_t>(found - (ring.data() + start));
+            size_t size = static_cast<size_t>(delimiterPos - tail);
+            scanned = delimiterPos + 1;
+            if (size > FRAME_MAX_SIZE) {
+                drop(size + 1);
+                continue;
+            }
+            if (size > 0 && at(tail + size - 1) == '\r') {
+                --size;
+            }
+            if (size == 0) {
+                tail = scanned;
+                continue;
+            }
+            *frame = view(0, size);
+            tail = scanned;
+            ++frameCount;
+            return true;
+        }
+        // No delimiter in sight: resynchronise once the pending bytes cannot be a valid frame
+        if (buffered() > FRAME_MAX_SIZE) {
+            drop(buffered());
+        }
+        return false;
+    }
+
+    bool next_length_prefixed(std::string_view* frame) {
+        while (buffered() >= FRAME_LENGTH_PREFIX_SIZE) {
+            size_t size = static_cast<unsigned char>(at(tail)) | (static_cast<unsigned char>(at(tail + 1)) << 8);
+            if (size == 0 || size > FRAME_MAX_SIZE) {
+                drop(1);  // Not a length, slide by one byte until a plausible prefix shows up
+                continue;
+            }
+            if (buffered() < FRAME_LENGTH_PREFIX_SIZE + size) {
+                return false;
+            }
+            *frame = view(FRAME_LENGTH_PREFIX_SIZE, size);
+            tail += FRAME_LENGTH_PREFIX_SIZE + size;
+            ++frameCount;
+            return true;
+        }
+        return false;
+    }
+
+    bool next_sequenced(std::string_view* frame) {
+        while (buffered() >= FRAME_SEQUENCED_HEADER_SIZE) {
+            if (at(tail) != FRAME_SYNC_0 || at(tail + 1) != FRAME_SYNC_1) {
+                drop(1);  // Slide to the next sync word
+                continue;
+            }
+            size_t size = static_cast<unsigned char>(at(tail + 4));
+            if (size == 0) {
+                drop(1);
+                continue;
+            }
+            size_t total = FRAME_SEQUENCED_HEADER_SIZE + size + FRAME_CRC_SIZE;
+            if (buffered() < total) {
+                return false;
+            }
+            std::string_view packet = view(0, total);
+            const unsigned char* crcBytes = reinterpret_cast<const unsigned char*>(packet.data()) + total - FRAME_CRC_SIZE;
+            std::uint32_t crc = crcBytes[0] | (crcBytes[1] << 8) | (crcBytes[2] << 16) | (static_cast<std::uint32_t>(crcBytes[3]) << 24);
+            if (crc32c(packet.data(), total - FRAME_CRC_SIZE) != crc) {
+                ++crcErrors;
+                drop(1);  // A sync word inside a damaged frame may start the next one
+                continue;
+            }
+            std::uint16_t sequence = static_cast<std::uint16_t>(static_cast<unsigned char>(packet[2]) | (static_cast<unsigned char>(packet[3]) << 8));
+            tail += total;
+            if (sequenced) {
+                std::uint16_t gap = static_cast<std::uint16_t>(sequence - expectedSequence);
+                if (gap > 0xFFFF - FRAME_SEQUENCE_WINDOW) {
+                    ++duplicateFrames;
+                    continue;
+                }
+                lostFrames += gap;
+            }
+            sequenced = true;
+            expectedSequence = static_cast<std::uint16_t>(sequence + 1);
+            *frame = packet.substr(FRAME_SEQUENCED_HEADER_SIZE, size);
+            ++frameCount;
+            return true;
+        }
+        return false;
+    }
+
+    FrameMode mode;
+    char delimiter;
+    std::vector<char> ring;
+    std::vector<char> scratch;
+    std::uint64_t head = 0;     // Next byte to write
+    std::uint64_t tail = 0;     // Start of the first unconsumed frame
+    std::uint64_t scanned = 0;  // Bytes before this position contain no delimiter
+    std::uint64_t frameCount = 0;
+    std::uint64_t droppedBytes = 0;
+    bool sequenced = false;              // A sequenced frame has been seen, expectedSequence is valid
+    std::uint16_t expectedSequence = 0;
+    std::uint64_t lostFrames = 0;
+    std::uint64_t duplicateFrames = 0;
+    std::uint64_t crcErrors = 0;
+};
@@ -0,0 +1,192 @@
+// Statistics and samples of a time range from the long-term archive (log.archive), and packing of older logs into one
+// Usage: logarchive <archive> [--from <time>] [--to <time>] [--sensor <id>] [--samples]
+//        logarchive --pack <log.txt|log.ring|log.bin> <archive>
+// <time> is "YYYY-MM-DD[ hh:mm[:ss[.sss]]]" local time; --from is inclusive, --to exclusive.
+// Blocks that lie wholly inside the range are summarized from their headers, only the edge blocks are decoded.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+
+#include "archive_log.h"
+#include "replay_source.h"
+#include "sample_format.h"
+
+bool parse_time_ms(const std::string& text, std::int64_t& timeMs); // Function for reading a --from/--to time
+int pack_log(const std::string& logPath, const std::string& archivePath); // Function for appending a log to an archive
+std::string format_time_ms(std::int64_t timeMs); // Format ms since epoch as YYYY-MM-DD hh:mm:ss.sss (local time)
+
+
+int main(int argc, char* argv[]) {
+    std::string path, sensorFilter, packPath;
+    std::int64_t fromMs = INT64_MIN, toMs = INT64_MAX;
+    bool printSamples = false;
+    bool validArgs = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--from" && i + 1 < argc) validArgs = parse_time_ms(argv[++i], fromMs) && validArgs;
+        else if (arg == "--to" && i + 1 < argc) validArgs = parse_time_ms(argv[++i], toMs) && validArgs;
+        else if (arg == "--sensor" && i + 1 < argc) sensorFilter = argv[++i];
+        else if (arg == "--pack" && i + 1 < argc) packPath = argv[++i];
+        else if (arg == "--samples") printSamples = true;
+        else if (path.empty() && arg[0] != '-') path = arg;
+        else validArgs = false;
+    }
+    if (path.empty() || !validArgs) {
+        std::cerr << "Usage: " << argv[0] << " <archive> [--from <time>] [--to <time>] [--sensor <id>] [--samples]\n"
+                  << "       " << argv[0] << " --pack <log.txt|log.ring|log.bin> <archive>" << std::endl;
+        return 1;
+    }
+    if (!packPath.empty())
+        return pack_log(packPath, path);
+
+    ArchiveLogReader reader;
+    if (!reader.open(path)) {
+        std::cerr << path << ": " << reader.last_error() << std::endl;
+        return 1;
+    }
+    const std::vector<std::string>& sensors = reader.sensor_ids();
+    int sensorIndex = -1;
+    if (!sensorFilter.empty()) {
+        for (size_t i = 0; i < sensors.size(); ++i) {
+            if (sensors[i] == sensorFilter) sensorIndex = static_cast<int>(i);
+        }
+        if (sensorIndex < 0) {
+            std::cerr << "Unknown sensor " << sensorFilter << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<PeriodStats> stats(sensors.size());
+    std::vector<BinaryLogRecord> records;
+    std::uint64_t fromHeaders = 0, decoded = 0, skipped = 0, damaged = 0;
+    std::string line;
+    char value[32];
+    ArchiveBlock block;
+    while (reader.next_block(block)) {
+        if ((sensorIndex >= 0 && block.sensor != sensorIndex) || block.lastMs < fromMs || block.firstMs >= toMs) {
+            ++skipped;
+            continue;
+        }
+        if (!printSamples && block.firstMs >= fromMs && block.lastMs < toMs) {
+            stats[block.sensor].merge(block.stats);
+            ++fromHeaders;
+            continue;
+        }
+        records.clear();
+        if (!archive_log_decode(block, records)) {
+            ++damaged;
+            continue;
+        }
+        ++decoded;
+        for (const BinaryLogRecord& record : records) {
+            if (record.timeMs < fromMs || record.timeMs >= toMs) continue;
+            stats[block.sensor].add(record.value);
+            if (!printSamples) continue;
+            snprintf(value, sizeof(value), "%.6g", record.value);
+            line = format_time_ms(record.timeMs);
+            line += ' ';
+            line += sensors[record.sensor];
+            line += ' ';
+            line += value;
+            line += '\n';
+            std::cout << line;
+        }
+    }
+
+    if (!printSamples) {
+        std::cout << std::left << std::setw(16) << "sensor" << std::right << std::setw(12) << "count" << std::setw(12) << "min"
+                  << std::setw(12) << "max" << std::setw(12) << "avg" << std::setw(12) << "stddev" << std::endl << std::fixed;
+        for (size_t i = 0; i < sensors.size(); ++i) {
+            if (stats[i].count == 0) continue;
+            std::cout << std::left << std::setw(16) << sensors[i] << std::right << std::setw(12) << stats[i].count
+                      << std::setprecision(3) << std::setw(12) << stats[i].minimum() << std::setw(12) << stats[i].maximum()
+                      << std::setw(12) << stats[i].average() << std::setw(12) << stats[i].stddev() << std::endl;
+        }
+    }
+    std::cerr << path << ": " << fromHeaders << " blocks summarized from headers, " << decoded << " decoded, " << skipped
+              << " outside the range, " << damaged + reader.bad_blocks() << " damaged"
+              << (reader.is_truncated() ? ", truncated tail" : "") << std::endl;
+    return damaged + reader.bad_blocks() > 0 ? 2 : 0;
+}
+
+
+bool parse_time_ms(const std::string& text, std::int64_t& timeMs) {
+    // Missing fields are the start of the day / hour / minute / second
+    static const std::string start = "1970-01-01 00:00:00.000";
+    if (text.size() < 10 || text.size() > start.size())
+        return false;
+    std::string full = text + start.substr(text.size());
+    TimestampParser parser;
+    std::chrono::system_clock::time_point time;
+    if (!parser.parse(full.c_str(), time))
+        return false;
+    timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    return true;
+}
+
+int pack_log(const std::string& logPath, const std::string& archivePath) {
+    ArchiveLogWriter archive;
+    std::uint64_t packed = 0;
+    BinaryLogReader binary;
+    if (binary.open(logPath)) {
+        if (!archive.open(archivePath, binary.sensor_ids())) {
+            std::cerr << archive.last_error() << std::endl;
+            return 1;
+        }
+        std::vector<BinaryLogRecord> records;
+        while (binary.next_block(records)) {
+            for (const BinaryLogRecord& record : records) {
+                archive.append(record.timeMs, record.sensor, record.value);
+                archive.flush_if_due(record.timeMs);
+            }
+            packed += records.size();
+        }
+    }
+    else {
+        ReplaySource source;
+        if (!source.open_log(logPath)) {
+            std::cerr << logPath << ": not a sensor log" << std::endl;
+            return 1;
+        }
+        const std::vector<std::string>& ids = source.sensor_ids();
+        if (!archive.open(archivePath, ids)) {
+            std::cerr << archive.last_error() << std::endl;
+            return 1;
+        }
+        ReplaySample sample;
+        double value;
+        while (source.next(sample)) {
+            size_t index = static_cast<size_t>(std::find(ids.begin(), ids.end(), sample.sensorId) - ids.begin());
+            std::int64_t timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(sample.time.time_since_epoch()).count();
+            if (!parse_sample_value(sample.value, value))
+                continue;   // Not counted by the logger either
+            archive.append(timeMs, static_cast<std::uint16_t>(index), static_cast<float>(value));
+            archive.flush_if_due(timeMs);
+            ++packed;
+        }
+    }
+    archive.close();
+    std::cerr << logPath << ": " << packed << " samples packed into " << archivePath << std::endl;
+    return 0;
+}
+
+std::string format_time_ms(std::int64_t timeMs) {
+    std::time_t timeSec = static_cast<std::time_t>(timeMs / 1000);
+    std::tm timeInfo;
+#ifdef _WIN32
+    localtime_s(&timeInfo, &timeSec);
+#else
+    localtime_r(&timeSec, &timeInfo);
+#endif
+    char buffer[32];
+    size_t size = strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeInfo);
+    snprintf(buffer + size, sizeof(buffer) - size, ".%03d", static_cast<int>(timeMs % 1000));
+    return buffer;
+}
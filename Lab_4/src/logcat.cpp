@@ -0,0 +1,90 @@
+// Convert a binary sensor log written by SerialLogger --log-format binary back to text
+// Usage: logcat <log.bin> [--sensor <id>] [--stats]
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+
+#include "binary_log.h"
+
+std::string format_time_ms(std::int64_t timeMs); // Format ms since epoch as YYYY-MM-DD hh:mm:ss.sss (local time)
+
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    std::string sensorFilter;
+    bool statsOnly = false;
+    bool validArgs = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sensor" && i + 1 < argc) sensorFilter = argv[++i];
+        else if (arg == "--stats") statsOnly = true;
+        else if (path.empty() && arg[0] != '-') path = arg;
+        else validArgs = false;
+    }
+    if (path.empty() || !validArgs) {
+        std::cerr << "Usage: " << argv[0] << " <log.bin> [--sensor <id>] [--stats]" << std::endl;
+        return 1;
+    }
+
+    BinaryLogReader reader;
+    if (!reader.open(path)) {
+        std::cerr << path << ": " << reader.last_error() << std::endl;
+        return 1;
+    }
+    const std::vector<std::string>& sensors = reader.sensor_ids();
+    int sensorIndex = -1;
+    if (!sensorFilter.empty()) {
+        for (size_t i = 0; i < sensors.size(); ++i) {
+            if (sensors[i] == sensorFilter) sensorIndex = static_cast<int>(i);
+        }
+        if (sensorIndex < 0) {
+            std::cerr << "Unknown sensor " << sensorFilter << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<BinaryLogRecord> records;
+    std::uint64_t recordCount = 0, blockCount = 0;
+    std::string line;
+    char value[32];
+    while (reader.next_block(records)) {
+        ++blockCount;
+        for (const BinaryLogRecord& record : records) {
+            if (sensorIndex >= 0 && record.sensor != sensorIndex) continue;
+            ++recordCount;
+            if (statsOnly) continue;
+            snprintf(value, sizeof(value), "%.6g", record.value);
+            line = format_time_ms(record.timeMs);
+            line += ' ';
+            line += record.sensor < sensors.size() ? sensors[record.sensor] : std::to_string(record.sensor);
+            line += ' ';
+            line += value;
+            line += '\n';
+            std::cout << line;
+        }
+    }
+
+    std::cerr << path << ": " << blockCount << " blocks, " << recordCount << " records, " << sensors.size() << " sensors, "
+              << reader.bad_blocks() << " bad blocks" << (reader.is_truncated() ? ", truncated tail" : "") << std::endl;
+    return reader.bad_blocks() > 0 ? 2 : 0;
+}
+
+
+std::string format_time_ms(std::int64_t timeMs) {
+    std::time_t timeSec = static_cast<std::time_t>(timeMs / 1000);
+    std::tm timeInfo;
+#ifdef _WIN32
+    localtime_s(&timeInfo, &timeSec);
+#else
+    localtime_r(&timeSec, &timeInfo);
+#endif
+    char buffer[32];
+    size_t size = strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeInfo);
+    snprintf(buffer + size, sizeof(buffer) - size, ".%03d", static_cast<int>(timeMs % 1000));
+    return buffer;
+}
@@ -0,0 +1,76 @@
+// Print the records of a time range from log.txt, log_hour.txt, log_day.txt or log.ring
+// Usage: logquery <log> [--last <seconds> | --from <time>] [--to <time>] [--sensor <id>] [--count]
+// <time> is any prefix of "YYYY-MM-DD hh:mm:ss.sss"; --to includes every record the prefix matches
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+
+#include "log_query.h"
+
+bool record_has_sensor(const char* record, const std::string& sensor); // Function for checking the sensor id field of a record
+
+
+int main(int argc, char* argv[]) {
+    std::string path, from, to, sensor;
+    bool countOnly = false;
+    bool validArgs = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--last" && i + 1 < argc) {
+            long long seconds = atoll(argv[++i]);
+            if (seconds <= 0) validArgs = false;
+            else from = log_query_time_before(seconds);
+        }
+        else if (arg == "--from" && i + 1 < argc) from = argv[++i];
+        else if (arg == "--to" && i + 1 < argc) to = argv[++i];
+        else if (arg == "--sensor" && i + 1 < argc) sensor = argv[++i];
+        else if (arg == "--count") countOnly = true;
+        else if (path.empty() && arg[0] != '-') path = arg;
+        else validArgs = false;
+    }
+    if (path.empty() || !validArgs) {
+        std::cerr << "Usage: " << argv[0] << " <log> [--last <seconds> | --from <time>] [--to <time>] [--sensor <id>] [--count]" << std::endl;
+        return 1;
+    }
+
+    LogQuery query;
+    if (!query.open(path)) {
+        perror(path.c_str());
+        return 1;
+    }
+    std::uint64_t begin = from.empty() ? 0 : query.lower_bound(from);
+    std::uint64_t end = to.empty() ? query.size() : query.upper_bound(to);
+    if (end < begin) end = begin;
+
+    std::uint64_t matched = 0;
+    if (sensor.empty()) {
+        matched = end - begin;
+        if (!countOnly) {
+            query.stream(begin, end, [](const char* data, size_t size) { fwrite(data, 1, size, stdout); });
+        }
+    }
+    else {
+        for (std::uint64_t i = begin; i < end; ++i) {
+            const char* record = query.record(i);
+            if (!record_has_sensor(record, sensor)) continue;
+            ++matched;
+            if (!countOnly) fwrite(record, 1, static_cast<size_t>(query.record_length()), stdout);
+        }
+    }
+    fflush(stdout);
+
+    if (countOnly) std::cout << matched << std::endl;
+    std::cerr << path << ": " << matched << " of " << query.size() << " records" << std::endl;
+    return 0;
+}
+
+
+bool record_has_sensor(const char* record, const std::string& sensor) {
+    // "<date> <time> <sensor_id> <value>"
+    const char* id = record + LOG_QUERY_TIME_LENGTH + 1;
+    return memcmp(id, sensor.data(), sensor.size()) == 0 && id[sensor.size()] == ' ';
+}
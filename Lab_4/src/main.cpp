@@ -1,15 +1,20 @@
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <string>
 #include <vector>
 #include <ctime>
 #include <iomanip>
 #include <chrono>
 #include <algorithm>
+#include <mutex>
+#include <climits>
+#include <atomic>
+#include <thread>
 
 #ifdef _WIN32
     #include <windows.h>
 #else
-    #include <fstream>
     #include <termios.h>
     #include <pthread.h>
     #include <semaphore.h>
@@ -21,6 +26,21 @@
 #endif
 
 #include "serial_port.h"
+#include "frame_decoder.h"
+#include "binary_log.h"
+#include "ring_log.h"
+#include "aggregator.h"
+#include "timer_wheel.h"
+#include "window_stats.h"
+#include "async_log_writer.h"
+#include "checkpoint.h"
+#include "sample_format.h"
+#include "logger_clock.h"
+#include "replay_source.h"
+#include "archive_log.h"
+#include "signal_filter.h"
+#include "spsc_ring.h"
+#include "pipeline_stage.h"
 
 #ifdef _WIN32
     #define PORT_RD "COM12"
@@ -33,54 +53,142 @@
 #endif
 
 #define LOG_FILE_NAME "log.txt"
+#define LOG_FILE_NAME_BINARY "log.bin"
+#define LOG_FILE_NAME_RING "log.ring"
 #define LOG_FILE_NAME_HOUR "log_hour.txt"
 #define LOG_FILE_NAME_DAY "log_day.txt"
-#define FILE_LAST_RECORD "last_record.txt"
-#define SEMAPHORE_OBJECT_NAME "my_semaphore"
-#define RECORD_LENGTH 30
+#define LOG_FILE_NAME_WINDOW "log_window.txt"
+#define LOG_FILE_NAME_ARCHIVE "log.archive"
+#define FILE_CHECKPOINT "checkpoint.txt"
+#define RECORD_LENGTH 48
+#define STATS_RECORD_LENGTH 128   // "<time> <sensor_id> <average> <min> <max> <stddev> <count>" in LOG_FILE_NAME_HOUR and LOG_FILE_NAME_DAY
+#define SENSOR_ID_MAX_LENGTH 15
 #define SEC_IN_HOUR 3600
 #define SEC_IN_DAY 24 * SEC_IN_HOUR
 #define SEC_IN_MONTH SEC_IN_DAY * 30
+#define WINDOW_LOG_PERIOD_SEC 10   // LOG_FILE_NAME_WINDOW is rewritten this often
+#define RING_LOG_HEADROOM 2   // Default ring capacity: nominal records per retention period times this
+#define CHECKPOINT_PERIOD_SEC 5   // The state is captured and FILE_CHECKPOINT replaced this often
+#define DEFAULT_BAUD 115200
+#define FILTER_BATCH_SAMPLES 512   // Readings of a sensor filtered together at most
+#define PIPELINE_CHUNK_SIZE 4096   // Bytes of one read handed from the reader to the decoder at most
+#define PIPELINE_CHUNK_QUEUE 256   // Reads waiting for the decoder
+#define PIPELINE_SAMPLE_QUEUE 65536   // Readings waiting for the aggregator, and again for the writer
+#define PIPELINE_TEXT_SIZE (RECORD_LENGTH - TIMESTAMP_LENGTH)   // Characters of a reading kept for its record, more never fit
+#define PIPELINE_CHECKPOINT_MARKER 0xFFFF   // Sensor of the queue entry that tells the writer to complete a checkpoint
+#define PIPELINE_HOUSEKEEPING_ITEMS 1024   // A busy stage checks its timers after this many items
+#define PIPELINE_OCCUPANCY_ITEMS 64   // A stage samples the occupancy of its input queue every this many items
+
+struct SensorConfig { // Serial device and the id its samples are tagged with
+    std::string device;
+    std::string id;
+};
+
+struct LoggerOptions { // Command line options
+    std::vector<SensorConfig> sensors;
+    FrameMode frameMode = FrameMode::DELIMITED;
+    unsigned int baud = DEFAULT_BAUD;  // Any speed in bits per second, see configure_port()
+    bool binaryLog = false;  // LOG_FILE_NAME_BINARY instead of LOG_FILE_NAME
+    bool ringLog = false;    // LOG_FILE_NAME_RING instead of LOG_FILE_NAME
+    long long retentionSec = SEC_IN_DAY;
+    long long ringRecords = 0;  // 0 - derived from the retention and the number of sensors
+    DurabilityPolicy durability;  // When LOG_FILE_NAME is synced to disk
+    std::string replay;  // Log or "generate:<days>" replayed instead of reading the sensors
+    std::string archive;  // Long-term archive, "none" for no archive; a replay is archived only when it is given
+    std::vector<FilterSpec> filters;  // Between the decoder and the statistics, none by default
+    std::vector<int> stageCores = std::vector<int>(PIPELINE_STAGES, -1);  // Core of each pipeline stage, -1 - not pinned
+};
+
+struct Sensor { // Input state of one sensor
+    std::string id;
+    SerialPort port;
+    FrameDecoder decoder;
+};
+
+struct SampleBatch { // Parsed readings of one sensor waiting for the filter stage
+    std::vector<double> values;
+    std::vector<time_t> times;
+};
 
-struct ThreadData { // Structure for transferring data to threads
+struct ReadChunk { // Bytes of one read of a sensor, reader -> decoder
+    std::int64_t timeMs;   // When they were read, the time of every reading they complete
+    std::uint16_t sensor;
+    std::uint16_t size;
+    char data[PIPELINE_CHUNK_SIZE];
+};
+
+struct PipelineSample { // One reading, decoder -> aggregator -> writer
+    double value;
+    std::int64_t timeMs;
+    std::uint16_t sensor;   // PIPELINE_CHECKPOINT_MARKER: no reading, the writer completes the captured checkpoint
+    std::uint8_t textSize;
+    bool parsed;             // value is only valid if the text parsed
+    char text[PIPELINE_TEXT_SIZE];   // As the sensor sent it
+};
+
+struct StatsLogState { // Where the stats logs continue; the mutex also covers the rollovers so a checkpoint sees both consistently
+    std::mutex mutex;
+    std::uint64_t hourlyLogOffset = 0;
+    time_t hourlyLogStartTime = 0;   // Start of the current month of LOG_FILE_NAME_HOUR
+    std::uint64_t dailyLogOffset = 0;
+    int dailyLogYear = -1;
+    std::string checkpointText;      // Latest captured state, saved by the stats thread
+};
+
+struct ThreadData { // Structure for transferring data to the stats thread
 #ifdef _WIN32
-    HANDLE logFile;
+    HANDLE hourlyLogFile;
+    HANDLE dailyLogFile;
 #else
-    std::ofstream *logFile;
+    std::ofstream *hourlyLogFile;
+    std::ofstream *dailyLogFile;
 #endif
-    time_t *nextLogTime;
-    double *averageValue;
-    int *recordCounter;
+    time_t startTime;
+    const std::vector<std::string> *sensorIds;
+    Aggregator *hourlyStats;
+    Aggregator *dailyStats;
+    const WindowStats *windowStats;
+    StatsLogState *state;
 
 #ifdef _WIN32
-    HANDLE threadSemaphore;
+    HANDLE stopSemaphore;
 #else
-    sem_t *threadSemaphore;
+    sem_t *stopSemaphore;
 #endif
 };
 
 volatile unsigned char need_exit = 0; // Flag for program termination
-
-void make_fixed_length_record(std::string& fixed_record, const std::string& record); // Function for creating a fixed length record (Windows, Linux)
+LoggerClock loggerClock; // Time of all log records and periods, the replayed time in replay mode
+
+void make_fixed_length_record(std::string& fixed_record, const std::string& record, size_t length = RECORD_LENGTH); // Function for creating a fixed length record (Windows, Linux)
+void make_stats_record(std::string& fixed_record, const std::string& time, const std::string& sensorId, const PeriodStats& stats); // Function for creating a fixed length record of period statistics (Windows, Linux)
+std::string get_current_time(); // Function for getting the current time in the format YYYY-MM-DD hh:mm:ss.sss (Windows, Linux)
+bool write_window_log(const std::vector<std::string>& sensorIds, const WindowStats& windowStats, time_t now); // Function for replacing the trailing window statistics file (Windows, Linux)
+bool capture_checkpoint(LoggerCheckpoint& checkpoint, StatsLogState& state, Aggregator& hourlyStats, Aggregator& dailyStats, time_t now); // Function for capturing the statistics to checkpoint, skipped while a period is being emitted (Windows, Linux)
+void publish_checkpoint(const LoggerCheckpoint& checkpoint, StatsLogState& state); // Function for handing a complete checkpoint to the stats thread (Windows, Linux)
+bool save_checkpoint(StatsLogState& state, std::string& savedText); // Function for replacing FILE_CHECKPOINT with the latest captured state if it changed (Windows, Linux)
+std::uint64_t find_log_resume_offset(const LoggerCheckpoint& checkpoint); // Function for finding where LOG_FILE_NAME continues after a checkpoint (Windows, Linux)
+std::uint64_t whole_records_offset(const char* path, std::uint64_t offset, size_t length); // Function for limiting an offset to the whole records in a file (Windows, Linux)
+bool parse_options(int argc, char *argv[], LoggerOptions& options); // Function for reading the sensor list, framing and log format from the command line (Windows, Linux)
+bool read_sensor_config_file(const std::string& path, std::vector<SensorConfig>& sensors); // Function for reading "<device> [<sensor_id>]" lines from a file (Windows, Linux)
+bool add_sensor_config(std::vector<SensorConfig>& sensors, const std::string& device, std::string id); // Function for validating and adding one sensor (Windows, Linux)
 
 #ifdef _WIN32
     BOOL WINAPI sig_handler(DWORD signal); // Ctrl+C signal handler (Windows)
-    std::string get_current_time(); // Function for getting the current time in the format YYYY-MM-DD hh:mm:ss.sss (Windows)
     void write_log_to_file(HANDLE fileHandle, const char* record, int size, bool append); // Function for writing a log to a file (Windows)
-    void free_resources(HANDLE* lastRecordFile, HANDLE* logFile, HANDLE* hourlyLogFile, HANDLE* dailyLogFile, HANDLE* sem, HANDLE* serialPort); // Resource release function (Windows)
-    void read_last_records(HANDLE fileHandle, int *value1, int *value2); // Function for reading recent entries from a file (Windows)
-    bool is_file_empty(HANDLE fileHandle); // Function to check if a file is empty (Windows)
-    DWORD WINAPI hourly_log_thread(void *args); // Thread function for recording hourly logs (Windows)
-    DWORD WINAPI daily_log_thread(void *args); // Thread function for recording daily logs (Linux)
+    void free_resources(HANDLE* hourlyLogFile, HANDLE* dailyLogFile, HANDLE* sem, std::vector<Sensor>* sensors); // Resource release function (Windows)
+    std::uint64_t file_position(HANDLE fileHandle); // Function for getting the offset of the next write (Windows)
+    bool wait_for_stop(HANDLE sem, int timeoutMs); // Function for sleeping until the timeout or the stop signal (Windows)
+    void write_stats_log(HANDLE fileHandle, const std::vector<std::string>& sensorIds, const std::vector<PeriodStats>& stats, time_t periodEnd, bool append); // Function for writing one record per sensor to a stats log (Windows)
+    DWORD WINAPI stats_log_thread(void *args); // Thread function for recording hourly and daily logs (Windows)
     std::wstring to_wstring(const std::string& str); // Function to convert ANSI string to Unicode string
 #else
     void sig_handler(int sig); // SIGINT signal handler (Linux)
-    std::string get_current_time(); // Function for getting the current time in the format YYYY-MM-DD hh:mm:ss.sss (Linux)
     void write_log_to_file(std::ofstream& file, const std::string& record, bool append); // Function for writing a log to a file (Linux)
-    void free_resources(std::fstream* lastRecordFile, std::ofstream* logFile, std::ofstream* hourlyLogFile, std::ofstream* dailyLogFile, int* fd); // Resource release function (Linux)
-    bool is_file_empty(std::fstream& file); // Function to check if a file is empty (Linux)
-    void* hourly_log_thread(void *args); // Thread function for recording hourly logs (Linux)
-    void* daily_log_thread(void *args); // Thread function for recording daily logs (Linux)
+    void free_resources(std::ofstream* hourlyLogFile, std::ofstream* dailyLogFile, std::vector<Sensor>* sensors); // Resource release function (Linux)
+    bool wait_for_stop(sem_t *sem, int timeoutMs); // Function for sleeping until the timeout or the stop signal (Linux)
+    void write_stats_log(std::ofstream& file, const std::vector<std::string>& sensorIds, const std::vector<PeriodStats>& stats, time_t periodEnd, bool append); // Function for writing one record per sensor to a stats log (Linux)
+    void* stats_log_thread(void *args); // Thread function for recording hourly and daily logs (Linux)
 #endif
 
 
@@ -105,255 +213,841 @@ int main(int argc, char *argv[]) {
     }
 #endif
 
-    // Stores last record position in log_file and log_file_hour
-#ifdef _WIN32
-    std::wstring lastRecordFile_path = to_wstring(FILE_LAST_RECORD);
-    HANDLE lastRecordFile = CreateFileW(lastRecordFile_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
-    if (lastRecordFile == INVALID_HANDLE_VALUE) {
-        perror("CreateFile (tmp_file)");
+    // Sensors to read: PORT_RD by default
+    LoggerOptions options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--binary | --sequenced] [--baud <bits/s>] [--log-format text|binary|ring] [--retention <seconds>] [--ring-records <n>]"
+                  << " [--durability none|time:<ms>|records:<n>|dsync] [--replay <log>|generate:<days>]"
+                  << " [--archive <file>|none] [--filter median:<n>|ema:<alpha>|hampel:<n>[:<k>],...]"
+                  << " [--pin <reader>,<decoder>,<aggregator>,<writer>]"
+                  << " [--config <file>] [<device>[=<sensor_id>] ...]" << std::endl;
         exit(EXIT_FAILURE);
     }
-#else
-    std::fstream* lastRecordFile = new std::fstream(FILE_LAST_RECORD, std::ios::in | std::ios::out);
-    if (!lastRecordFile->is_open()) {
-        perror("fopen (tmp_file)");
-        exit(EXIT_FAILURE);
+
+    // Replay feeds a recorded log or a generated series through the whole pipeline in virtual time, as fast as it can
+    ReplaySource replay;
+    bool replaying = !options.replay.empty();
+    if (replaying) {
+        std::vector<std::string> ids;
+        for (const SensorConfig& config : options.sensors)
+            ids.push_back(config.id);
+        if (!replay.open(options.replay, ids)) {
+            std::cerr << "Unable to open replay source " << options.replay << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        options.sensors.clear();   // No ports to open
+        loggerClock.start_replay(replay.start_time(), 1);
     }
-#endif
 
-    // Get last record position
-    int lastRecordPosition[2] = {0, 0};
-#ifdef _WIN32
-    if (!is_file_empty(lastRecordFile)) {
-        read_last_records(lastRecordFile, &lastRecordPosition[0], &lastRecordPosition[1]);
-#else
-    if (!is_file_empty(*lastRecordFile)) {
-        *lastRecordFile >> lastRecordPosition[0];
-        *lastRecordFile >> lastRecordPosition[1];
-#endif
+    // Continue the periods and logs of the previous run if it left a checkpoint for the same sensors
+    LoggerCheckpoint checkpoint;
+    bool resume = !replaying && checkpoint_load(FILE_CHECKPOINT, checkpoint);
+    if (resume) {
+        std::vector<std::string> ids;
+        for (const SensorConfig& config : options.sensors)
+            ids.push_back(config.id);
+        resume = ids == checkpoint.sensorIds;
+        std::cout << (resume ? "Resuming from " : "Sensors changed, ignoring ") << FILE_CHECKPOINT << std::endl;
+    }
+    StatsLogState statsLogState;
+    if (resume) {
+        statsLogState.hourlyLogOffset = whole_records_offset(LOG_FILE_NAME_HOUR, checkpoint.hourlyLogOffset, STATS_RECORD_LENGTH);
+        statsLogState.hourlyLogStartTime = checkpoint.hourlyLogStartTime;
+        statsLogState.dailyLogOffset = whole_records_offset(LOG_FILE_NAME_DAY, checkpoint.dailyLogOffset, STATS_RECORD_LENGTH);
+        statsLogState.dailyLogYear = checkpoint.dailyLogYear;
     }
     // Open log files
 #ifdef _WIN32
-    std::wstring logFile_path = to_wstring(LOG_FILE_NAME);
-    HANDLE logFile = CreateFileW(logFile_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
-    if (logFile == INVALID_HANDLE_VALUE) {
-        perror("CreateFile (log_file)");
-        exit(EXIT_FAILURE);
-    }
-
     std::wstring logFileHour_path = to_wstring(LOG_FILE_NAME_HOUR);
-    HANDLE logFileHour = CreateFileW(logFileHour_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
+    HANDLE logFileHour = CreateFileW(logFileHour_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, resume ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
     if (logFileHour == INVALID_HANDLE_VALUE) {
         perror("CreateFile (log_file_hour)");
         exit(EXIT_FAILURE);
     }
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(statsLogState.hourlyLogOffset);
+    SetFilePointerEx(logFileHour, position, NULL, FILE_BEGIN);
 
     std::wstring logFileDay_path = to_wstring(LOG_FILE_NAME_DAY);
-    HANDLE logFileDay = CreateFileW(logFileDay_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
+    HANDLE logFileDay = CreateFileW(logFileDay_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, resume ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_WRITE_THROUGH, NULL);
     if (logFileDay == INVALID_HANDLE_VALUE) {
         perror("CreateFile (log_file_day)");
         exit(EXIT_FAILURE);
     }
+    position.QuadPart = static_cast<LONGLONG>(statsLogState.dailyLogOffset);
+    SetFilePointerEx(logFileDay, position, NULL, FILE_BEGIN);
 #else
-    std::ofstream* logFile = new std::ofstream(LOG_FILE_NAME, std::ios::trunc | std::ios::out);
-    if (!logFile->is_open()) {
-        perror("fopen (log_file)");
-        exit(EXIT_FAILURE);
-    }
-
-    std::ofstream* logFileHour = new std::ofstream(LOG_FILE_NAME_HOUR, std::ios::trunc | std::ios::out);
+    // in | out keeps the contents of a resumed log, it fails if the file is gone
+    std::ofstream* logFileHour = new std::ofstream(LOG_FILE_NAME_HOUR, resume ? std::ios::in | std::ios::out : std::ios::trunc | std::ios::out);
+    if (resume && !logFileHour->is_open())
+        logFileHour->open(LOG_FILE_NAME_HOUR, std::ios::trunc | std::ios::out);
     if (!logFileHour->is_open()) {
         perror("fopen (log_file_hour)");
         exit(EXIT_FAILURE);
     }
+    logFileHour->seekp(static_cast<std::streamoff>(statsLogState.hourlyLogOffset));
 
-    std::ofstream* logFileDay = new std::ofstream(LOG_FILE_NAME_DAY, std::ios::trunc | std::ios::out);
+    std::ofstream* logFileDay = new std::ofstream(LOG_FILE_NAME_DAY, resume ? std::ios::in | std::ios::out : std::ios::trunc | std::ios::out);
+    if (resume && !logFileDay->is_open())
+        logFileDay->open(LOG_FILE_NAME_DAY, std::ios::trunc | std::ios::out);
     if (!logFileDay->is_open()) {
         perror("fopen (log_file_day)");
         exit(EXIT_FAILURE);
     }
+    logFileDay->seekp(static_cast<std::streamoff>(statsLogState.dailyLogOffset));
 #endif
 
-    // Open or create new semaphore
+    // Posted once on exit to wake the stats thread up
 #ifdef _WIN32
-    HANDLE semaphore = CreateSemaphoreW(NULL, 1, 1, to_wstring(SEMAPHORE_OBJECT_NAME).c_str());
+    HANDLE semaphore = CreateSemaphoreW(NULL, 0, 1, NULL);
 #else
-    sem_t *semaphore = sem_open(SEMAPHORE_OBJECT_NAME, O_CREAT, 0777, 1);
+    sem_t stopSemaphore;
+    sem_init(&stopSemaphore, 0, 0);
+    sem_t *semaphore = &stopSemaphore;
 #endif
-    // Configure port
+    // Configure ports, all of them are served by one poller
+    std::vector<Sensor> sensors;
+    std::vector<std::string> sensorIds;
+    SerialPortPoller poller;
+    sensors.reserve(options.sensors.size());
+    if (replaying)
+        sensorIds = replay.sensor_ids();
 #ifdef _WIN32
-    HANDLE serialPort = open_and_configure_port(PORT_RD, BaudRate::BAUDRATE_115200);
-    if (serialPort == INVALID_HANDLE_VALUE) {
-        perror("CreateFile (pd)");
+    try {
+        for (const SensorConfig& config : options.sensors) {
+            sensors.push_back(Sensor{config.id, SerialPort(config.device, options.baud), FrameDecoder(options.frameMode)});
+            poller.add(sensors.back().port, sensors.size() - 1);
+            sensorIds.push_back(config.id);
+        }
+    }
+    catch (std::exception const& ex) {
+        std::cerr << "CreateFile (pd): " << ex.what() << std::endl;
         exit(EXIT_FAILURE);
     }
 #else
-    int serialPort = open_and_configure_port(PORT_RD, BaudRate::BAUDRATE_115200);
-    if (serialPort == -1) {
-        perror("open port");
-        free_resources(lastRecordFile, logFile, logFileHour, logFileDay, &serialPort);
+    try {
+        for (const SensorConfig& config : options.sensors) {
+            sensors.push_back(Sensor{config.id, SerialPort(config.device, options.baud), FrameDecoder(options.frameMode)});
+            poller.add(sensors.back().port, sensors.size() - 1);
+            sensorIds.push_back(config.id);
+        }
+    }
+    catch (std::exception const& ex) {
+        std::cerr << "open port: " << ex.what() << std::endl;
+        free_resources(logFileHour, logFileDay, &sensors);
         exit(EXIT_FAILURE);
     }
 
-    // flush port
-    if (tcflush(serialPort, TCIFLUSH) == -1) {
-      perror("tcflush");
-      free_resources(lastRecordFile, logFile, logFileHour, logFileDay, &serialPort);
-        exit(EXIT_FAILURE);
+    // flush ports
+    for (Sensor& sensor : sensors) {
+        if (!sensor.port.flush_input()) {
+            perror("tcflush");
+            free_resources(logFileHour, logFileDay, &sensors);
+            exit(EXIT_FAILURE);
+        }
     }
 
 #endif
-    int hourlyRecordCounter = 0, dailyRecordCounter = 0;
-    double hourlyAverageValue = 0.0, dailyAverageValue = 0.0;
-
-    time_t startTime = time(NULL);
-    time_t nextHourLogTime = startTime + SEC_IN_HOUR;
-    time_t nextDayLogTime = startTime + SEC_IN_DAY;
-
-    // Create new thread (hour logger)
-#ifdef _WIN32
-    ThreadData params_hour = {logFileHour, &nextHourLogTime, &hourlyAverageValue, &hourlyRecordCounter, semaphore};
-    HANDLE threadHour = CreateThread(NULL, 0, hourly_log_thread, &params_hour, 0, NULL);
-    if (threadHour == NULL) {
-        perror("CreateThread (thr_hour)");
+    // Binary log replaces LOG_FILE_NAME for the per-sample records, a resumed run continues it after its last whole block
+    BinaryLogWriter binaryLog;
+    if (options.binaryLog && !(resume ? binaryLog.resume(LOG_FILE_NAME_BINARY, sensorIds) : binaryLog.open(LOG_FILE_NAME_BINARY, sensorIds))) {
+        perror("open (log_file_binary)");
         exit(EXIT_FAILURE);
     }
-#else
-    ThreadData params_hour = {logFileHour, &nextHourLogTime, &hourlyAverageValue, &hourlyRecordCounter, semaphore};
-    pthread_t threadHour;
-    int status = pthread_create(&threadHour, NULL, hourly_log_thread, &params_hour);
-    if (status != 0) {
-        perror("pthread_create (thr_hour)");
-        free_resources(lastRecordFile, logFile, logFileHour, logFileDay, &serialPort);
+    // Every sample also goes to the compressed archive, which is never rotated
+    ArchiveLogWriter archiveLog;
+    std::string archivePath = options.archive == "none" ? "" : !options.archive.empty() ? options.archive
+                              : replaying ? "" : LOG_FILE_NAME_ARCHIVE;
+    if (!archivePath.empty() && !archiveLog.open(archivePath, sensorIds)) {
+        std::cerr << "open (log_file_archive): " << archiveLog.last_error() << std::endl;
         exit(EXIT_FAILURE);
     }
-#endif
-    // Create new thread (day logger)
+    // LOG_FILE_NAME is written by its own thread so that a slow disk does not hold up the serial reads
+    AsyncLogWriter logWriter;
+    if (!options.binaryLog && !options.ringLog &&
+        !logWriter.open(LOG_FILE_NAME, options.durability, resume, resume ? find_log_resume_offset(checkpoint) : 0)) {
+        perror("open (log_file)");
+        exit(EXIT_FAILURE);
+    }
+    // Ring log keeps a sliding window of retentionSec in a preallocated file instead of restarting LOG_FILE_NAME every 24 hours
+    RingLog ringLog;
+    if (options.ringLog) {
+        long long capacity = options.ringRecords > 0 ? options.ringRecords
+            : options.retentionSec * (1000 / PORT_SPEED_MS) * static_cast<long long>(sensorIds.size()) * RING_LOG_HEADROOM;
+        if (!ringLog.open(LOG_FILE_NAME_RING, RECORD_LENGTH, static_cast<std::uint64_t>(capacity), options.retentionSec)) {
+            perror("open (log_file_ring)");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Hourly and daily statistics, updated by the loop below and emitted by the stats thread on its timers
+    Aggregator hourlyStats(sensorIds.size());
+    Aggregator dailyStats(sensorIds.size());
+    // Per-second and per-minute buckets for the trailing 5 min / 60 min / 24 h statistics
+    WindowStats windowStats(sensorIds.size());
+
+    time_t startTime = loggerClock.now_sec();
+    // A resumed period keeps its end; one that ended while the logger was down is emitted right away
+    if (resume) {
+        hourlyStats.restore(checkpoint.hourly, checkpoint.hourlyEnd);
+        dailyStats.restore(checkpoint.daily, checkpoint.dailyEnd);
+    }
+    else {
+        hourlyStats.restore(std::vector<PeriodStats>(sensorIds.size()), startTime + SEC_IN_HOUR);
+        dailyStats.restore(std::vector<PeriodStats>(sensorIds.size()), startTime + SEC_IN_DAY);
+        statsLogState.hourlyLogStartTime = startTime;
+    }
+
+    // Create new thread (hour and day logger)
 #ifdef _WIN32
-    ThreadData params_day = {logFileDay, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, semaphore};
-    HANDLE threadDay = CreateThread(NULL, 0, daily_log_thread, &params_day, 0, NULL);
-    if (threadDay == NULL) {
-        perror("CreateThread (thr_day)");
+    ThreadData params_stats = {logFileHour, logFileDay, startTime, &sensorIds, &hourlyStats, &dailyStats, &windowStats, &statsLogState, semaphore};
+    HANDLE threadStats = CreateThread(NULL, 0, stats_log_thread, &params_stats, 0, NULL);
+    if (threadStats == NULL) {
+        perror("CreateThread (thr_stats)");
         exit(EXIT_FAILURE);
     }
 #else
-    ThreadData params_day = {logFileDay, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, semaphore};
-    pthread_t threadDay;
-    status = pthread_create(&threadDay, NULL, daily_log_thread, &params_day);
+    ThreadData params_stats = {logFileHour, logFileDay, startTime, &sensorIds, &hourlyStats, &dailyStats, &windowStats, &statsLogState, semaphore};
+    pthread_t threadStats;
+    int status = pthread_create(&threadStats, NULL, stats_log_thread, &params_stats);
     if (status != 0) {
-        perror("pthread_create (thr_day)");
-        free_resources(lastRecordFile, logFile, logFileHour, logFileDay, &serialPort);
+        perror("pthread_create (thr_stats)");
+        free_resources(logFileHour, logFileDay, &sensors);
         exit(EXIT_FAILURE);
     }
 #endif
-    std::string currentTime;
-    std::vector<char> buffer(255);
-    std::string logRecord;
-    double currentTemperature;
-    time_t logStartTime = startTime;
-    bool append_mode = false;
-#ifdef _WIN32
-    while (!need_exit) {
-        DWORD bytesRead;
-        if (ReadFile(serialPort, buffer.data(), buffer.size(), &bytesRead, NULL)) {
-            if (bytesRead > 0) {
-
-                currentTime = get_current_time();
-                logRecord = currentTime + " " + std::string(buffer.data(), bytesRead);
-
-                std::string fixed_record;
-                make_fixed_length_record(fixed_record, logRecord);
-                
-                time_t currentTimeSec = time(NULL);
-                if (currentTimeSec - logStartTime >= SEC_IN_DAY) {
-                   logStartTime = currentTimeSec;
-                   append_mode = false;
+    // Ingest runs as a pipeline, each stage on its own thread: reader (this thread) -> decoder -> aggregator -> writer,
+    // connected by bounded lock-free queues. A full queue holds its producer back, nothing is dropped: while the reader
+    // waits the serial ports buffer. A replay is read as readings and skips the decoder
+    SpscRing<ReadChunk> chunks(PIPELINE_CHUNK_QUEUE);
+    SpscRing<PipelineSample> samples(PIPELINE_SAMPLE_QUEUE);
+    SpscRing<PipelineSample> records(PIPELINE_SAMPLE_QUEUE);
+    StageCounters stageCounters[PIPELINE_STAGES];
+    StageCounters& readerCounters = stageCounters[0];
+    StageCounters& decoderCounters = stageCounters[1];
+    StageCounters& aggregatorCounters = stageCounters[2];
+    StageCounters& writerCounters = stageCounters[3];
+    StageCounters& sampleProducer = replaying ? readerCounters : decoderCounters;   // Feeds the aggregator
+    std::vector<size_t> readySensors;
+    time_t logStartTime = resume ? static_cast<time_t>(checkpoint.logStartTime) : startTime;
+    time_t nextCheckpointTime = startTime;
+    std::atomic<bool> checkpointPending{false};   // Captured by the aggregator, not yet completed by the writer
+    checkpoint.sensorIds = sensorIds;
+
+    auto pin_stage = [&](int stage) {
+        int core = options.stageCores[stage];
+        if (core >= 0 && !pin_current_thread(core))
+            std::cerr << "Unable to pin the " << PIPELINE_STAGE_NAMES[stage] << " stage to core " << core << std::endl;
+    };
+
+    // One reading of sensor index as the sensor sent it, parsed once for all the stages after it
+    auto fill_sample = [&](PipelineSample& sample, size_t index, std::string_view text, std::int64_t timeMs) {
+        sample.parsed = parse_sample_value(text, sample.value);
+        sample.timeMs = timeMs;
+        sample.sensor = static_cast<std::uint16_t>(index);
+        sample.textSize = static_cast<std::uint8_t>(std::min(text.size(), sizeof(sample.text)));
+        memcpy(sample.text, text.data(), sample.textSize);
+    };
+
+    // Decoder: the readings out of the reads of each sensor
+    auto run_decoder = [&]() {
+        pin_stage(1);
+        IdleBackoff backoff;
+        std::string_view frame;
+        while (true) {
+            ReadChunk* chunk = chunks.read_slot();
+            if (chunk == nullptr) {
+                if (readerCounters.finished.load(std::memory_order_acquire) && chunks.read_slot() == nullptr)
+                    break;
+                if (backoff.idle())
+                    chunks.wait_readable(idle_wait(PIPELINE_IDLE_WAIT_MS));
+                else
+                    backoff.wait();
+                continue;
+            }
+            backoff.reset();
+            decoderCounters.input_occupancy(chunks.size());
+            FrameDecoder& decoder = sensors[chunk->sensor].decoder;
+            size_t pushed = 0;
+            while (true) {
+                size_t added = decoder.push(chunk->data + pushed, chunk->size - pushed);
+                pushed += added;
+                // A read may carry several readings or only a part of one
+                while (decoder.next_frame(&frame)) {
+                    fill_sample(*wait_for_slot(samples, decoderCounters), chunk->sensor, frame, chunk->timeMs);
+                    samples.publish();
+                    decoderCounters.add(1);
                 }
-                else append_mode = true;
+                // A decoder full of bytes without a frame in them loses the rest of the read
+                if (pushed == chunk->size || added == 0)
+                    break;
+            }
+            chunks.release();
+        }
+        decoderCounters.finished.store(true, std::memory_order_release);
+        samples.wake_consumer();
+    };
+
+    // The logs keep what the sensors sent, the statistics get the readings through the filter stage, a batch per sensor.
+    // A reading that does not parse is logged but not counted
+    FilterStage filterStage(options.filters, sensorIds.size());
+    std::vector<SampleBatch> batches(sensorIds.size());
+
+    // The batch of sensor index through the filters into the statistics
+    auto aggregate_batch = [&](size_t index) {
+        SampleBatch& batch = batches[index];
+        if (batch.values.empty())
+            return;
+        filterStage.process(index, batch.values.data(), batch.values.size());
+        for (size_t i = 0; i < batch.values.size(); ++i) {
+            hourlyStats.add(index, batch.values[i]);
+            dailyStats.add(index, batch.values[i]);
+            windowStats.add(index, batch.values[i], batch.times[i]);
+        }
+        batch.values.clear();
+        batch.times.clear();
+    };
+
+    auto aggregate_all = [&]() {
+        for (size_t i = 0; i < batches.size(); ++i)
+            aggregate_batch(i);
+    };
+
+    // Live: the readings held back go to the statistics, and every CHECKPOINT_PERIOD_SEC the statistics are captured for
+    // FILE_CHECKPOINT, retried while the stats thread is emitting a period. The writer completes the checkpoint with the
+    // log position when it reaches the marker, that is once it has written every reading counted in it.
+    // Returns the ms until the next checkpoint is due, 0 if it has to be retried
+    auto aggregator_housekeeping = [&]() -> std::int64_t {
+        aggregate_all();
+        std::int64_t nowMs = loggerClock.now_ms();
+        time_t now = static_cast<time_t>(nowMs / 1000);
+        if (now < nextCheckpointTime)
+            return static_cast<std::int64_t>(nextCheckpointTime) * 1000 - nowMs;
+        if (checkpointPending.load(std::memory_order_acquire))
+            return 0;
+        if (!capture_checkpoint(checkpoint, statsLogState, hourlyStats, dailyStats, now))
+            return 0;
+        nextCheckpointTime = now + CHECKPOINT_PERIOD_SEC;
+        checkpointPending.store(true, std::memory_order_relaxed);
+        PipelineSample* marker = wait_for_slot(records, aggregatorCounters);
+        marker->sensor = PIPELINE_CHECKPOINT_MARKER;
+        records.publish();
+        return static_cast<std::int64_t>(nextCheckpointTime) * 1000 - nowMs;
+    };
+
+    // Aggregator: the statistics, and the clock of a replay
+    auto run_aggregator = [&]() {
+        pin_stage(2);
+        IdleBackoff backoff;
+        std::uint64_t aggregated = 0;
+        while (true) {
+            PipelineSample* sample = samples.read_slot();
+            if (sample == nullptr) {
+                if (sampleProducer.finished.load(std::memory_order_acquire) && samples.read_slot() == nullptr)
+                    break;
+                std::int64_t dueMs = replaying ? PIPELINE_IDLE_WAIT_MS : aggregator_housekeeping();
+                if (backoff.idle())
+                    samples.wait_readable(idle_wait(dueMs));
+                else
+                    backoff.wait();
+                continue;
+            }
+            backoff.reset();
+            if (replaying) {
+                LoggerClock::time_point time{std::chrono::milliseconds(sample->timeMs)};
+                // The held back readings belong to the periods about to be emitted
+                if (loggerClock.wakes_sleeper(time))
+                    aggregate_all();
+                // Returns once the periods that ended before this sample have been emitted
+                loggerClock.advance_to(time);
+                sample->timeMs = loggerClock.now_ms();
+            }
+            *wait_for_slot(records, aggregatorCounters) = *sample;
+            records.publish();
+            if (sample->parsed) {
+                SampleBatch& batch = batches[sample->sensor];
+                batch.values.push_back(sample->value);
+                batch.times.push_back(static_cast<time_t>(sample->timeMs / 1000));
+                if (batch.values.size() >= FILTER_BATCH_SAMPLES)
+                    aggregate_batch(sample->sensor);
+            }
+            samples.release();
+            aggregatorCounters.add(1);
+            if (++aggregated % PIPELINE_OCCUPANCY_ITEMS == 0)
+                aggregatorCounters.input_occupancy(samples.size());
+            if (!replaying && aggregated % PIPELINE_HOUSEKEEPING_ITEMS == 0)
+                aggregator_housekeeping();
+        }
+        aggregate_all();
+        if (replaying)
+            loggerClock.advance_to(replay.end_time());   // Periods that end with the series are emitted too
+        aggregatorCounters.finished.store(true, std::memory_order_release);
+        records.wake_consumer();
+    };
+
+    // Per-sample buffers of the writer, reused so that it does not allocate
+    TimestampCache timestamps;
+    FixedRecordBuilder logRecord(RECORD_LENGTH);
+    bool append_mode = false;
 
-                write_log_to_file(logFile, fixed_record.c_str(), fixed_record.size(), append_mode);
+    // One reading: log record, and the archive if it parsed
+    auto write_sample = [&](const PipelineSample& sample) {
+        LoggerClock::time_point now{std::chrono::milliseconds(sample.timeMs)};
+        time_t currentTimeSec = std::chrono::system_clock::to_time_t(now);
+        if (currentTimeSec - logStartTime >= SEC_IN_DAY) {
+           logStartTime = currentTimeSec;
+           append_mode = false;
+        }
+        else append_mode = true;
 
-                currentTemperature = atof(buffer.data());
-                hourlyRecordCounter++;
-                hourlyAverageValue += (currentTemperature - hourlyAverageValue) / hourlyRecordCounter;
+        if (binaryLog.is_open()) {
+            if (!append_mode)
+                binaryLog.restart();
+            binaryLog.append(sample.timeMs, sample.sensor, static_cast<float>(sample.value));
+        }
+        else {
+            const char* fixed_record = logRecord.clear().append(std::string_view(timestamps.format(now), TIMESTAMP_LENGTH))
+                .append(' ').append(sensorIds[sample.sensor]).append(' ').append(std::string_view(sample.text, sample.textSize)).finish();
 
-                currentTemperature = atof(buffer.data());
-                dailyRecordCounter++;
-                dailyAverageValue += (currentTemperature - dailyAverageValue) / dailyRecordCounter;
+            if (ringLog.is_open())
+                ringLog.append(fixed_record, currentTimeSec);
+            else
+                logWriter.append(fixed_record, logRecord.size(), !append_mode);
+        }
+        if (sample.parsed && archiveLog.is_open()) {
+            archiveLog.append(sample.timeMs, sample.sensor, static_cast<float>(sample.value));
+            archiveLog.flush_if_due(sample.timeMs);
+        }
+    };
+
+    // Live: do not keep a partial block of a slow sensor in memory for long, expire old records even while no sensor is sending.
+    // Returns the ms until the next partial block is due
+    auto writer_housekeeping = [&]() -> std::int64_t {
+        std::int64_t nowMs = loggerClock.now_ms();
+        binaryLog.flush_if_due(nowMs);
+        archiveLog.flush_if_due(nowMs);
+        if (ringLog.is_open())
+            ringLog.expire(loggerClock.now_sec());
+        std::int64_t dueMs = std::min(binaryLog.due_ms(), archiveLog.due_ms());
+        return dueMs == INT64_MAX ? PIPELINE_IDLE_WAIT_MS : dueMs - nowMs;
+    };
+
+    // Writer: the per-sample logs, and the checkpoints the aggregator captured
+    auto run_writer = [&]() {
+        pin_stage(3);
+        IdleBackoff backoff;
+        std::uint64_t written = 0;
+        while (true) {
+            PipelineSample* record = records.read_slot();
+            if (record == nullptr) {
+                if (aggregatorCounters.finished.load(std::memory_order_acquire) && records.read_slot() == nullptr)
+                    break;
+                std::int64_t dueMs = replaying ? PIPELINE_IDLE_WAIT_MS : writer_housekeeping();
+                if (backoff.idle())
+                    records.wait_readable(idle_wait(dueMs));
+                else
+                    backoff.wait();
+                continue;
+            }
+            backoff.reset();
+            if (record->sensor == PIPELINE_CHECKPOINT_MARKER) {
+                checkpoint.logOffset = logWriter.is_open() ? logWriter.appended_offset() : 0;
+                checkpoint.logStartTime = logStartTime;
+                publish_checkpoint(checkpoint, statsLogState);
+                checkpointPending.store(false, std::memory_order_release);
+            }
+            else {
+                write_sample(*record);
+                writerCounters.add(1);
             }
+            records.release();
+            if (++written % PIPELINE_OCCUPANCY_ITEMS == 0)
+                writerCounters.input_occupancy(records.size());
+            if (!replaying && written % PIPELINE_HOUSEKEEPING_ITEMS == 0)
+                writer_housekeeping();
         }
-        else {
-            perror("ReadFile (pd)");
+        writerCounters.finished.store(true, std::memory_order_release);
+    };
+
+    // The stages pin themselves; started before the reader pins this thread so that they do not inherit its core
+    std::chrono::steady_clock::time_point pipelineStart = std::chrono::steady_clock::now();
+    std::thread decoderThread;
+    if (!replaying)
+        decoderThread = std::thread(run_decoder);
+    std::thread aggregatorThread(run_aggregator);
+    std::thread writerThread(run_writer);
+    pin_stage(0);
+
+    if (replaying) {
+        ReplaySample sample;
+        while (!need_exit && replay.next(sample)) {
+            size_t index = static_cast<size_t>(std::find(sensorIds.begin(), sensorIds.end(), sample.sensorId) - sensorIds.begin());
+            fill_sample(*wait_for_slot(samples, readerCounters), index, sample.value,
+                        std::chrono::duration_cast<std::chrono::milliseconds>(sample.time.time_since_epoch()).count());
+            samples.publish();
+            readerCounters.add(1);
+        }
+    }
+#ifdef _WIN32
+    while (!replaying && !need_exit) {
+        // Returns as soon as any port has data, wakes up at least every PORT_SPEED_MS to check need_exit
+        if (poller.wait(PORT_SPEED_MS, readySensors) < 0) {
+            perror("ClearCommError (pd)");
             break;
         }
-        Sleep(PORT_SPEED_MS);
+        for (size_t index : readySensors) {
+            ReadChunk* chunk = wait_for_slot(chunks, readerCounters);
+            int bytesRead = sensors[index].port.read_some(chunk->data, sizeof(chunk->data), 0);
+            if (bytesRead < 0) {
+                perror("ReadFile (pd)");
+                need_exit = 1;
+                break;
+            }
+            if (bytesRead > 0) {
+                chunk->timeMs = loggerClock.now_ms();
+                chunk->sensor = static_cast<std::uint16_t>(index);
+                chunk->size = static_cast<std::uint16_t>(bytesRead);
+                chunks.publish();
+                readerCounters.add(1);
+            }
+        }
     }
 #else
-    while (!need_exit) {
-        ssize_t bytesRead = read(serialPort, buffer.data(), buffer.size());
-        if (bytesRead > 0) {
-
-            currentTime = get_current_time();
-            logRecord = currentTime + " " + std::string(buffer.data(), bytesRead);
-
-            std::string fixed_record;
-            make_fixed_length_record(fixed_record, logRecord);
-             
-            time_t currentTimeSec = time(NULL);
-            if (currentTimeSec - logStartTime >= SEC_IN_DAY) {
-               logStartTime = currentTimeSec;
-               append_mode = false;
+    while (!replaying && !need_exit) {
+        // Returns as soon as any port has data, wakes up at least every PORT_SPEED_MS to check need_exit
+        if (poller.wait(PORT_SPEED_MS, readySensors) < 0) {
+            perror("epoll_wait");
+            break;
+        }
+        for (size_t index : readySensors) {
+            ReadChunk* chunk = wait_for_slot(chunks, readerCounters);
+            int bytesRead = sensors[index].port.read_some(chunk->data, sizeof(chunk->data), 0);
+            if (bytesRead < 0) {
+                perror("read (pd)");
+                need_exit = 1;
+                break;
+            }
+            if (bytesRead > 0) {
+                chunk->timeMs = loggerClock.now_ms();
+                chunk->sensor = static_cast<std::uint16_t>(index);
+                chunk->size = static_cast<std::uint16_t>(bytesRead);
+                chunks.publish();
+                readerCounters.add(1);
             }
-            else append_mode = true;
-            
-            write_log_to_file(*logFile, fixed_record, append_mode);
-
-            currentTemperature = atof(buffer.data());
-            hourlyRecordCounter++;
-            hourlyAverageValue += (currentTemperature - hourlyAverageValue) / hourlyRecordCounter;
-
-            currentTemperature = atof(buffer.data());
-            dailyRecordCounter++;
-            dailyAverageValue += (currentTemperature - dailyAverageValue) / dailyRecordCounter;
         }
-        usleep(1000 * PORT_SPEED_MS);
     }
 #endif
+    // The stages drain their queues and stop in order
+    readerCounters.finished.store(true, std::memory_order_release);
+    if (replaying)
+        samples.wake_consumer();
+    else
+        chunks.wake_consumer();
+    if (decoderThread.joinable())
+        decoderThread.join();
+    aggregatorThread.join();
+    writerThread.join();
+    double pipelineSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - pipelineStart).count();
+    if (replaying) {
+        std::uint64_t replayed = readerCounters.items.load();
+        std::cout << "replayed " << replayed << " samples, " << std::chrono::duration_cast<std::chrono::seconds>(replay.end_time() - replay.start_time()).count()
+                  << " s of data in " << std::fixed << std::setprecision(2) << pipelineSeconds << " s, " << std::setprecision(0)
+                  << replayed / (pipelineSeconds > 0 ? pipelineSeconds : 1) << " samples/s" << std::endl;
+    }
+    need_exit = 1;
+    SemaphorePost(semaphore);
+    loggerClock.stop();
 #ifdef _WIN32
-    WaitForSingleObject(threadHour, INFINITE);
-    CloseHandle(threadHour);
-    WaitForSingleObject(threadDay, INFINITE);
-    CloseHandle(threadDay);
+    WaitForSingleObject(threadStats, INFINITE);
+    CloseHandle(threadStats);
 #else
-    pthread_join(threadHour, NULL);
-    pthread_join(threadDay, NULL);
+    pthread_join(threadStats, NULL);
+    sem_destroy(&stopSemaphore);
 #endif
 
+    // The next start continues exactly here (a replay is not continued)
+    if (!replaying) {
+        checkpoint.logOffset = logWriter.is_open() ? logWriter.appended_offset() : 0;
+        checkpoint.logStartTime = logStartTime;
+        if (capture_checkpoint(checkpoint, statsLogState, hourlyStats, dailyStats, loggerClock.now_sec()))
+            publish_checkpoint(checkpoint, statsLogState);
+        std::string savedText;
+        if (!save_checkpoint(statsLogState, savedText))
+            perror("write (checkpoint)");
+    }
+
+    binaryLog.close();
+    archiveLog.close();
+    ringLog.close();
+    if (logWriter.is_open()) {
+        logWriter.close();
+        AsyncWriterStats writerStats = logWriter.stats();
+        std::cout << "log writer: " << writerStats.flushes << " flushes, " << writerStats.bytes << " bytes, max queue "
+                  << writerStats.maxQueueBytes << " bytes, flush latency avg "
+                  << (writerStats.flushes > 0 ? writerStats.totalFlushUs / writerStats.flushes : 0) << " us, max "
+                  << writerStats.maxFlushUs << " us, " << writerStats.syncs << " syncs, loss window max "
+                  << writerStats.maxLossWindowUs / 1000 << " ms / " << writerStats.maxLossRecords << " records, "
+                  << writerStats.stalls << " stalls, " << writerStats.errors << " errors" << std::endl;
+    }
+    // Per stage: what it handled and how fast, the fullest its input queue got, how often its output queue held it back
+    const size_t inputCapacity[PIPELINE_STAGES] = {0, chunks.capacity(), samples.capacity(), records.capacity()};
+    for (int stage = 0; stage < PIPELINE_STAGES; ++stage) {
+        const StageCounters& counters = stageCounters[stage];
+        if (replaying && &counters == &decoderCounters)
+            continue;
+        std::uint64_t items = counters.items.load();
+        std::cout << PIPELINE_STAGE_NAMES[stage] << ": " << items << (stage == 0 && !replaying ? " reads, " : " samples, ")
+                  << std::fixed << std::setprecision(0) << items / (pipelineSeconds > 0 ? pipelineSeconds : 1) << "/s";
+        if (stage > 0)
+            std::cout << ", input queue max " << counters.maxInput.load() << " of " << inputCapacity[stage];
+        if (stage < PIPELINE_STAGES - 1)
+            std::cout << ", output queue full " << counters.fullWaits.load() << " times";
+        std::cout << std::endl;
+    }
+    // Link quality: sequence gaps and repeats, damaged frames
+    if (options.frameMode == FrameMode::SEQUENCED) {
+        for (const Sensor& sensor : sensors) {
+            std::cout << "sensor " << sensor.id << ": " << sensor.decoder.frames() << " frames, " << sensor.decoder.lost_frames()
+                      << " lost, " << sensor.decoder.duplicate_frames() << " duplicated, " << sensor.decoder.crc_errors()
+                      << " CRC errors, " << sensor.decoder.dropped_bytes() << " bytes skipped" << std::endl;
+        }
+    }
+
 #ifdef _WIN32
-    SetFilePointer(lastRecordFile, 0, NULL, FILE_BEGIN);
-    std::string tmp_buffer = std::to_string(lastRecordPosition[0]) + "\n" + std::to_string(lastRecordPosition[1]) + "\n";
-    WriteFile(lastRecordFile, tmp_buffer.c_str(), tmp_buffer.size(), NULL, NULL);
+    free_resources(&logFileHour, &logFileDay, &semaphore, &sensors);
 #else
-    lastRecordFile->seekg(0, std::ios::beg);
-    *lastRecordFile << lastRecordPosition[0] << "\n";
-    *lastRecordFile << lastRecordPosition[1] << "\n";
+    free_resources(logFileHour, logFileDay, &sensors);
 #endif
+    return 0;
+}
+
+
+void make_fixed_length_record(std::string& fixed_record, const std::string& record, size_t length) {
+    fixed_record.assign(length - 1, ' ');
+    fixed_record.append("\n");
+    size_t copy_len = std::min(record.size(), length - 1);
+    fixed_record.replace(0, copy_len, record, 0, copy_len);
+}
+
+void make_stats_record(std::string& fixed_record, const std::string& time, const std::string& sensorId, const PeriodStats& stats) {
+    char values[128];
+    snprintf(values, sizeof(values), " %f %f %f %f %llu", stats.average(), stats.minimum(), stats.maximum(), stats.stddev(),
+             static_cast<unsigned long long>(stats.count));
+    make_fixed_length_record(fixed_record, time + " " + sensorId + values, STATS_RECORD_LENGTH);
+}
+
+std::string get_current_time() {
+    TimestampCache timestamp;
+    return std::string(timestamp.format(loggerClock.now()), TIMESTAMP_LENGTH);
+}
+
+bool write_window_log(const std::vector<std::string>& sensorIds, const WindowStats& windowStats, time_t now) {
+    // "<time> <sensor_id> <window_sec> <mean> <min> <max> <count>" per sensor and window, replaced as a whole
+    std::string currentTime = get_current_time();
+    std::string report, fixed_record;
+    char values[128];
+    for (size_t i = 0; i < sensorIds.size(); ++i) {
+        for (time_t window : {time_t(5 * 60), time_t(SEC_IN_HOUR), time_t(SEC_IN_DAY)}) {
+            WindowSummary summary = windowStats.query(i, window, now);
+            snprintf(values, sizeof(values), " %lld %f %f %f %llu", static_cast<long long>(window), summary.mean(),
+                     summary.minimum(), summary.maximum(), static_cast<unsigned long long>(summary.count));
+            make_fixed_length_record(fixed_record, currentTime + " " + sensorIds[i] + values, STATS_RECORD_LENGTH);
+            report += fixed_record;
+        }
+    }
+    std::string tmpPath = std::string(LOG_FILE_NAME_WINDOW) + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc | std::ios::out | std::ios::binary);
+        if (!file.write(report.data(), report.size()))
+            return false;
+    }
 #ifdef _WIN32
-    close_port(serialPort);
-    free_resources(&lastRecordFile, &logFile, &logFileHour, &logFileDay, &semaphore, &serialPort);
+    return MoveFileExA(tmpPath.c_str(), LOG_FILE_NAME_WINDOW, MOVEFILE_REPLACE_EXISTING) != 0;
 #else
-    close_port(serialPort);
-    free_resources(lastRecordFile, logFile, logFileHour, logFileDay, &serialPort);
+    return rename(tmpPath.c_str(), LOG_FILE_NAME_WINDOW) == 0;
 #endif
-    return 0;
 }
 
+bool capture_checkpoint(LoggerCheckpoint& checkpoint, StatsLogState& state, Aggregator& hourlyStats, Aggregator& dailyStats, time_t now) {
+    // The statistics and the stats log offsets have to match: skip while the stats thread rolls a period over
+    std::unique_lock<std::mutex> lock(state.mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+    checkpoint.savedTime = now;
+    checkpoint.hourlyEnd = hourlyStats.snapshot(checkpoint.hourly);
+    checkpoint.dailyEnd = dailyStats.snapshot(checkpoint.daily);
+    checkpoint.hourlyLogOffset = state.hourlyLogOffset;
+    checkpoint.hourlyLogStartTime = state.hourlyLogStartTime;
+    checkpoint.dailyLogOffset = state.dailyLogOffset;
+    checkpoint.dailyLogYear = state.dailyLogYear;
+    return true;
+}
 
-void make_fixed_length_record(std::string& fixed_record, const std::string& record) {
-    fixed_record.assign(RECORD_LENGTH - 1, ' ');
-    fixed_record.append("\n");
-    size_t copy_len = std::min(record.size(), static_cast<size_t>(RECORD_LENGTH - 1));
-    fixed_record.replace(0, copy_len, record.substr(0, copy_len));
+void publish_checkpoint(const LoggerCheckpoint& checkpoint, StatsLogState& state) {
+    std::string text = checkpoint_serialize(checkpoint);
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.checkpointText.swap(text);
+}
+
+bool save_checkpoint(StatsLogState& state, std::string& savedText) {
+    std::string text;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        text = state.checkpointText;
+    }
+    if (text.empty() || text == savedText)
+        return true;
+    if (!checkpoint_save(FILE_CHECKPOINT, text))
+        return false;
+    savedText.swap(text);
+    return true;
+}
+
+std::uint64_t find_log_resume_offset(const LoggerCheckpoint& checkpoint) {
+    // Records appended after the checkpoint may have reached the file; unlike the leftovers of the previous
+    // 24 hour cycle they are not older than the checkpoint, so they are kept
+    std::uint64_t offset = whole_records_offset(LOG_FILE_NAME, checkpoint.logOffset, RECORD_LENGTH);
+    std::ifstream file(LOG_FILE_NAME, std::ios::binary);
+    if (!file.is_open())
+        return 0;
+    char savedTime[RING_LOG_TIME_PREFIX];
+    ring_log_format_time(savedTime, static_cast<time_t>(checkpoint.savedTime));
+    char record[RECORD_LENGTH];
+    file.seekg(static_cast<std::streamoff>(offset));
+    while (file.read(record, RECORD_LENGTH) && record[RECORD_LENGTH - 1] == '\n' && memcmp(record, savedTime, RING_LOG_TIME_PREFIX) >= 0)
+        offset += RECORD_LENGTH;
+    return offset;
+}
+
+std::uint64_t whole_records_offset(const char* path, std::uint64_t offset, size_t length) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return 0;
+    std::uint64_t size = static_cast<std::uint64_t>(file.tellg());
+    return std::min(offset, size - size % length);
+}
+
+bool parse_options(int argc, char *argv[], LoggerOptions& options) {
+    std::vector<SensorConfig>& sensors = options.sensors;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--binary") {
+            options.frameMode = FrameMode::LENGTH_PREFIXED;  // temperature_simulator --format binary
+            continue;
+        }
+        if (arg == "--sequenced") {
+            options.frameMode = FrameMode::SEQUENCED;  // temperature_simulator --format sequenced
+            continue;
+        }
+        if (arg == "--baud") {
+            long long number;
+            try {
+                number = i + 1 < argc ? std::stoll(argv[++i]) : 0;
+            }
+            catch (std::exception const& ex) {
+                return false;
+            }
+            if (number <= 0 || number > UINT_MAX)
+                return false;
+            options.baud = static_cast<unsigned int>(number);
+            continue;
+        }
+        if (arg == "--log-format") {
+            if (i + 1 >= argc)
+                return false;
+            std::string format = argv[++i];
+            if (format != "text" && format != "binary" && format != "ring")
+                return false;
+            options.binaryLog = format == "binary";
+            options.ringLog = format == "ring";
+            continue;
+        }
+        if (arg == "--replay" || arg == "--archive") {
+            if (i + 1 >= argc)
+                return false;
+            (arg == "--replay" ? options.replay : options.archive) = argv[++i];
+            continue;
+        }
+        if (arg == "--filter") {
+            if (i + 1 >= argc || !parse_filter_chain(argv[++i], options.filters))
+                return false;
+            continue;
+        }
+        if (arg == "--pin") {
+            if (i + 1 >= argc || !parse_stage_cores(argv[++i], options.stageCores))
+                return false;
+            continue;
+        }
+        if (arg == "--durability") {
+            if (i + 1 >= argc || !parse_durability(argv[++i], options.durability))
+                return false;
+            continue;
+        }
+        if (arg == "--retention" || arg == "--ring-records") {
+            long long number;
+            try {
+                number = i + 1 < argc ? std::stoll(argv[++i]) : 0;
+            }
+            catch (std::exception const& ex) {
+                return false;
+            }
+            if (number <= 0)
+                return false;
+            (arg == "--retention" ? options.retentionSec : options.ringRecords) = number;
+            continue;
+        }
+        if (arg == "--config") {
+            if (i + 1 >= argc || !read_sensor_config_file(argv[++i], sensors))
+                return false;
+            continue;
+        }
+        size_t separator = arg.find('=');
+        if (separator == std::string::npos) {
+            if (!add_sensor_config(sensors, arg, ""))
+                return false;
+        }
+        else if (!add_sensor_config(sensors, arg.substr(0, separator), arg.substr(separator + 1)))
+            return false;
+    }
+    if (sensors.empty())
+        return add_sensor_config(sensors, PORT_RD, "");
+    return true;
+}
+
+bool read_sensor_config_file(const std::string& path, std::vector<SensorConfig>& sensors) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Unable to open sensor config " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string device, id;
+        if (!(iss >> device) || device[0] == '#')
+            continue;
+        iss >> id;
+        if (!add_sensor_config(sensors, device, id))
+            return false;
+    }
+    return true;
+}
+
+bool add_sensor_config(std::vector<SensorConfig>& sensors, const std::string& device, std::string id) {
+    if (id.empty())
+        id = std::to_string(sensors.size());
+    if (device.empty() || id.size() > SENSOR_ID_MAX_LENGTH || id.find_first_of(" \t") != std::string::npos) {
+        std::cerr << "Invalid sensor '" << device << "=" << id << "' (id: up to " << SENSOR_ID_MAX_LENGTH << " characters, no spaces)" << std::endl;
+        return false;
+    }
+    for (const SensorConfig& sensor : sensors) {
+        if (sensor.device == device || sensor.id == id) {
+            std::cerr << "Duplicate sensor '" << device << "=" << id << "'" << std::endl;
+            return false;
+        }
+    }
+    sensors.push_back({device, id});
+    return true;
 }
 
 #ifdef _WIN32
@@ -365,20 +1059,6 @@ void make_fixed_length_record(std::string& fixed_record, const std::string& reco
         return FALSE;
     }
 
-    std::string get_current_time() {
-        SYSTEMTIME st;
-        GetLocalTime(&st);
-        std::ostringstream oss;
-        oss << std::setfill('0') << std::setw(4) << st.wYear << "-"
-            << std::setw(2) << st.wMonth << "-"
-            << std::setw(2) << st.wDay << " "
-            << std::setw(2) << st.wHour << ":"
-            << std::setw(2) << st.wMinute << ":"
-            << std::setw(2) << st.wSecond << "."
-            << std::setw(3) << st.wMilliseconds;
-        return oss.str();
-    }
-
     void write_log_to_file(HANDLE fileHandle, const char* record, int size, bool append) {
         DWORD bytesWritten;
         if(!append)
@@ -387,151 +1067,97 @@ void make_fixed_length_record(std::string& fixed_record, const std::string& reco
     }
 
 
-    void free_resources(HANDLE* lastRecordFile, HANDLE* logFile, HANDLE* hourlyLogFile, HANDLE* dailyLogFile, HANDLE* sem, HANDLE* serialPort) {
-        if (lastRecordFile != nullptr) { CloseHandle(*lastRecordFile); *lastRecordFile = nullptr; }
-        if (logFile != nullptr) { CloseHandle(*logFile); *logFile = nullptr; }
+    void free_resources(HANDLE* hourlyLogFile, HANDLE* dailyLogFile, HANDLE* sem, std::vector<Sensor>* sensors) {
         if (hourlyLogFile != nullptr) { CloseHandle(*hourlyLogFile); *hourlyLogFile = nullptr; }
         if (dailyLogFile != nullptr) { CloseHandle(*dailyLogFile); *dailyLogFile = nullptr; }
         if (sem != nullptr) { CloseHandle(*sem); *sem = nullptr; }
-            if (serialPort != nullptr) {  *serialPort = nullptr; }
+        if (sensors != nullptr) { for (Sensor& sensor : *sensors) sensor.port.close(); }
     }
 
-    void read_last_records(HANDLE fileHandle, int *value1, int *value2) {
-        char buffer[256] = {0};
-        DWORD bytesRead;
-        if (!ReadFile(fileHandle, buffer, sizeof(buffer) - 1, &bytesRead, NULL)) {
-            perror("ReadFile (tmp_file)");
-            exit(EXIT_FAILURE);
-        }
-        buffer[bytesRead] = '\0';
+    std::uint64_t file_position(HANDLE fileHandle) {
+        LARGE_INTEGER zero = {}, position = {};
+        SetFilePointerEx(fileHandle, zero, &position, FILE_CURRENT);
+        return static_cast<std::uint64_t>(position.QuadPart);
+    }
 
-        if (sscanf(buffer, "%d %d", value1, value2) != 2) {
-            perror("sscanf (tmp_file)");
-            exit(EXIT_FAILURE);
-        }
+    bool wait_for_stop(HANDLE sem, int timeoutMs) {
+        return WaitForSingleObject(sem, timeoutMs < 0 ? 0 : timeoutMs) == WAIT_OBJECT_0;
     }
 
-    bool is_file_empty(HANDLE fileHandle) {
-        LARGE_INTEGER fileSize;
-        if (!GetFileSizeEx(fileHandle, &fileSize)) {
-            perror("GetFileSizeEx (tmp_file)");
-            exit(EXIT_FAILURE);
+    void write_stats_log(HANDLE fileHandle, const std::vector<std::string>& sensorIds, const std::vector<PeriodStats>& stats, time_t periodEnd, bool append) {
+        TimestampCache timestamp;
+        std::string currentTime(timestamp.format(std::chrono::system_clock::from_time_t(periodEnd)), TIMESTAMP_LENGTH);
+        std::string fixed_record;
+        for (size_t i = 0; i < stats.size(); ++i) {
+            make_stats_record(fixed_record, currentTime, sensorIds[i], stats[i]);
+            write_log_to_file(fileHandle, fixed_record.c_str(), fixed_record.size(), append || i > 0);
         }
-        return fileSize.QuadPart == 0;
     }
 
-    DWORD WINAPI hourly_log_thread(void *args) {
+    DWORD WINAPI stats_log_thread(void *args) {
         ThreadData *params = (ThreadData*)args;
-        std::string currentTime;
-        std::string logRecord;
-        time_t logStartTime = time(NULL);
-        bool append_mode = false;
-        while (!need_exit) {
-            time_t current_time = time(NULL);
-            if (current_time >= *params->nextLogTime) {
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->nextLogTime += SEC_IN_HOUR;
-                SemaphorePost(params->threadSemaphore);
-
-                SemaphoreWait(params->threadSemaphore);
-                double avg = *params->averageValue;
-                SemaphorePost(params->threadSemaphore);
-
-                currentTime = get_current_time();
-                logRecord = currentTime + " " + std::to_string(avg);
-
-                std::string fixed_record;
-                make_fixed_length_record(fixed_record, logRecord);
-
-                if (current_time - logStartTime >= SEC_IN_MONTH) {
-                    append_mode = false;
-                    logStartTime = current_time;
-                } 
-                else append_mode = true;
-
-                write_log_to_file(params->logFile, fixed_record.c_str(), fixed_record.size(), append_mode);
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->averageValue = 0.0;
-                SemaphorePost(params->threadSemaphore);
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->recordCounter = 0;
-                SemaphorePost(params->threadSemaphore);
+        StatsLogState& state = *params->state;
+        std::vector<PeriodStats> stats;
+        std::string savedCheckpoint;
+        int sleeper = loggerClock.register_sleeper();
+        time_t hourlyEnd = params->hourlyStats->period_end();
+        time_t dailyEnd = params->dailyStats->period_end();
+
+        // One wheel drives all emissions, the thread sleeps until the next one is due. Periods resumed from a
+        // checkpoint may have ended before the start
+        TimerWheel timers(std::min({params->startTime, hourlyEnd, dailyEnd}));
+        timers.schedule(hourlyEnd, SEC_IN_HOUR, [&](time_t due, time_t next) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            bool append_mode = true;
+            if (due - state.hourlyLogStartTime >= SEC_IN_MONTH) {
+                append_mode = false;
+                state.hourlyLogStartTime = due;
             }
-            Sleep(PORT_SPEED_MS);
+            params->hourlyStats->rollover(stats, next);
+            write_stats_log(params->hourlyLogFile, *params->sensorIds, stats, due, append_mode);
+            state.hourlyLogOffset = file_position(params->hourlyLogFile);
+        });
+        timers.schedule(dailyEnd, SEC_IN_DAY, [&](time_t due, time_t next) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            struct tm local_time;
+            if (localtime_s(&local_time, &due) != 0) {
+                throw std::runtime_error("Failed to get local time.");
+            }
+            int currentYear = local_time.tm_year + 1900;
+            if (state.dailyLogYear != -1 && currentYear != state.dailyLogYear) {
+                CloseHandle(params->dailyLogFile);
+                std::wstring logFileDay_path = to_wstring(LOG_FILE_NAME_DAY);
+                params->dailyLogFile = CreateFileW(logFileDay_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+                if (params->dailyLogFile == INVALID_HANDLE_VALUE) {
+                    perror("Error reopening log_file_day");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            state.dailyLogYear = currentYear;
+            params->dailyStats->rollover(stats, next);
+            write_stats_log(params->dailyLogFile, *params->sensorIds, stats, due, true);
+            state.dailyLogOffset = file_position(params->dailyLogFile);
+        });
+        // Live only: the trailing windows are about now, and a replay is not resumed
+        if (!loggerClock.is_replay()) {
+            timers.schedule(params->startTime + WINDOW_LOG_PERIOD_SEC, WINDOW_LOG_PERIOD_SEC, [&](time_t, time_t) {
+                if (!write_window_log(*params->sensorIds, *params->windowStats, loggerClock.now_sec()))
+                    perror("write (log_file_window)");
+            });
+            timers.schedule(params->startTime + CHECKPOINT_PERIOD_SEC, CHECKPOINT_PERIOD_SEC, [&](time_t, time_t) {
+                if (!save_checkpoint(state, savedCheckpoint))
+                    perror("write (checkpoint)");
+            });
         }
-        return 0;
-    }
 
-    DWORD WINAPI daily_log_thread(void *args) {
-        ThreadData *params = (ThreadData*)args;
-        std::string currentTime;
-        std::string logRecord;
-        int logYear;
-        bool firstOpened = true;
         while (!need_exit) {
-            time_t current_time = time(NULL);
-            if (current_time >= *params->nextLogTime) {
-
-                struct tm local_time;
-                std::tm* time_ptr = localtime(&current_time);
-                if (time_ptr) {
-                    local_time = *time_ptr;
-                }
-                else throw std::runtime_error("Failed to get local time.");
-                int currentYear = local_time.tm_year + 1900;
-
-                if (firstOpened) {
-                    logYear = currentYear;
-                }
-                else if (currentYear != logYear) {
-                    CloseHandle(params->logFile);
-                    std::wstring logFileDay_path = to_wstring(LOG_FILE_NAME_DAY);
-                    params->logFile = CreateFileW(logFileDay_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-
-                    if (params->logFile == INVALID_HANDLE_VALUE) {
-                        perror("Error reopening log_file_day");
-                        exit(EXIT_FAILURE);
-                    }
-
-                    CloseHandle(params->logFile);
-                    params->logFile = CreateFileW(logFileDay_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-                    if (params->logFile == INVALID_HANDLE_VALUE) {
-                        perror("Error reopening log_file_day");
-                        exit(EXIT_FAILURE);
-                    }
-                    logYear = currentYear;
-                }
-                firstOpened = false;
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->nextLogTime += SEC_IN_DAY;
-                SemaphorePost(params->threadSemaphore);
-
-                SemaphoreWait(params->threadSemaphore);
-                double avg = *params->averageValue;
-                SemaphorePost(params->threadSemaphore);
-
-                currentTime = get_current_time();
-                logRecord = currentTime + " " + std::to_string(avg);
-
-                std::string fixed_record;
-                make_fixed_length_record(fixed_record, logRecord);
-
-                write_log_to_file(params->logFile, fixed_record.c_str(), fixed_record.size(), true);
-
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->averageValue = 0.0;
-                SemaphorePost(params->threadSemaphore);
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->recordCounter = 0;
-                SemaphorePost(params->threadSemaphore);
-            }
-            Sleep(PORT_SPEED_MS);
+            time_t current_time = loggerClock.now_sec();
+            timers.advance(current_time);
+            // Until the exact second a timer is due; a replay sleeps in the replayed time, see LoggerClock
+            bool stop = loggerClock.is_replay() ? loggerClock.sleep_until(sleeper, timers.next_due())
+                                                : wait_for_stop(params->stopSemaphore, static_cast<int>(std::max<std::int64_t>(0, timers.next_due() * 1000 - loggerClock.now_ms())));
+            if (stop)
+                break;
         }
         return 0;
     }
@@ -551,23 +1177,6 @@ void make_fixed_length_record(std::string& fixed_record, const std::string& reco
             need_exit = 1;
     }
 
-    std::string get_current_time() {
-        std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
-        std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-        std::tm* tmp = std::localtime(&now_c);
-
-        if (tmp == nullptr) {
-            perror("localtime");
-            exit(EXIT_FAILURE);
-        }
-
-        std::ostringstream oss;
-        oss << std::put_time(tmp, "%Y-%m-%d %H:%M:%S");
-        long ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
-        oss << "." << std::setfill('0') << std::setw(3) << ms;
-        return oss.str();
-    }
-
     void write_log_to_file(std::ofstream& file, const std::string& record, bool append) {
         if (!append) // < 24
             file.seekp(0, std::ios::beg);
@@ -576,126 +1185,101 @@ void make_fixed_length_record(std::string& fixed_record, const std::string& reco
     }
 
 
-    void free_resources(std::fstream* lastRecordFile, std::ofstream* logFile, std::ofstream* hourlyLogFile, std::ofstream* dailyLogFile, int* fd) {
-        if (lastRecordFile != nullptr) { lastRecordFile->close(); delete lastRecordFile; }
-        if (logFile != nullptr) { logFile->close(); delete logFile; }
+    void free_resources(std::ofstream* hourlyLogFile, std::ofstream* dailyLogFile, std::vector<Sensor>* sensors) {
         if (hourlyLogFile != nullptr) { hourlyLogFile->close(); delete hourlyLogFile; }
         if (dailyLogFile != nullptr) { dailyLogFile->close(); delete dailyLogFile; }
-        if (fd != nullptr) { close_port(*fd); *fd = -1; }
-        sem_unlink(SEMAPHORE_OBJECT_NAME);
+        if (sensors != nullptr) { for (Sensor& sensor : *sensors) sensor.port.close(); }
     }
 
-    bool is_file_empty(std::fstream& file) {
-        file.seekg(0, std::ios::end);
-        long size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        return size == 0;
+    bool wait_for_stop(sem_t *sem, int timeoutMs) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        if (timeoutMs > 0) {
+            deadline.tv_sec += timeoutMs / 1000;
+            deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+        }
+        while (sem_timedwait(sem, &deadline) == -1) {
+            if (errno != EINTR)
+                return false;   // ETIMEDOUT
+        }
+        return true;
     }
 
-    void* hourly_log_thread(void *args) {
-        ThreadData *params = (ThreadData*)args;
-        std::string currentTime;
-        std::string logRecord;
-        time_t logStartTime = time(NULL);
-        bool append_mode = false;
-        while (!need_exit) {
-            time_t current_time = time(NULL);
-            if (current_time >= *params->nextLogTime) {
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->nextLogTime += SEC_IN_HOUR;
-                SemaphorePost(params->threadSemaphore);
-
-                SemaphoreWait(params->threadSemaphore);
-                double avg = *params->averageValue;
-                SemaphorePost(params->threadSemaphore);
-
-                currentTime = get_current_time();
-                logRecord = currentTime + " " + std::to_string(avg);
-
-                std::string fixed_record;
-                make_fixed_length_record(fixed_record, logRecord);
-
-                if (current_time - logStartTime >= SEC_IN_MONTH) {
-                    append_mode = false;
-                    logStartTime = current_time;
-                } 
-                else append_mode = true;
-
-                write_log_to_file(*params->logFile, fixed_record, append_mode);
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->averageValue = 0.0;
-                SemaphorePost(params->threadSemaphore);
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->recordCounter = 0;
-                SemaphorePost(params->threadSemaphore);
-            }
-            usleep(1000 * PORT_SPEED_MS);
+    void write_stats_log(std::ofstream& file, const std::vector<std::string>& sensorIds, const std::vector<PeriodStats>& stats, time_t periodEnd, bool append) {
+        TimestampCache timestamp;
+        std::string currentTime(timestamp.format(std::chrono::system_clock::from_time_t(periodEnd)), TIMESTAMP_LENGTH);
+        std::string fixed_record;
+        for (size_t i = 0; i < stats.size(); ++i) {
+            make_stats_record(fixed_record, currentTime, sensorIds[i], stats[i]);
+            write_log_to_file(file, fixed_record, append || i > 0);
         }
-        return 0;
     }
 
-    void* daily_log_thread(void *args) {
+    void* stats_log_thread(void *args) {
         ThreadData *params = (ThreadData*)args;
-        std::string currentTime;
-        std::string logRecord;
-        int logYear;
-        bool firstOpened = true;
-        while (!need_exit) {
-            time_t current_time = time(NULL);
-            if (current_time >= *params->nextLogTime) {
-
-                std::tm* local_time = std::localtime(&current_time);
-                int currentYear = local_time->tm_year + 1900;
-
-                if (firstOpened) {
-                    logYear = currentYear;
-                }
-                else if (currentYear != logYear) {
-                    params->logFile->close();
-                    params->logFile->open(LOG_FILE_NAME_DAY, std::ios::trunc | std::ios::out);
-                    if (!params->logFile->is_open()) {
-                        perror("Error reopening log_file_day (w)");
-                        exit(EXIT_FAILURE);
-                    }
-                     params->logFile->close();
-                    params->logFile->open(LOG_FILE_NAME_DAY, std::ios::out);
-                    if (!params->logFile->is_open()) {
-                        perror("Error reopening log_file_day (a+)");
-                        exit(EXIT_FAILURE);
-                    }
-                    logYear = currentYear;
+        StatsLogState& state = *params->state;
+        std::vector<PeriodStats> stats;
+        std::string savedCheckpoint;
+        int sleeper = loggerClock.register_sleeper();
+        time_t hourlyEnd = params->hourlyStats->period_end();
+        time_t dailyEnd = params->dailyStats->period_end();
+
+        // One wheel drives all emissions, the thread sleeps until the next one is due. Periods resumed from a
+        // checkpoint may have ended before the start
+        TimerWheel timers(std::min({params->startTime, hourlyEnd, dailyEnd}));
+        timers.schedule(hourlyEnd, SEC_IN_HOUR, [&](time_t due, time_t next) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            bool append_mode = true;
+            if (due - state.hourlyLogStartTime >= SEC_IN_MONTH) {
+                append_mode = false;
+                state.hourlyLogStartTime = due;
+            }
+            params->hourlyStats->rollover(stats, next);
+            write_stats_log(*params->hourlyLogFile, *params->sensorIds, stats, due, append_mode);
+            state.hourlyLogOffset = static_cast<std::uint64_t>(params->hourlyLogFile->tellp());
+        });
+        timers.schedule(dailyEnd, SEC_IN_DAY, [&](time_t due, time_t next) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            struct tm local_time;
+            localtime_r(&due, &local_time);
+            int currentYear = local_time.tm_year + 1900;
+            if (state.dailyLogYear != -1 && currentYear != state.dailyLogYear) {
+                params->dailyLogFile->close();
+                params->dailyLogFile->open(LOG_FILE_NAME_DAY, std::ios::trunc | std::ios::out);
+                if (!params->dailyLogFile->is_open()) {
+                    perror("Error reopening log_file_day (w)");
+                    exit(EXIT_FAILURE);
                 }
-                firstOpened = false;
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->nextLogTime += SEC_IN_DAY;
-                SemaphorePost(params->threadSemaphore);
-
-                SemaphoreWait(params->threadSemaphore);
-                double avg = *params->averageValue;
-                SemaphorePost(params->threadSemaphore);
-
-                currentTime = get_current_time();
-                logRecord = currentTime + " " + std::to_string(avg);
-
-                std::string fixed_record;
-                make_fixed_length_record(fixed_record, logRecord);
-
-                write_log_to_file(*params->logFile, fixed_record, true);
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->averageValue = 0.0;
-                SemaphorePost(params->threadSemaphore);
-
-                SemaphoreWait(params->threadSemaphore);
-                *params->recordCounter = 0;
-                SemaphorePost(params->threadSemaphore);
             }
-            usleep(1000 * PORT_SPEED_MS);
+            state.dailyLogYear = currentYear;
+            params->dailyStats->rollover(stats, next);
+            write_stats_log(*params->dailyLogFile, *params->sensorIds, stats, due, true);
+            state.dailyLogOffset = static_cast<std::uint64_t>(params->dailyLogFile->tellp());
+        });
+        // Live only: the trailing windows are about now, and a replay is not resumed
+        if (!loggerClock.is_replay()) {
+            timers.schedule(params->startTime + WINDOW_LOG_PERIOD_SEC, WINDOW_LOG_PERIOD_SEC, [&](time_t, time_t) {
+                if (!write_window_log(*params->sensorIds, *params->windowStats, loggerClock.now_sec()))
+                    perror("write (log_file_window)");
+            });
+            timers.schedule(params->startTime + CHECKPOINT_PERIOD_SEC, CHECKPOINT_PERIOD_SEC, [&](time_t, time_t) {
+                if (!save_checkpoint(state, savedCheckpoint))
+                    perror("write (checkpoint)");
+            });
+        }
 
+        while (!need_exit) {
+            time_t current_time = loggerClock.now_sec();
+            timers.advance(current_time);
+            // Until the exact second a timer is due; a replay sleeps in the replayed time, see LoggerClock
+            bool stop = loggerClock.is_replay() ? loggerClock.sleep_until(sleeper, timers.next_due())
+                                                : wait_for_stop(params->stopSemaphore, static_cast<int>(std::max<std::int64_t>(0, timers.next_due() * 1000 - loggerClock.now_ms())));
+            if (stop)
+                break;
         }
         return 0;
     }
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <pthread.h>
+#    include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#    include <emmintrin.h>
+#endif
+
+// Helpers of the ingest pipeline stages (reader, decoder, aggregator, writer), each a thread that owns its state
+// and talks to its neighbours through SpscRing queues only.
+
+#define PIPELINE_STAGES 4
+#define PIPELINE_SPIN_LIMIT 64        // Idle polls spent spinning before yielding
+#define PIPELINE_YIELD_LIMIT 256      // Idle polls before an empty input queue parks the stage
+#define PIPELINE_IDLE_SLEEP_US 50     // Sleep between polls of a full output queue
+#define PIPELINE_IDLE_WAIT_MS 1000    // Longest park of an idle stage: ring log expiry is checked at least this often
+
+static const char* const PIPELINE_STAGE_NAMES[PIPELINE_STAGES] = {"reader", "decoder", "aggregator", "writer"};
+
+// Counters of one stage, written by the stage's own thread and read by anyone
+struct StageCounters {
+    std::atomic<std::uint64_t> items{0};       // Chunks read, samples decoded, aggregated, written
+    std::atomic<std::uint64_t> fullWaits{0};   // Times the stage waited for room in its output queue
+    std::atomic<std::uint64_t> maxInput{0};    // Highest occupancy of its input queue seen
+    std::atomic<bool> finished{false};         // The stage has drained its input and stopped
+
+    void add(std::uint64_t count) { items.store(items.load(std::memory_order_relaxed) + count, std::memory_order_relaxed); }
+
+    void waited() { fullWaits.store(fullWaits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    void input_occupancy(size_t occupancy) {
+        if (occupancy > maxInput.load(std::memory_order_relaxed)) maxInput.store(occupancy, std::memory_order_relaxed);
+    }
+};
+
+// Polling of a queue: spin briefly, then yield, then sleep, so a waiting stage does not hold a core. A stage idle on
+// an empty input queue parks in SpscRing::wait_readable() instead of sleeping once idle() says so
+class IdleBackoff {
+public:
+    void wait() {
+        if (polls < PIPELINE_SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+            _mm_pause();
+#endif
+        }
+        else if (polls < PIPELINE_YIELD_LIMIT) {
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::microseconds(PIPELINE_IDLE_SLEEP_US));
+        }
+        ++polls;
+    }
+
+    void reset() { polls = 0; }
+
+    // Done spinning and yielding
+    bool idle() const { return polls >= PIPELINE_YIELD_LIMIT; }
+
+private:
+    unsigned int polls = 0;
+};
+
+// Park of an idle stage whose next timer is due in dueMs: at least 1 ms, at most PIPELINE_IDLE_WAIT_MS
+inline std::chrono::milliseconds idle_wait(std::int64_t dueMs) {
+    return std::chrono::milliseconds(dueMs < 1 ? 1 : dueMs > PIPELINE_IDLE_WAIT_MS ? PIPELINE_IDLE_WAIT_MS : dueMs);
+}
+
+// Producer side: wait until the queue has a free slot; the stage never drops, a full queue holds it back
+template <typename Ring>
+auto wait_for_slot(Ring& ring, StageCounters& counters) -> decltype(ring.write_slot()) {
+    auto slot = ring.write_slot();
+    if (slot != nullptr) return slot;
+    counters.waited();
+    IdleBackoff backoff;
+    while ((slot = ring.write_slot()) == nullptr) backoff.wait();
+    return slot;
+}
+
+// Run the calling thread on core only; false if the platform refused
+inline bool pin_current_thread(int core) {
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+// "<reader>,<decoder>,<aggregator>,<writer>": a core number or "-" for each stage, cores receives -1 for "-"
+inline bool parse_stage_cores(const std::string& text, std::vector<int>& cores) {
+    cores.assign(PIPELINE_STAGES, -1);
+    size_t start = 0;
+    for (int stage = 0; stage < PIPELINE_STAGES; ++stage) {
+        size_t end = text.find(',', start);
+        if ((end == std::string::npos) != (stage == PIPELINE_STAGES - 1)) return false;
+        std::string item = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        if (item != "-") {
+            if (item.empty() || item.size() > 4 || item.find_first_not_of("0123456789") != std::string::npos) return false;
+            cores[stage] = std::stoi(item);
+        }
+        start = end + 1;
+    }
+    return true;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#endif
+
+// Circular log file: a header page, the time_t of each slot, then `capacity` fixed-size slots holding text records
+// that start with a "YYYY-MM-DD hh:mm:ss" timestamp. The file is preallocated once and written through a shared
+// mapping. head and tail are absolute record numbers, the slot of record n is n % capacity. Retention goes by the
+// numeric times: the local-time text repeats an hour when daylight saving time ends and is not ordered across it.
+
+#define RING_LOG_MAGIC "RINGLOG1"
+#define RING_LOG_VERSION 2
+#define RING_LOG_HEADER_SIZE 4096
+#define RING_LOG_TIME_PREFIX 19   // "YYYY-MM-DD hh:mm:ss", local time
+
+struct RingLogHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint64_t capacity;                   // Slots
+    std::int64_t retentionSec;                // Records older than this are expired
+    std::atomic<std::uint64_t> head;          // Records ever written, published after the record itself
+    std::atomic<std::uint64_t> tail;          // Oldest retained record
+    std::atomic<std::uint64_t> epoch;         // head / capacity: how many times the ring wrapped
+    std::atomic<std::uint64_t> overwritten;   // Records dropped because the ring filled up before they expired
+};
+
+// Format a time as the RING_LOG_TIME_PREFIX prefix of a record
+inline void ring_log_format_time(char* out, std::time_t time) {
+    std::tm timeInfo;
+#ifdef _WIN32
+    localtime_s(&timeInfo, &time);
+#else
+    localtime_r(&time, &timeInfo);
+#endif
+    char buffer[32];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeInfo);
+    memcpy(out, buffer, RING_LOG_TIME_PREFIX);
+}
+
+class RingLog {
+public:
+    ~RingLog() { close(); }
+
+    // Map an existing ring with the same geometry or create and preallocate a new one
+    bool open(const std::string& path, std::uint32_t recordSize, std::uint64_t capacity, std::int64_t retentionSec) {
+        close();
+        if (recordSize < RING_LOG_TIME_PREFIX || capacity == 0) {
+            return false;
+        }
+        std::uint64_t size = RING_LOG_HEADER_SIZE + (sizeof(std::int64_t) + recordSize) * capacity;
+        if (!map_file(path, size, true)) {
+            return false;
+        }
+        RingLogHeader* header = this->header();
+        if (memcmp(header->magic, RING_LOG_MAGIC, 8) != 0 || header->version != RING_LOG_VERSION ||
+            header->recordSize != recordSize || header->capacity != capacity) {
+            memset(base, 0, RING_LOG_HEADER_SIZE);
+            header->version = RING_LOG_VERSION;
+            header->recordSize = recordSize;
+            header->capacity = capacity;
+            header->head.store(0);
+            header->tail.store(0);
+            header->epoch.store(0);
+            header->overwritten.store(0);
+            memcpy(header->magic, RING_LOG_MAGIC, 8);
+        }
+        header->retentionSec = retentionSec;
+        return true;
+    }
+
+    // Map an existing ring read-only (query tools)
+    bool open_readonly(const std::string& path) {
+        close();
+        if (!map_file(path, 0, false) || mappedSize < RING_LOG_HEADER_SIZE) {
+            close();
+            return false;
+        }
+        const RingLogHeader* header = this->header();
+        if (memcmp(header->magic, RING_LOG_MAGIC, 8) != 0 || header->version != RING_LOG_VERSION ||
+            RING_LOG_HEADER_SIZE + (sizeof(std::int64_t) + header->recordSize) * header->capacity > mappedSize) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool is_open() const { return base != nullptr; }
+
+    // Append one record of exactly recordSize bytes, expiring what fell out of the retention window
+    void append(const char* record, std::time_t now) {
+        RingLogHeader* header = this->header();
+        expire(now);
+        std::uint64_t head = header->head.load(std::memory_order_relaxed);
+        std::uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        if (head - tail == header->capacity) {
+            header->tail.store(tail + 1, std::memory_order_release);
+            header->overwritten.fetch_add(1, std::memory_order_relaxed);
+        }
+        memcpy(slot(head), record, header->recordSize);
+        times()[head % header->capacity] = static_cast<std::int64_t>(now);
+        header->head.store(head + 1, std::memory_order_release);
+        header->epoch.store((head + 1) / header->capacity, std::memory_order_relaxed);
+    }
+
+    // Advance the tail past records older than the retention window
+    void expire(std::time_t now) {
+        RingLogHeader* header = this->header();
+        if (header->retentionSec <= 0) {
+            return;
+        }
+        std::int64_t cutoff = static_cast<std::int64_t>(now) - header->retentionSec;
+        const std::int64_t* times = this->times();
+        std::uint64_t head = header->head.load(std::memory_order_relaxed);
+        std::uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        while (tail < head && times[tail % header->capacity] < cutoff) {
+            ++tail;
+        }
+        header->tail.store(tail, std::memory_order_release);
+    }
+
+    // Ask the OS to start writing dirty pages back
+    void sync() {
+        if (base == nullptr) return;
+#ifdef _WIN32
+        FlushViewOfFile(base, 0);
+#else
+        msync(base, mappedSize, MS_ASYNC);
+#endif
+    }
+
+    void close() {
+        if (base == nullptr) return;
+        sync();
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+        CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        munmap(base, mappedSize);
+        ::close(fd);
+        fd = -1;
+#endif
+        base = nullptr;
+        mappedSize = 0;
+    }
+
+    RingLogHeader* header() const { return reinterpret_cast<RingLogHeader*>(base); }
+
+    // Slot of absolute record number index
+    char* slot(std::uint64_t index) const {
+        const RingLogHeader* header = this->header();
+        return base + RING_LOG_HEADER_SIZE + header->capacity * sizeof(std::int64_t) + (index % header->capacity) * header->recordSize;
+    }
+
+    // Time of the record in each slot, as given to append()
+    std::int64_t* times() const { return reinterpret_cast<std::int64_t*>(base + RING_LOG_HEADER_SIZE); }
+
+private:
+#ifdef _WIN32
+    bool map_file(const std::string& path, std::uint64_t size, bool writable) {
+        file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        if (writable && static_cast<std::uint64_t>(fileSize.QuadPart) != size) {
+            // Preallocate: extend (or shrink) the file once, the geometry check resets the header
+            fileSize.QuadPart = static_cast<LONGLONG>(size);
+            if (!SetFilePointerEx(file, fileSize, NULL, FILE_BEGIN) || !SetEndOfFile(file)) {
+                CloseHandle(file);
+                return false;
+            }
+        }
+        mappedSize = static_cast<std::uint64_t>(fileSize.QuadPart);
+        mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            CloseHandle(file);
+            return false;
+        }
+        base = static_cast<char*>(MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+        if (base == nullptr) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        return true;
+    }
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    bool map_file(const std::string& path, std::uint64_t size, bool writable) {
+        fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0644);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            ::close(fd);
+            return false;
+        }
+        if (writable && static_cast<std::uint64_t>(st.st_size) != size) {
+            // Preallocate the blocks once so appends never extend the file or hit ENOSPC through the mapping
+            if (ftruncate(fd, static_cast<off_t>(size)) == -1 || posix_fallocate(fd, 0, static_cast<off_t>(size)) != 0) {
+                ::close(fd);
+                return false;
+            }
+            st.st_size = static_cast<off_t>(size);
+        }
+        mappedSize = static_cast<std::uint64_t>(st.st_size);
+        void* mapped = mmap(NULL, mappedSize, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        base = static_cast<char*>(mapped);
+        return true;
+    }
+
+    int fd = -1;
+#endif
+    char* base = nullptr;
+    std::uint64_t mappedSize = 0;
+};
@@ -1,14 +1,21 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #ifdef _WIN32
 #    include <windows.h>
 #else
+#    include <cerrno>
 #    include <fcntl.h>
 #    include <termios.h>
 #    include <unistd.h>
+#    include <sys/epoll.h>
+#    include <sys/ioctl.h>
 #endif
 
 constexpr int PORT_SPEED_MS = 1000;
@@ -36,9 +43,9 @@ constexpr int PORT_SPEED_MS = 1000;
         dcb.fRtsControl  = RTS_CONTROL_ENABLE;
         return true;
     }
-    
+
     // Configure serial port parameters
-    bool configure_port(HANDLE hSerial, BaudRate baud_rate) {
+    inline bool configure_port(HANDLE hSerial, BaudRate baud_rate) {
         DCB dcbSerialParameters = {0};
         dcbSerialParameters.DCBlength = sizeof(dcbSerialParameters);
 
@@ -57,15 +64,20 @@ constexpr int PORT_SPEED_MS = 1000;
         return true;
     }
 
+    // Any speed in bits per second: the DCB takes the number itself, the driver refuses what it cannot do
+    inline bool configure_port(HANDLE hSerial, unsigned int bits_per_second) {
+        return configure_port(hSerial, static_cast<BaudRate>(bits_per_second));
+    }
+
     // Close the port file descriptor
-    void close_port(HANDLE hSerial) {
+    inline void close_port(HANDLE hSerial) {
         if (hSerial != INVALID_HANDLE_VALUE) {
             CloseHandle(hSerial);
         }
     }
 
     // Open and configure the serial port
-    HANDLE open_and_configure_port(const char* port_name, BaudRate baud_rate) {
+    inline HANDLE open_and_configure_port(const char* port_name, BaudRate baud_rate) {
         HANDLE hSerial = CreateFileA(port_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
         if (hSerial == INVALID_HANDLE_VALUE) {
             throw std::runtime_error("CreateFile (hSerial) failed.");
@@ -77,6 +89,121 @@ constexpr int PORT_SPEED_MS = 1000;
         return hSerial;
     }
 
+    inline HANDLE open_and_configure_port(const char* port_name, unsigned int bits_per_second) {
+        return open_and_configure_port(port_name, static_cast<BaudRate>(bits_per_second));
+    }
+
+    // Serial port owning its handle. read_some() returns as soon as data arrives (or on timeout)
+    class SerialPort {
+    public:
+        SerialPort() = default;
+
+        SerialPort(const std::string& port_name, BaudRate baud_rate) {
+            hSerial = open_and_configure_port(port_name.c_str(), baud_rate);
+        }
+
+        SerialPort(const std::string& port_name, unsigned int bits_per_second) {
+            hSerial = open_and_configure_port(port_name.c_str(), bits_per_second);
+        }
+
+        ~SerialPort() { close(); }
+
+        SerialPort(const SerialPort&) = delete;
+        SerialPort& operator=(const SerialPort&) = delete;
+
+        SerialPort(SerialPort&& other) noexcept : hSerial(other.hSerial), timeoutMs(other.timeoutMs) {
+            other.hSerial = INVALID_HANDLE_VALUE;
+        }
+
+        SerialPort& operator=(SerialPort&& other) noexcept {
+            if (this != &other) {
+                close();
+                hSerial = other.hSerial;
+                timeoutMs = other.timeoutMs;
+                other.hSerial = INVALID_HANDLE_VALUE;
+            }
+            return *this;
+        }
+
+        bool is_open() const { return hSerial != INVALID_HANDLE_VALUE; }
+        HANDLE handle() const { return hSerial; }
+
+        // Wait up to timeout_ms for data and read what is available: > 0 - bytes read, 0 - timeout, -1 - error
+        int read_some(char* buffer, size_t size, int timeout_ms) {
+            if (timeout_ms != timeoutMs) {
+                // MAXDWORD/MAXDWORD/constant: return immediately when a byte arrives, give up after the constant.
+                // MAXDWORD/0/0: return whatever is already buffered without waiting.
+                COMMTIMEOUTS timeouts = { MAXDWORD, timeout_ms > 0 ? MAXDWORD : 0, static_cast<DWORD>(timeout_ms), 0, 0 };
+                if (!SetCommTimeouts(hSerial, &timeouts)) {
+                    return -1;
+                }
+                timeoutMs = timeout_ms;
+            }
+            DWORD bytesRead = 0;
+            if (!ReadFile(hSerial, buffer, static_cast<DWORD>(size), &bytesRead, NULL)) {
+                return -1;
+            }
+            return static_cast<int>(bytesRead);
+        }
+
+        // Write the whole buffer
+        bool write_all(const char* data, size_t size) {
+            DWORD bytesWritten = 0;
+            return WriteFile(hSerial, data, static_cast<DWORD>(size), &bytesWritten, NULL) && bytesWritten == size;
+        }
+
+        // Drop unread input
+        bool flush_input() { return PurgeComm(hSerial, PURGE_RXCLEAR) != 0; }
+
+        void close() {
+            close_port(hSerial);
+            hSerial = INVALID_HANDLE_VALUE;
+        }
+
+    private:
+        HANDLE hSerial = INVALID_HANDLE_VALUE;
+        int timeoutMs = -1;
+    };
+
+    // Waits for input on several serial ports. Windows has no readiness API for comm handles
+    // without overlapped I/O, so the input queues are checked every millisecond.
+    class SerialPortPoller {
+    public:
+        // Watch port, wait() reports it by index
+        void add(const SerialPort& port, size_t index) {
+            ports.push_back({ port.handle(), index });
+        }
+
+        // Wait up to timeout_ms for input, ready receives the indices of readable ports; returns their number or -1
+        int wait(int timeout_ms, std::vector<size_t>& ready) {
+            ready.clear();
+            ULONGLONG start = GetTickCount64();
+            while (true) {
+                for (const WatchedPort& port : ports) {
+                    COMSTAT status;
+                    DWORD errors;
+                    if (!ClearCommError(port.handle, &errors, &status)) {
+                        return -1;
+                    }
+                    if (status.cbInQue > 0) {
+                        ready.push_back(port.index);
+                    }
+                }
+                if (!ready.empty() || GetTickCount64() - start >= static_cast<ULONGLONG>(timeout_ms)) {
+                    return static_cast<int>(ready.size());
+                }
+                Sleep(1);
+            }
+        }
+
+    private:
+        struct WatchedPort {
+            HANDLE handle;
+            size_t index;
+        };
+        std::vector<WatchedPort> ports;
+    };
+
 #else
     // Port speeds
     enum class BaudRate {
@@ -88,8 +215,10 @@ constexpr int PORT_SPEED_MS = 1000;
         BAUDRATE_115200 = B115200
     };
 
-    // Configure the DCB structure
-    inline void configure_termios(termios& options, speed_t baud_rate) {
+    // Configure the termios structure: raw 8N1, no flow control.
+    // VMIN/VTIME only matter for blocking reads: the default (1, 0) returns as soon as one byte is available.
+    inline void configure_termios(termios& options, speed_t baud_rate, cc_t vmin = 1, cc_t vtime = 0) {
+        cfmakeraw(&options);
         cfsetispeed(&options, baud_rate);
         cfsetospeed(&options, baud_rate);
 
@@ -99,45 +228,367 @@ constexpr int PORT_SPEED_MS = 1000;
         options.c_cflag &= ~PARENB;
         options.c_cflag &= ~CSTOPB;
         options.c_cflag &= ~CRTSCTS;
+        options.c_cc[VMIN] = vmin;
+        options.c_cc[VTIME] = vtime;
     }
 
-    // Configure serial port parameters
-    void configure_port(const std::string& port, BaudRate baud_rate) {
-        int fd = open(port.c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
-        if (fd == -1) {
-            throw std::runtime_error("Error: Unable to open port " + port);
-        }
-
+    // Configure serial port parameters on an already opened descriptor
+    inline void configure_port(int fd, BaudRate baud_rate, cc_t vmin = 1, cc_t vtime = 0) {
         struct termios options;
         if (tcgetattr(fd, &options) < 0) {
-            close(fd);
-            throw std::runtime_error("Error: tcgetattr failed for port " + port);
+            throw std::runtime_error("Error: tcgetattr failed.");
         }
 
-        configure_termios(options, static_cast<speed_t>(baud_rate));
+        configure_termios(options, static_cast<speed_t>(baud_rate), vmin, vtime);
 
         if (tcsetattr(fd, TCSANOW, &options) < 0) {
-            close(fd);
-            throw std::runtime_error("Error: tcsetattr failed for port " + port);
+            throw std::runtime_error("Error: tcsetattr failed.");
+        }
+    }
+
+    // Speed code of a standard speed given in bits per second
+    inline bool standard_speed(unsigned int bits_per_second, speed_t& speed) {
+        switch (bits_per_second) {
+            case 4800: speed = B4800; return true;
+            case 9600: speed = B9600; return true;
+            case 19200: speed = B19200; return true;
+            case 38400: speed = B38400; return true;
+            case 57600: speed = B57600; return true;
+            case 115200: speed = B115200; return true;
+#ifdef B230400
+            case 230400: speed = B230400; return true;
+#endif
+#ifdef B460800
+            case 460800: speed = B460800; return true;
+#endif
+#ifdef B921600
+            case 921600: speed = B921600; return true;
+#endif
+#ifdef B1000000
+            case 1000000: speed = B1000000; return true;
+#endif
+#ifdef B2000000
+            case 2000000: speed = B2000000; return true;
+#endif
+#ifdef B3000000
+            case 3000000: speed = B3000000; return true;
+#endif
+#ifdef B4000000
+            case 4000000: speed = B4000000; return true;
+#endif
+        }
+        return false;
+    }
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || defined(__arm__) || defined(__riscv))
+    // The kernel's struct termios2 (asm-generic layout), whose header cannot be included together with <termios.h>
+    struct KernelTermios2 {
+        tcflag_t c_iflag;
+        tcflag_t c_oflag;
+        tcflag_t c_cflag;
+        tcflag_t c_lflag;
+        cc_t c_line;
+        cc_t c_cc[19];
+        speed_t c_ispeed;
+        speed_t c_ospeed;
+    };
+    #define SERIAL_TCGETS2 _IOR('T', 0x2A, KernelTermios2)
+    #define SERIAL_TCSETS2 _IOW('T', 0x2B, KernelTermios2)
+    #define SERIAL_BOTHER 0x00001000
+    #define SERIAL_IBSHIFT 16
+#endif
+
+    // A speed without a code: termios2 with BOTHER, the driver programs the closest divisor it has (Linux)
+    inline void set_custom_speed(int fd, unsigned int bits_per_second) {
+#ifdef SERIAL_TCGETS2
+        KernelTermios2 options;
+        if (ioctl(fd, SERIAL_TCGETS2, &options) < 0) {
+            throw std::runtime_error("Error: TCGETS2 failed.");
+        }
+        options.c_cflag &= ~(CBAUD | (CBAUD << SERIAL_IBSHIFT));
+        options.c_cflag |= SERIAL_BOTHER | (SERIAL_BOTHER << SERIAL_IBSHIFT);
+        options.c_ispeed = bits_per_second;
+        options.c_ospeed = bits_per_second;
+        if (ioctl(fd, SERIAL_TCSETS2, &options) < 0) {
+            throw std::runtime_error("Error: TCSETS2 failed, speed " + std::to_string(bits_per_second) + " not supported.");
         }
+#else
+        (void)fd;
+        throw std::runtime_error("Error: speed " + std::to_string(bits_per_second) + " needs termios2 (Linux).");
+#endif
+    }
 
-        close(fd);
+    // Configure serial port parameters at any speed in bits per second
+    inline void configure_port(int fd, unsigned int bits_per_second, cc_t vmin = 1, cc_t vtime = 0) {
+        speed_t speed = B115200;
+        bool standard = standard_speed(bits_per_second, speed);
+        configure_port(fd, static_cast<BaudRate>(speed), vmin, vtime);
+        if (!standard) {
+            set_custom_speed(fd, bits_per_second);
+        }
     }
 
     // Close the port file descriptor
-    void close_port(int fd) {
+    inline void close_port(int fd) {
         if (fd != -1) {
             close(fd);
         }
     }
 
-    // Open and configure the serial port
-    int open_and_configure_port(const char* port_name, BaudRate baud_rate) {
-        int fd = open(port_name, O_RDWR | O_NOCTTY | O_NDELAY);
+    // Open and configure the serial port (blocking descriptor)
+    inline int open_and_configure_port(const char* port_name, BaudRate baud_rate) {
+        int fd = open(port_name, O_RDWR | O_NOCTTY | O_CLOEXEC);
         if (fd == -1) {
             throw std::runtime_error("open port failed.");
         }
-        configure_port(port_name, baud_rate);
+        try {
+            configure_port(fd, baud_rate);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        return fd;
+    }
+
+    inline int open_and_configure_port(const char* port_name, unsigned int bits_per_second) {
+        int fd = open(port_name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (fd == -1) {
+            throw std::runtime_error("open port failed.");
+        }
+        try {
+            configure_port(fd, bits_per_second);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
         return fd;
     }
-#endif
\ No newline at end of file
+
+    // Serial port owning a non-blocking descriptor and an epoll instance watching it.
+    // read_some() wakes up as soon as data arrives instead of sleeping a fixed interval.
+    class SerialPort {
+    public:
+        SerialPort() = default;
+
+        SerialPort(const std::string& port_name, BaudRate baud_rate, cc_t vmin = 1, cc_t vtime = 0) {
+            open_port(port_name);
+            try {
+                configure_port(fd, baud_rate, vmin, vtime);
+            } catch (...) {
+                close();
+                throw;
+            }
+            watch_port(port_name);
+        }
+
+        // Any speed in bits per second, see configure_port()
+        SerialPort(const std::string& port_name, unsigned int bits_per_second, cc_t vmin = 1, cc_t vtime = 0) {
+            open_port(port_name);
+            try {
+                configure_port(fd, bits_per_second, vmin, vtime);
+            } catch (...) {
+                close();
+                throw;
+            }
+            watch_port(port_name);
+        }
+
+        ~SerialPort() { close(); }
+
+        SerialPort(const SerialPort&) = delete;
+        SerialPort& operator=(const SerialPort&) = delete;
+
+        SerialPort(SerialPort&& other) noexcept : fd(other.fd), epollFd(other.epollFd) {
+            other.fd = -1;
+            other.epollFd = -1;
+        }
+
+        SerialPort& operator=(SerialPort&& other) noexcept {
+            if (this != &other) {
+                close();
+                fd = other.fd;
+                epollFd = other.epollFd;
+                other.fd = -1;
+                other.epollFd = -1;
+            }
+            return *this;
+        }
+
+        bool is_open() const { return fd != -1; }
+        int handle() const { return fd; }
+
+        // Wait up to timeout_ms for data and read what is available: > 0 - bytes read, 0 - timeout, -1 - error
+        int read_some(char* buffer, size_t size, int timeout_ms) {
+            ssize_t bytesRead = ::read(fd, buffer, size);
+            if (bytesRead > 0) {
+                return static_cast<int>(bytesRead);
+            }
+            if (bytesRead == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EIO) {
+                return -1;
+            }
+            struct epoll_event event;
+            int ready = epoll_wait(epollFd, &event, 1, timeout_ms);
+            if (ready <= 0) {
+                return (ready == -1 && errno != EINTR) ? -1 : 0;
+            }
+            if ((event.events & EPOLLIN) == 0) {
+                // Hang-up without data (e.g. a pty whose writer is not connected yet): wait instead of spinning
+                usleep(static_cast<useconds_t>(timeout_ms) * 1000);
+                return 0;
+            }
+            bytesRead = ::read(fd, buffer, size);
+            if (bytesRead == -1) {
+                return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+            }
+            return static_cast<int>(bytesRead);
+        }
+
+        // Write the whole buffer, waiting while the output queue is full
+        bool write_all(const char* data, size_t size) {
+            while (size > 0) {
+                ssize_t written = ::write(fd, data, size);
+                if (written == -1) {
+                    if (errno == EINTR) continue;
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        tcdrain(fd);
+                        continue;
+                    }
+                    return false;
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        // Drop unread input
+        bool flush_input() { return tcflush(fd, TCIFLUSH) == 0; }
+
+        void close() {
+            if (epollFd != -1) {
+                ::close(epollFd);
+                epollFd = -1;
+            }
+            close_port(fd);
+            fd = -1;
+        }
+
+    private:
+        void open_port(const std::string& port_name) {
+            fd = open(port_name.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+            if (fd == -1) {
+                throw std::runtime_error("Error: Unable to open port " + port_name);
+            }
+        }
+
+        void watch_port(const std::string& port_name) {
+            epollFd = epoll_create1(EPOLL_CLOEXEC);
+            struct epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epollFd == -1 || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+                close();
+                throw std::runtime_error("Error: epoll setup failed for port " + port_name);
+            }
+        }
+
+        int fd = -1;
+        int epollFd = -1;
+    };
+
+    // Waits for input on several serial ports with a single epoll instance
+    class SerialPortPoller {
+    public:
+        SerialPortPoller() {
+            epollFd = epoll_create1(EPOLL_CLOEXEC);
+            if (epollFd == -1) {
+                throw std::runtime_error("Error: epoll_create1 failed.");
+            }
+        }
+
+        ~SerialPortPoller() {
+            if (epollFd != -1) {
+                ::close(epollFd);
+            }
+        }
+
+        SerialPortPoller(const SerialPortPoller&) = delete;
+        SerialPortPoller& operator=(const SerialPortPoller&) = delete;
+
+        // Watch port, wait() reports it by index
+        void add(const SerialPort& port, size_t index) {
+            struct epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u64 = ports.size();
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, port.handle(), &event) == -1) {
+                throw std::runtime_error("Error: epoll_ctl failed.");
+            }
+            ports.push_back({ port.handle(), index, 0 });
+            events.resize(ports.size());
+        }
+
+        // Wait up to timeout_ms for input, ready receives the indices of readable ports; returns their number or -1
+        int wait(int timeout_ms, std::vector<size_t>& ready) {
+            ready.clear();
+            // Never sleep past the moment a parked port is watched again
+            int rearm_ms = rearm_hung_up_ports();
+            if (rearm_ms >= 0 && (timeout_ms < 0 || rearm_ms < timeout_ms)) {
+                timeout_ms = rearm_ms;
+            }
+            int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeout_ms);
+            if (count == -1) {
+                return errno == EINTR ? 0 : -1;
+            }
+            for (int i = 0; i < count; ++i) {
+                WatchedPort& port = ports[events[i].data.u64];
+                if (events[i].events & EPOLLIN) {
+                    ready.push_back(port.index);
+                }
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                    // Hang-up (e.g. a pty whose writer has gone, it stays readable at end of file): stop watching
+                    // it for PORT_SPEED_MS instead of waking up on it in a loop. It has to leave the epoll set,
+                    // EPOLLHUP and EPOLLERR are reported whatever the event mask says
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, port.fd, nullptr);
+                    port.hungUpUntilMs = now_ms() + PORT_SPEED_MS;
+                }
+            }
+            return static_cast<int>(ready.size());
+        }
+
+    private:
+        struct WatchedPort {
+            int fd;
+            size_t index;
+            std::int64_t hungUpUntilMs;  // 0 if the port is being watched
+        };
+
+        static std::int64_t now_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Watch again the parked ports whose time is up; returns the ms until the next one is due, -1 if none is parked
+        int rearm_hung_up_ports() {
+            std::int64_t now = 0;
+            std::int64_t next = -1;
+            for (size_t i = 0; i < ports.size(); ++i) {
+                if (ports[i].hungUpUntilMs == 0) continue;
+                if (now == 0) now = now_ms();
+                if (now < ports[i].hungUpUntilMs) {
+                    if (next == -1 || ports[i].hungUpUntilMs - now < next) next = ports[i].hungUpUntilMs - now;
+                    continue;
+                }
+                struct epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.u64 = i;
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, ports[i].fd, &event);
+                ports[i].hungUpUntilMs = 0;
+            }
+            return static_cast<int>(next);
+        }
+
+        int epollFd = -1;
+        std::vector<WatchedPort> ports;
+        std::vector<struct epoll_event> events;
+    };
+#endif
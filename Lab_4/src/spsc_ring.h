@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Bounded lock-free queue between one producer thread and one consumer thread. Slots are filled and read in place:
+// the producer gets write_slot(), fills it and publish()es it, the consumer gets read_slot() and release()s it when
+// done. The indices of the two sides live on separate cache lines and each side keeps a copy of the other's index,
+// reloaded only when the queue looks full (empty), so the threads touch each other's line once per wraparound.
+// An idle consumer may park in wait_readable(); publish() takes the lock to wake it only while it is parked.
+template <typename T>
+class SpscRing {
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer: the next free slot, nullptr while the queue is full
+    T* write_slot() {
+        std::uint64_t position = head.load(std::memory_order_relaxed);
+        if (position - cachedTail > mask) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (position - cachedTail > mask) return nullptr;
+        }
+        return &slots[position & mask];
+    }
+
+    // Producer: hand the slot from write_slot() to the consumer. head is stored and consumerParked read in the
+    // single total order, against the opposite pair in wait_readable(), so that one of the two sides sees the other
+    void publish() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+        if (consumerParked.load(std::memory_order_seq_cst)) wake_consumer();
+    }
+
+    // Producer: end a wait_readable() of the consumer without publishing, e.g. once there is nothing more to come
+    void wake_consumer() {
+        {
+            std::lock_guard<std::mutex> lock(parkMutex);
+            woken = true;
+        }
+        parked.notify_one();
+    }
+
+    // Consumer: the oldest published slot, nullptr while the queue is empty
+    T* read_slot() {
+        std::uint64_t position = tail.load(std::memory_order_relaxed);
+        if (position == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (position == cachedHead) return nullptr;
+        }
+        return &slots[position & mask];
+    }
+
+    // Consumer: give the slot from read_slot() back to the producer
+    void release() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer: block until a slot is published, wake_consumer() is called or timeout has passed
+    void wait_readable(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(parkMutex);
+        consumerParked.store(true, std::memory_order_seq_cst);
+        parked.wait_for(lock, timeout, [this] {
+            return woken || head.load(std::memory_order_seq_cst) != tail.load(std::memory_order_relaxed);
+        });
+        woken = false;
+        consumerParked.store(false, std::memory_order_relaxed);
+    }
+
+    // Any thread: published and not yet released slots, a snapshot
+    size_t size() const {
+        std::uint64_t last = tail.load(std::memory_order_acquire);
+        return static_cast<size_t>(head.load(std::memory_order_acquire) - last);
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+private:
+    std::vector<T> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<std::uint64_t> head{0};   // Producer: next slot to publish
+    std::uint64_t cachedTail = 0;                      // Producer: tail as last seen
+    alignas(64) std::atomic<std::uint64_t> tail{0};   // Consumer: next slot to read
+    std::uint64_t cachedHead = 0;                      // Consumer: head as last seen
+    alignas(64) std::atomic<bool> consumerParked{false};   // Consumer: in wait_readable(), read by every publish
+    std::mutex parkMutex;
+    std::condition_variable parked;
+    bool woken = false;                                // wake_consumer() called, under parkMutex
+};
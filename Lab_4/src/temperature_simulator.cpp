@@ -1,9 +1,15 @@
 #include <iostream>
 #include <string>
+#include <vector>
 #include <random>
 #include <chrono>
+#include <thread>
 #include <stdexcept>
-#include <sstream>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -12,9 +18,11 @@
     #include <termios.h>
     #include <unistd.h>
     #include <pthread.h>
+    #include <pty.h>
 #endif
 
 #include "serial_port.h"
+#include "frame_decoder.h"
 
 #ifdef _WIN32
     constexpr const char* PORT_WR = "COM1";
@@ -24,11 +32,53 @@
 
 constexpr const int LOW_TEMP = 5, HIGH_TEMP = 25;
 constexpr const double LOW_CHANGE = -0.3, HIGH_CHANGE = 0.3;
+constexpr const int MAX_RATE = 100000;              // Samples per second per channel
+constexpr const int MAX_CHANNELS = 256;
+constexpr const int MIN_SLEEP_US = 1000;            // Samples due within this interval are written in one batch
+constexpr const int MAX_BATCH_SAMPLES = 10000;      // Catch up gradually after a stall instead of bursting
+constexpr const unsigned int DEFAULT_BAUD = 115200;
 
+struct SimulatorOptions { // Command line options
+    double rate = 1000.0 / PORT_SPEED_MS;
+    int channels = 0;                 // 0 - one per port
+    bool seeded = false;
+    std::uint32_t seed = 0;
+    FrameMode framing = FrameMode::DELIMITED;
+    unsigned int baud = DEFAULT_BAUD;  // Any speed, see configure_port()
+    int errors = 0;                   // Frames per 1000 dropped, duplicated or corrupted on the way
+    bool pty = false;
+    std::vector<std::string> ports;
+};
+
+struct Channel { // One simulated sensor and the port it writes to
+#ifdef _WIN32
+    HANDLE port = INVALID_HANDLE_VALUE;
+#else
+    int port = -1;
+    int ptySlave = -1;                // Kept open so the pty survives until a logger connects
+#endif
+    std::string path;
+    std::mt19937 gen;
+    double temp = 0.0;
+    std::uint16_t sequence = 0;       // Next sequenced frame
+    std::string batch;
+};
+
+struct SimulatorData { // Structure for transferring data to the thread
+    const SimulatorOptions* options;
+    std::vector<Channel>* channels;
+};
 
-double init_rand_temp(int min, int max); // Function to generate a random number in the range [min, max]
-double rand_temp_change(double min, double max); // Function to generate a random temperature change in the range [min, max]
-std::string format_temperature(double temp); // Function for formatting a floating-point number to one decimal place
+
+bool parse_options(int argc, char* argv[], SimulatorOptions& options); // Function for parsing the command line
+double init_rand_temp(std::mt19937& gen, int min, int max); // Function to generate a random number in the range [min, max]
+double rand_temp_change(std::mt19937& gen, double min, double max); // Function to generate a random temperature change in the range [min, max]
+void append_sample(std::string& batch, double temp, FrameMode framing, std::uint16_t sequence); // Function for appending one sample formatted to one decimal place and framed to a batch
+void inject_link_error(std::string& batch, size_t frameStart, std::mt19937& gen); // Function for dropping, duplicating or corrupting the last frame of a batch
+bool run_simulation(SimulatorData* data); // Function for generating samples at the configured rate until a write fails
+bool write_batch(Channel& channel); // Function for writing a batch to the channel port (Windows, Linux)
+void open_channels(const SimulatorOptions& options, std::vector<Channel>& channels); // Function for opening ports or creating pty pairs (Windows, Linux)
+void close_channels(std::vector<Channel>& channels); // Function for closing the channel ports (Windows, Linux)
 
 
 #ifdef _WIN32
@@ -38,21 +88,45 @@ std::string format_temperature(double temp); // Function for formatting a floati
 #endif
 
 
-int main() {
-#ifdef _WIN32
-    HANDLE hSerial = INVALID_HANDLE_VALUE;
-#else
-    int fd = -1;
+int main(int argc, char* argv[]) {
+    SimulatorOptions options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--rate <samples/s>] [--channels <n>] [--seed <n>] [--format text|binary|sequenced]"
+                  << " [--baud <bits/s>] [--errors <per mille>] [--pty | --port <device> ...]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Channel> channels;
+    SimulatorData data = {&options, &channels};
+#ifndef _WIN32
     pthread_t thread;
 #endif
 
     try {
-        std::srand(static_cast<unsigned int>(std::time(nullptr)));
+        std::random_device rd;
+        std::uint32_t seed = options.seeded ? options.seed : rd();
+        std::seed_seq seeds{seed};
+        std::vector<std::uint32_t> channelSeeds(options.channels);
+        seeds.generate(channelSeeds.begin(), channelSeeds.end());
 
-#ifdef _WIN32
-        hSerial = open_and_configure_port(PORT_WR, BaudRate::BAUDRATE_115200);
+        channels.resize(options.channels);
+        for (int i = 0; i < options.channels; ++i) {
+            channels[i].gen.seed(channelSeeds[i]);
+            channels[i].temp = init_rand_temp(channels[i].gen, LOW_TEMP, HIGH_TEMP);
+        }
+        open_channels(options, channels);
+        for (int i = 0; i < options.channels; ++i) {
+            std::cout << "channel " << i << ": " << channels[i].path << std::endl;
+        }
+        std::cout << "seed " << seed << ", " << options.rate << " samples/s per channel, "
+                  << (options.framing == FrameMode::DELIMITED ? "text" : options.framing == FrameMode::LENGTH_PREFIXED ? "binary" : "sequenced")
+                  << " framing, " << options.baud << " bit/s";
+        if (options.errors > 0)
+            std::cout << ", " << options.errors << " link errors per 1000 frames";
+        std::cout << std::endl;
 
-        HANDLE hThread = CreateThread(NULL, 0, thread_function, hSerial, 0, NULL);
+#ifdef _WIN32
+        HANDLE hThread = CreateThread(NULL, 0, thread_function, &data, 0, NULL);
 
         if (hThread == NULL) {
             throw std::runtime_error("Failed to create thread.");
@@ -61,9 +135,7 @@ int main() {
         WaitForSingleObject(hThread, INFINITE);
 
 #else
-        fd = open_and_configure_port(PORT_WR, BaudRate::BAUDRATE_115200);
-
-        if (pthread_create(&thread, NULL, thread_function, &fd) != 0) {
+        if (pthread_create(&thread, NULL, thread_function, &data) != 0) {
             throw std::runtime_error("Failed to create thread.");
         }
 
@@ -71,77 +143,235 @@ int main() {
 #endif
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
+        close_channels(channels);
         return EXIT_FAILURE;
     }
 
-#ifdef _WIN32
-    close_port(hSerial);
-#else
-    close_port(fd);
-#endif
-
+    close_channels(channels);
     return 0;
 }
 
 
-double init_rand_temp(int min, int max) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
+bool parse_options(int argc, char* argv[], SimulatorOptions& options) {
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--pty") {
+                options.pty = true;
+            }
+            else if (!hasValue) {
+                return false;
+            }
+            else if (arg == "--rate") {
+                options.rate = std::stod(argv[++i]);
+            }
+            else if (arg == "--channels") {
+                options.channels = std::stoi(argv[++i]);
+            }
+            else if (arg == "--seed") {
+                options.seed = static_cast<std::uint32_t>(std::stoul(argv[++i]));
+                options.seeded = true;
+            }
+            else if (arg == "--format") {
+                std::string format = argv[++i];
+                if (format == "text") options.framing = FrameMode::DELIMITED;
+                else if (format == "binary") options.framing = FrameMode::LENGTH_PREFIXED;
+                else if (format == "sequenced") options.framing = FrameMode::SEQUENCED;
+                else return false;
+            }
+            else if (arg == "--baud") {
+                options.baud = static_cast<unsigned int>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--errors") {
+                options.errors = std::stoi(argv[++i]);
+            }
+            else if (arg == "--port") {
+                options.ports.push_back(argv[++i]);
+            }
+            else return false;
+        }
+    }
+    catch (std::exception const& ex) {
+        return false;
+    }
+
+    if (options.pty && !options.ports.empty())
+        return false;
+    if (!options.pty && options.ports.empty())
+        options.ports.push_back(PORT_WR);
+    if (options.channels == 0)
+        options.channels = options.pty ? 1 : static_cast<int>(options.ports.size());
+    if (!options.pty && options.channels != static_cast<int>(options.ports.size())) {
+        std::cerr << "--channels must match the number of --port devices" << std::endl;
+        return false;
+    }
+    return options.rate > 0 && options.rate <= MAX_RATE && options.channels > 0 && options.channels <= MAX_CHANNELS &&
+           options.baud > 0 && options.errors >= 0 && options.errors <= 1000;
+}
+
+double init_rand_temp(std::mt19937& gen, int min, int max) {
     std::uniform_real_distribution<> distrib(min, max);
     return distrib(gen);
 }
 
-double rand_temp_change(double min, double max) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
+double rand_temp_change(std::mt19937& gen, double min, double max) {
     std::uniform_real_distribution<> distrib(min, max);
     return distrib(gen);
 }
 
-std::string format_temperature(double temp) {
-    std::ostringstream oss;
-    oss.precision(1);
-    oss << std::fixed << temp;
-    return oss.str();
+void append_sample(std::string& batch, double temp, FrameMode framing, std::uint16_t sequence) {
+    char value[32];
+    int size = snprintf(value, sizeof(value), "%.1f", temp);
+    if (framing == FrameMode::DELIMITED) {
+        batch.append(value, size);
+        batch.push_back(FRAME_DELIMITER);
+    }
+    else if (framing == FrameMode::SEQUENCED) {
+        append_sequenced_frame(batch, sequence, value, static_cast<size_t>(size));
+    }
+    else {
+        batch.push_back(static_cast<char>(size & 0xFF));
+        batch.push_back(static_cast<char>((size >> 8) & 0xFF));
+        batch.append(value, size);
+    }
+}
+
+void inject_link_error(std::string& batch, size_t frameStart, std::mt19937& gen) {
+    std::uniform_int_distribution<> kind(0, 2);
+    switch (kind(gen)) {
+        case 0:
+            batch.resize(frameStart);
+            break;
+        case 1:
+            batch.append(batch, frameStart, std::string::npos);
+            break;
+        default: {
+            std::uniform_int_distribution<size_t> position(frameStart, batch.size() - 1);
+            std::uniform_int_distribution<> bit(0, 7);
+            batch[position(gen)] ^= static_cast<char>(1 << bit(gen));
+        }
+    }
+}
+
+bool run_simulation(SimulatorData* data) {
+    const SimulatorOptions& options = *data->options;
+    std::vector<Channel>& channels = *data->channels;
+
+    // Sample k of every channel is due at start + k / rate, samples that are due are sent in one write
+    const double periodNs = 1e9 / options.rate;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::uint64_t sent = 0;
+    std::uniform_int_distribution<> perMille(0, 999);
+    while (true) {
+        double elapsedNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        std::uint64_t due = static_cast<std::uint64_t>(elapsedNs / periodNs) + 1;
+        std::uint64_t count = due > sent ? due - sent : 0;
+        if (count > MAX_BATCH_SAMPLES) count = MAX_BATCH_SAMPLES;
+
+        for (Channel& channel : channels) {
+            channel.batch.clear();
+            for (std::uint64_t i = 0; i < count; ++i) {
+                size_t frameStart = channel.batch.size();
+                append_sample(channel.batch, channel.temp, options.framing, channel.sequence++);
+                if (options.errors > 0 && perMille(channel.gen) < options.errors)
+                    inject_link_error(channel.batch, frameStart, channel.gen);
+                channel.temp += rand_temp_change(channel.gen, LOW_CHANGE, HIGH_CHANGE);
+            }
+            if (!write_batch(channel)) {
+                std::cerr << "write failed (" << channel.path << ")." << std::endl;
+                return false;
+            }
+        }
+        sent += count;
+
+        std::chrono::steady_clock::time_point next = start + std::chrono::nanoseconds(static_cast<std::int64_t>(sent * periodNs));
+        std::chrono::steady_clock::time_point earliest = std::chrono::steady_clock::now() + std::chrono::microseconds(MIN_SLEEP_US);
+        std::this_thread::sleep_until(next > earliest ? next : earliest);
+    }
 }
 
 #ifdef _WIN32
     DWORD WINAPI thread_function(LPVOID param) {
-        HANDLE hSerial = static_cast<HANDLE>(param);
-        double temp = init_rand_temp(LOW_TEMP, HIGH_TEMP);
-        std::string data = format_temperature(temp);
-
-        while (true) {
-            DWORD bytes_written;
-            if (!WriteFile(hSerial, data.c_str(), static_cast<DWORD>(data.size()), &bytes_written, NULL)) {
-                std::cerr << "WriteFile failed." << std::endl;
-                return 1;
-            }
+        return run_simulation(static_cast<SimulatorData*>(param)) ? 0 : 1;
+    }
+
+    bool write_batch(Channel& channel) {
+        DWORD bytes_written;
+        return WriteFile(channel.port, channel.batch.data(), static_cast<DWORD>(channel.batch.size()), &bytes_written, NULL)
+            && bytes_written == channel.batch.size();
+    }
 
-            temp += rand_temp_change(LOW_CHANGE, HIGH_CHANGE);
-            data = format_temperature(temp);
-            Sleep(PORT_SPEED_MS);
+    void open_channels(const SimulatorOptions& options, std::vector<Channel>& channels) {
+        if (options.pty) {
+            throw std::runtime_error("--pty is not supported on Windows, use a virtual COM port pair.");
         }
+        for (size_t i = 0; i < channels.size(); ++i) {
+            channels[i].path = options.ports[i];
+            channels[i].port = open_and_configure_port(options.ports[i].c_str(), options.baud);
+        }
+    }
 
-        return 0;
+    void close_channels(std::vector<Channel>& channels) {
+        for (Channel& channel : channels) {
+            close_port(channel.port);
+            channel.port = INVALID_HANDLE_VALUE;
+        }
     }
 #else
     void* thread_function(void* param) {
-        int fd = *static_cast<int*>(param);
-        double temp = init_rand_temp(LOW_TEMP, HIGH_TEMP);
-        std::string data = format_temperature(temp);
-
-        while (true) {
-            if (write(fd, data.c_str(), data.size()) == -1) {
-                std::cerr << "write failed." << std::endl;
-                return nullptr;
+        run_simulation(static_cast<SimulatorData*>(param));
+        return nullptr;
+    }
+
+    bool write_batch(Channel& channel) {
+        const char* data = channel.batch.data();
+        size_t size = channel.batch.size();
+        while (size > 0) {
+            ssize_t written = write(channel.port, data, size);
+            if (written == -1) {
+                if (errno == EINTR) continue;
+                return false;
             }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
 
-            temp += rand_temp_change(LOW_CHANGE, HIGH_CHANGE);
-            data = format_temperature(temp);
-            usleep(PORT_SPEED_MS * 1000);
+    void open_channels(const SimulatorOptions& options, std::vector<Channel>& channels) {
+        for (size_t i = 0; i < channels.size(); ++i) {
+            Channel& channel = channels[i];
+            if (!options.pty) {
+                channel.path = options.ports[i];
+                channel.port = open_and_configure_port(options.ports[i].c_str(), options.baud);
+                continue;
+            }
+            // Raw from the start: no echo back into the master and no line discipline processing
+            struct termios raw;
+            memset(&raw, 0, sizeof(raw));
+            speed_t speed = B115200;
+            bool standard = standard_speed(options.baud, speed);
+            configure_termios(raw, speed);
+            char slaveName[256];
+            if (openpty(&channel.port, &channel.ptySlave, slaveName, &raw, NULL) == -1) {
+                throw std::runtime_error("openpty failed.");
+            }
+            if (!standard)
+                set_custom_speed(channel.ptySlave, options.baud);
+            fcntl(channel.port, F_SETFD, FD_CLOEXEC);
+            fcntl(channel.ptySlave, F_SETFD, FD_CLOEXEC);
+            channel.path = slaveName;
         }
+    }
 
-        return nullptr;
+    void close_channels(std::vector<Channel>& channels) {
+        for (Channel& channel : channels) {
+            close_port(channel.port);
+            close_port(channel.ptySlave);
+            channel.port = -1;
+            channel.ptySlave = -1;
+        }
     }
-#endif
\ No newline at end of file
+#endif
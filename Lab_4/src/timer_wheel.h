@@ -0,0 +1,70 @@
+#pragma once
+
+#include <ctime>
+#include <functional>
+#include <vector>
+
+#define TIMER_WHEEL_SLOTS 64   // One slot per second, timers further away wait for their round
+
+// Hashed timing wheel with one-second ticks for periodic timers. A timer lives in slot due % TIMER_WHEEL_SLOTS,
+// advance() only visits the slots of the seconds that passed, so the owner can sleep until next_due().
+class TimerWheel {
+public:
+    using Callback = std::function<void(std::time_t due, std::time_t next)>;
+
+    explicit TimerWheel(std::time_t now) : slots(TIMER_WHEEL_SLOTS), current(now) {}
+
+    // Call callback at due and every period seconds after it, telling it when it fires next
+    void schedule(std::time_t due, std::time_t period, Callback callback) {
+        timers.push_back(Timer{due, period, std::move(callback)});
+        slot_of(due).push_back(timers.size() - 1);
+    }
+
+    // Fire the timers due at or before now; a periodic timer that missed several periods fires once
+    void advance(std::time_t now) {
+        std::time_t last = now - current >= TIMER_WHEEL_SLOTS ? current + TIMER_WHEEL_SLOTS - 1 : now;
+        for (; current <= last; ++current) {
+            std::vector<size_t>& slot = slot_of(current);
+            for (size_t i = 0; i < slot.size();) {
+                Timer& timer = timers[slot[i]];
+                if (timer.due > now) {
+                    ++i;   // A later round
+                    continue;
+                }
+                size_t id = slot[i];
+                slot[i] = slot.back();
+                slot.pop_back();
+                std::time_t due = timer.due;
+                while (timer.due <= now) timer.due += timer.period;
+                slot_of(timer.due).push_back(id);
+                timer.callback(due, timer.due);
+            }
+        }
+        current = now + 1;
+    }
+
+    // Earliest due time of all timers; advance() handles any jump, so this may be more than a round away
+    std::time_t next_due() const {
+        if (timers.empty()) return current + TIMER_WHEEL_SLOTS;
+        std::time_t earliest = timers[0].due;
+        for (const Timer& timer : timers) {
+            if (timer.due < earliest) earliest = timer.due;
+        }
+        return earliest;
+    }
+
+private:
+    struct Timer {
+        std::time_t due;
+        std::time_t period;
+        Callback callback;
+    };
+
+    std::vector<size_t>& slot_of(std::time_t time) {
+        return slots[static_cast<size_t>(time % TIMER_WHEEL_SLOTS)];
+    }
+
+    std::vector<Timer> timers;
+    std::vector<std::vector<size_t>> slots;
+    std::time_t current;   // Next second to visit
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <vector>
+
+#define WINDOW_SECOND_BUCKETS 300    // Per-second buckets: trailing windows up to 5 minutes at one-second resolution
+#define WINDOW_MINUTE_BUCKETS 1440   // Per-minute buckets: trailing windows up to 24 hours at one-minute resolution
+
+// Summary of the samples of a trailing window
+struct WindowSummary {
+    std::uint64_t count = 0;
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    double mean() const { return count > 0 ? sum / static_cast<double>(count) : 0.0; }
+    double minimum() const { return count > 0 ? min : 0.0; }
+    double maximum() const { return count > 0 ? max : 0.0; }
+};
+
+// Rings of per-second and per-minute buckets of every sensor. add() is called by the reader thread only and
+// recycles a bucket when its second (minute) comes round again; query() may run on any thread. The fields are
+// single-writer atomics, a bucket recycled while it is being read is left out of the result.
+class WindowStats {
+public:
+    explicit WindowStats(size_t sensors)
+        : seconds(sensors * WINDOW_SECOND_BUCKETS), minutes(sensors * WINDOW_MINUTE_BUCKETS) {}
+
+    void add(size_t sensor, double value, std::time_t now) {
+        std::int64_t second = static_cast<std::int64_t>(now);
+        std::int64_t minute = second / 60;
+        update(seconds[sensor * WINDOW_SECOND_BUCKETS + static_cast<size_t>(second % WINDOW_SECOND_BUCKETS)], second, value);
+        update(minutes[sensor * WINDOW_MINUTE_BUCKETS + static_cast<size_t>(minute % WINDOW_MINUTE_BUCKETS)], minute, value);
+    }
+
+    // Samples of the last windowSec seconds up to now: per-second buckets up to WINDOW_SECOND_BUCKETS seconds,
+    // whole minutes beyond that (the current minute included)
+    WindowSummary query(size_t sensor, std::time_t windowSec, std::time_t now) const {
+        WindowSummary summary;
+        std::int64_t last = static_cast<std::int64_t>(now);
+        if (windowSec <= WINDOW_SECOND_BUCKETS) {
+            collect(&seconds[sensor * WINDOW_SECOND_BUCKETS], WINDOW_SECOND_BUCKETS, last - windowSec + 1, last, summary);
+        }
+        else {
+            std::int64_t minutesInWindow = (windowSec + 59) / 60;
+            if (minutesInWindow > WINDOW_MINUTE_BUCKETS) minutesInWindow = WINDOW_MINUTE_BUCKETS;
+            collect(&minutes[sensor * WINDOW_MINUTE_BUCKETS], WINDOW_MINUTE_BUCKETS, last / 60 - minutesInWindow + 1, last / 60, summary);
+        }
+        return summary;
+    }
+
+    size_t sensors() const { return seconds.size() / WINDOW_SECOND_BUCKETS; }
+
+private:
+    struct Bucket {
+        std::atomic<std::int64_t> key{-1};   // Second or minute the bucket holds
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<double> sum{0.0};
+        std::atomic<double> min{0.0};
+        std::atomic<double> max{0.0};
+    };
+
+    static void update(Bucket& bucket, std::int64_t key, double value) {
+        constexpr std::memory_order relaxed = std::memory_order_relaxed;
+        if (bucket.key.load(relaxed) != key) {
+            bucket.key.store(-1, relaxed);   // Readers skip the bucket until it is consistent again
+            std::atomic_thread_fence(std::memory_order_release);
+            bucket.count.store(1, relaxed);
+            bucket.sum.store(value, relaxed);
+            bucket.min.store(value, relaxed);
+            bucket.max.store(value, relaxed);
+            bucket.key.store(key, std::memory_order_release);
+            return;
+        }
+        bucket.count.store(bucket.count.load(relaxed) + 1, relaxed);
+        bucket.sum.store(bucket.sum.load(relaxed) + value, relaxed);
+        if (value < bucket.min.load(relaxed)) bucket.min.store(value, relaxed);
+        if (value > bucket.max.load(relaxed)) bucket.max.store(value, relaxed);
+    }
+
+    static void collect(const Bucket* ring, std::int64_t size, std::int64_t first, std::int64_t last, WindowSummary& summary) {
+        for (std::int64_t key = first; key <= last; ++key) {
+            const Bucket& bucket = ring[key % size];
+            if (bucket.key.load(std::memory_order_acquire) != key) continue;
+            std::uint64_t count = bucket.count.load(std::memory_order_relaxed);
+            double sum = bucket.sum.load(std::memory_order_relaxed);
+            double min = bucket.min.load(std::memory_order_relaxed);
+            double max = bucket.max.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (bucket.key.load(std::memory_order_relaxed) != key) continue;
+            summary.count += count;
+            summary.sum += sum;
+            if (min < summary.min) summary.min = min;
+            if (max > summary.max) summary.max = max;
+        }
+    }
+
+    std::vector<Bucket> seconds;
+    std::vector<Bucket> minutes;
+};
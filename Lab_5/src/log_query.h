@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#endif
+
+#include "ring_log.h"
+
+// Time-range queries over the fixed-length text logs (log.txt, log_hour.txt, log_day.txt) and log.ring.
+// Every record starts with a "YYYY-MM-DD hh:mm:ss.sss" timestamp, so records are ordered as strings.
+// A text log that was restarted from offset 0 holds the newest records in front of the older ones:
+// it is a sorted sequence rotated once, and its oldest record is found by binary search as well.
+
+#define LOG_QUERY_TIME_LENGTH 23   // "YYYY-MM-DD hh:mm:ss.sss"
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            return false;
+        }
+        if (fileSize.QuadPart == 0) {
+            return true;   // Nothing to map, an empty log
+        }
+        size = static_cast<std::uint64_t>(fileSize.QuadPart);
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            return false;
+        }
+        base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return base != nullptr;
+#else
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            return false;
+        }
+        if (st.st_size == 0) {
+            return true;   // Nothing to map, an empty log
+        }
+        void* mapped = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        size = static_cast<std::uint64_t>(st.st_size);
+        base = static_cast<const char*>(mapped);
+        return true;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (base != nullptr) UnmapViewOfFile(base);
+        if (mapping != NULL) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base != nullptr) munmap(const_cast<char*>(base), static_cast<size_t>(size));
+        if (fd != -1) ::close(fd);
+        fd = -1;
+#endif
+        base = nullptr;
+        size = 0;
+    }
+
+    const char* data() const { return base; }
+    std::uint64_t file_size() const { return size; }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+    const char* base = nullptr;
+    std::uint64_t size = 0;
+};
+
+// Records of one log in time order: record(0) is the oldest one
+class LogQuery {
+public:
+    // Map a text log or a ring log (recognised by its magic)
+    bool open(const std::string& path) {
+        count = 0;
+        isRing = false;
+        if (!file.open(path)) {
+            return false;
+        }
+        if (file.file_size() >= RING_LOG_HEADER_SIZE && memcmp(file.data(), RING_LOG_MAGIC, 8) == 0) {
+            file.close();
+            if (!ring.open_readonly(path)) {
+                return false;
+            }
+            // Snapshot of the live window; records the writer overwrites meanwhile are read as they are
+            const RingLogHeader* header = ring.header();
+            first = header->tail.load(std::memory_order_acquire);
+            count = header->head.load(std::memory_order_acquire) - first;
+            recordLength = header->recordSize;
+            isRing = true;
+            return true;
+        }
+        // Text log: the record length is the position of the first newline, a partial last record is ignored
+        const char* newline = file.file_size() > 0 ? static_cast<const char*>(memchr(file.data(), '\n', static_cast<size_t>(file.file_size()))) : nullptr;
+        if (newline == nullptr) {
+            return file.file_size() == 0;
+        }
+        recordLength = static_cast<std::uint64_t>(newline - file.data()) + 1;
+        if (recordLength <= LOG_QUERY_TIME_LENGTH) {
+            return false;
+        }
+        count = file.file_size() / recordLength;
+        // Oldest record: the first one older than record 0, if the log was restarted from offset 0
+        std::uint64_t low = 1, high = count;
+        while (low < high) {
+            std::uint64_t middle = low + (high - low) / 2;
+            if (memcmp(physical(middle), physical(0), LOG_QUERY_TIME_LENGTH) < 0) high = middle;
+            else low = middle + 1;
+        }
+        first = low < count ? low : 0;
+        return true;
+    }
+
+    std::uint64_t size() const { return count; }
+    std::uint64_t record_length() const { return recordLength; }
+
+    // index-th oldest record, record_length() bytes ending with '\n'
+    const char* record(std::uint64_t index) const {
+        return isRing ? ring.slot(first + index) : physical((first + index) % count);
+    }
+
+    // First record whose timestamp, cut to the key length, is not less than key ("2024-05-01", "2024-05-01 10:15", ...)
+    std::uint64_t lower_bound(const std::string& key) const { return search(key, false); }
+
+    // First record whose timestamp, cut to the key length, is greater than key: an inclusive end of the range
+    std::uint64_t upper_bound(const std::string& key) const { return search(key, true); }
+
+    // Call output(data, size) for the records [begin, end) in as few contiguous chunks as the layout allows
+    template <typename Output>
+    void stream(std::uint64_t begin, std::uint64_t end, Output output) const {
+        // Only the end of the file (or of the ring slots) breaks contiguity
+        std::uint64_t slots = isRing ? ring.header()->capacity : count;
+        while (begin < end) {
+            std::uint64_t position = (first + begin) % slots;
+            std::uint64_t contiguous = slots - position < end - begin ? slots - position : end - begin;
+            output(record(begin), static_cast<size_t>(contiguous * recordLength));
+            begin += contiguous;
+        }
+    }
+
+private:
+    const char* physical(std::uint64_t index) const { return file.data() + index * recordLength; }
+
+    std::uint64_t search(const std::string& key, bool upper) const {
+        size_t length = key.size() < LOG_QUERY_TIME_LENGTH ? key.size() : LOG_QUERY_TIME_LENGTH;
+        std::uint64_t low = 0, high = count;
+        while (low < high) {
+            std::uint64_t middle = low + (high - low) / 2;
+            int order = memcmp(record(middle), key.data(), length);
+            if (order < 0 || (upper && order == 0)) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    }
+
+    MappedFile file;
+    RingLog ring;
+    bool isRing = false;
+    std::uint64_t recordLength = 0;
+    std::uint64_t first = 0;   // Physical index (text) or absolute record number (ring) of the oldest record
+    std::uint64_t count = 0;
+};
+
+// "YYYY-MM-DD hh:mm:ss" of now minus the given number of seconds, a key for lower_bound()
+inline std::string log_query_time_before(std::int64_t seconds) {
+    char buffer[RING_LOG_TIME_PREFIX];
+    ring_log_format_time(buffer, std::time(NULL) - static_cast<std::time_t>(seconds));
+    return std::string(buffer, RING_LOG_TIME_PREFIX);
+}
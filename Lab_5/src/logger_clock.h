@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <vector>
+
+// Time source of the logger. Live it is the system clock. In replay it is the time of the sample being
+// replayed: the reader moves it forward with advance_to(), and the period threads (sleepers) sleep in
+// virtual time with sleep_until(). advance_to() returns only once every sleeper due by then has done its
+// work and gone back to sleep, so a period is closed before the first sample after its end is added,
+// however fast the samples come.
+class LoggerClock {
+public:
+    using time_point = std::chrono::system_clock::time_point;
+
+    time_point now() const {
+        if (!replaying) return std::chrono::system_clock::now();
+        return time_point(std::chrono::milliseconds(replayNowMs.load()));
+    }
+
+    std::time_t now_sec() const { return std::chrono::system_clock::to_time_t(now()); }
+
+    std::int64_t now_ms() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now().time_since_epoch()).count();
+    }
+
+    bool is_replay() const { return replaying; }
+
+    // Before any thread uses the clock: replay from start, sleepers threads will call sleep_until()
+    void start_replay(time_point start, int sleepers) {
+        replaying = true;
+        replayNowMs.store(std::chrono::duration_cast<std::chrono::milliseconds>(start.time_since_epoch()).count());
+        dues.assign(static_cast<size_t>(sleepers), AWAKE);
+        earliestDue.store(sleepers > 0 ? AWAKE : LLONG_MAX);
+    }
+
+    // Each sleeper thread once, before its first sleep_until()
+    int register_sleeper() { return nextSleeper++; }
+
+    // Replay, reader thread: move the time forward to time
+    void advance_to(time_point time) {
+        long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+        if (ms > replayNowMs.load()) replayNowMs.store(ms);
+        long long second = std::chrono::system_clock::to_time_t(time);
+        if (second < earliestDue.load()) return;   // Nobody to wake up
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.notify_all();
+        changed.wait(lock, [&] { return stopped || earliestDue.load() > second; });
+    }
+
+    // Replay, reader thread: true when advance_to(time) would wake a sleeper, samples held back are due first
+    bool wakes_sleeper(time_point time) const {
+        return replaying && static_cast<long long>(std::chrono::system_clock::to_time_t(time)) >= earliestDue.load();
+    }
+
+    // Replay, sleeper thread: sleep until the time reaches due; true when stop() was called
+    bool sleep_until(int sleeper, std::time_t due) {
+        std::unique_lock<std::mutex> lock(mutex);
+        dues[static_cast<size_t>(sleeper)] = due;
+        update_earliest();
+        changed.notify_all();
+        changed.wait(lock, [&] { return stopped || now_sec() >= due; });
+        dues[static_cast<size_t>(sleeper)] = AWAKE;   // Holds the reader until it sleeps again
+        update_earliest();
+        return stopped;
+    }
+
+    // Replay: wake everybody up for good
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        changed.notify_all();
+    }
+
+private:
+    static constexpr long long AWAKE = LLONG_MIN;
+
+    void update_earliest() {
+        long long earliest = LLONG_MAX;
+        for (long long due : dues) {
+            if (due < earliest) earliest = due;
+        }
+        earliestDue.store(earliest);
+    }
+
+    bool replaying = false;
+    std::atomic<long long> replayNowMs{0};
+    std::atomic<long long> earliestDue{LLONG_MAX};   // Earliest due of the sleepers, AWAKE while one is working
+    std::atomic<int> nextSleeper{0};
+    std::vector<long long> dues;
+    bool stopped = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
@@ -6,6 +6,7 @@
 #include <chrono>
 #include <algorithm>
 #include <fstream>
+#include <climits>
 #include <sqlite3.h>
 
 #ifdef _WIN32
@@ -29,6 +30,11 @@
 #endif
 
 #include "serial_port.h"
+#include "frame_decoder.h"
+#include "sample_format.h"
+#include "logger_clock.h"
+#include "replay_source.h"
+#include "signal_filter.h"
 
 #ifdef _WIN32
     #define PORT_RD "COM12"
@@ -52,14 +58,16 @@
 #define DB_NAME "temperature.db"
 #define SERVER_PORT 8080
 #define BUFFER_SIZE 1024
+#define REPLAY_BATCH_ROWS 10000   // Replayed samples inserted per transaction
+#define DEFAULT_BAUD 115200
 
 struct ThreadData {
 #ifdef _WIN32
     sqlite3 *db;
-    HANDLE serialPort;
+    SerialPort *serialPort;
 #else
     sqlite3 *db;
-    int serialPort;
+    SerialPort *serialPort;
 #endif
     time_t *nextLogTime;
     double *averageValue;
@@ -76,33 +84,40 @@ struct ThreadData {
 };
 
 volatile unsigned char need_exit = 0;
+LoggerClock loggerClock; // Time of the records and the periods, the replayed time in replay mode
+std::vector<FilterSpec> filterChain; // Filters between the readings and the averages, none by default
+FrameMode frameMode = FrameMode::DELIMITED; // Framing of PORT_RD, SEQUENCED with --sequenced
+unsigned int portBaud = DEFAULT_BAUD; // Speed of PORT_RD in bits per second, any the driver can do
 
 void make_fixed_length_record(std::string& fixed_record, const std::string& record); // Function for creating a fixed length record (Windows, Linux)
+std::string get_current_time(); // Function for getting the current time in the format YYYY-MM-DD hh:mm:ss.sss (Windows, Linux)
+sqlite3_stmt* prepare_sample_insert(sqlite3* db); // Prepare the insert statement reused for every sample (Windows, Linux)
+void write_sample_to_db(sqlite3_stmt* insert, const char* timestamp, const char* record, size_t size); // Write a temperature record into the database with the prepared statement (Windows, Linux)
 std::string http_response(const std::string& body, int status_code, const std::string& content_type); // Construct an HTTP response with a given body, status code, and content type (Windows, Linux)
 std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const std::string& end_time); // Fetch logs from the database within a specified time range and return them as a JSON-formatted string (Windows, Linux)
 void handle_client(int client_socket, sqlite3* db, std::string& currentTemperatureStr); // Process HTTP requests from a client, serve files or data, and send appropriate responses (Windows, Linux)
 
 #ifdef _WIN32
     BOOL WINAPI sig_handler(DWORD signal); // Ctrl+C signal handler (Windows)
-    std::string get_current_time(); // Function for getting the current time in the format YYYY-MM-DD hh:mm:ss.sss (Windows)
     void write_log_to_db(sqlite3* db, const std::string& record); // Write a temperature record into the database (Windows)
-    void free_resources(HANDLE* lastRecordFile, sqlite3** db, HANDLE* sem, HANDLE* serialPort); // Free allocated resources and close handles (Windows)
+    void free_resources(HANDLE* lastRecordFile, sqlite3** db, HANDLE* sem, SerialPort* serialPort); // Free allocated resources and close handles (Windows)
     void read_last_records(HANDLE fileHandle, int *value1, int *value2); // Read the last two integer records from a file (Windows)
     bool is_file_empty(HANDLE fileHandle); // Function to check if a file is empty (Windows)
     DWORD WINAPI hourly_log_thread(void *args); // Thread function for recording hourly logs (Windows)
     DWORD WINAPI daily_log_thread(void *args); // Thread function for recording daily logs (Linux)
     DWORD WINAPI data_processing_thread(void *args); // Thread function for processing serial port data (Windows)
+    void replay_samples(ThreadData *params, ReplaySource& replay); // Feed the replayed samples through the data processing as fast as possible (Windows)
     DWORD WINAPI web_server_thread(void* args); // Thread function for handling web server operations (Windows)
     std::wstring to_wstring(const std::string& str); // Function to convert ANSI string to Unicode string
 #else
     void sig_handler(int sig); // SIGINT signal handler (Linux)
-    std::string get_current_time(); // Function for getting the current time in the format YYYY-MM-DD hh:mm:ss.sss (Linux)
     void write_log_to_db(sqlite3* db, const std::string& record); // Write a temperature record into the database (Linux)
-    void free_resources(std::fstream* lastRecordFile, sqlite3** db, int* fd); // Free allocated resources and close handles (Linux)
+    void free_resources(std::fstream* lastRecordFile, sqlite3** db, SerialPort* serialPort); // Free allocated resources and close handles (Linux)
     bool is_file_empty(std::fstream& file); // Function to check if a file is empty (Linux)
     void* hourly_log_thread(void *args); // Thread function for recording hourly logs (Linux)
     void* daily_log_thread(void *args); // Thread function for recording daily logs (Linux)
     void* data_processing_thread(void *args); // Thread function for processing serial port data (Linux)
+    void replay_samples(ThreadData *params, ReplaySource& replay); // Feed the replayed samples through the data processing as fast as possible (Linux)
     void* web_server_thread(void* args); // Thread function for handling web server operations (Linux)
 #endif
 
@@ -130,6 +145,40 @@ int main(int argc, char *argv[]) {
     }
 #endif
 
+    // --replay <log>|generate:<days>: recorded or generated samples instead of PORT_RD, in virtual time
+    // --filter <chain>: median, EMA and spike filters before the averages, see signal_filter.h
+    // --sequenced, --baud <bits/s>: temperature_simulator --format sequenced, at any port speed
+    std::string replayPath;
+    bool validArgs = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+        else if (arg == "--filter" && i + 1 < argc) validArgs = parse_filter_chain(argv[++i], filterChain) && validArgs;
+        else if (arg == "--sequenced") frameMode = FrameMode::SEQUENCED;
+        else if (arg == "--baud" && i + 1 < argc) {
+            char* end = nullptr;
+            unsigned long baud = strtoul(argv[++i], &end, 10);
+            validArgs = *end == '\0' && baud > 0 && baud <= UINT_MAX && validArgs;
+            portBaud = static_cast<unsigned int>(baud);
+        }
+        else validArgs = false;
+    }
+    if (!validArgs) {
+        std::cerr << "Usage: " << argv[0] << " [--replay <log>|generate:<days>] [--filter median:<n>|ema:<alpha>|hampel:<n>[:<k>],...]"
+                  << " [--sequenced] [--baud <bits/s>]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    ReplaySource replay;
+    bool replaying = false;
+    if (!replayPath.empty()) {
+        if (!replay.open(replayPath, std::vector<std::string>{"0"})) {
+            std::cerr << "Unable to open replay source " << replayPath << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        replaying = true;
+        loggerClock.start_replay(replay.start_time(), 2);
+    }
+
     // Stores last record position in log_file and log_file_hour
 #ifdef _WIN32
     std::wstring lastRecordFile_path = to_wstring(FILE_LAST_RECORD);
@@ -189,22 +238,29 @@ int main(int argc, char *argv[]) {
     sem_t *semaphore = sem_open(SEMAPHORE_OBJECT_NAME, O_CREAT, 0777, 1);
 #endif
     // Configure port
+    SerialPort serialPort;
 #ifdef _WIN32
-    HANDLE serialPort = open_and_configure_port(PORT_RD, BaudRate::BAUDRATE_115200);
-    if (serialPort == INVALID_HANDLE_VALUE) {
-        perror("CreateFile (pd)");
+    try {
+        if (!replaying)
+            serialPort = SerialPort(PORT_RD, portBaud);
+    }
+    catch (std::exception const& ex) {
+        std::cerr << "CreateFile (pd): " << ex.what() << std::endl;
         exit(EXIT_FAILURE);
     }
 #else
-    int serialPort = open_and_configure_port(PORT_RD, BaudRate::BAUDRATE_115200);
-    if (serialPort == -1) {
-        perror("open port");
-        free_resources(lastRecordFile, &db, &serialPort);
+    try {
+        if (!replaying)
+            serialPort = SerialPort(PORT_RD, portBaud);
+    }
+    catch (std::exception const& ex) {
+        std::cerr << "open port: " << ex.what() << std::endl;
+        free_resources(lastRecordFile, &db, nullptr);
         exit(EXIT_FAILURE);
     }
 
     // Flush port
-    if (tcflush(serialPort, TCIFLUSH) == -1) {
+    if (!replaying && !serialPort.flush_input()) {
         perror("tcflush");
         free_resources(lastRecordFile, &db, &serialPort);
         exit(EXIT_FAILURE);
@@ -216,13 +272,13 @@ int main(int argc, char *argv[]) {
     std::string portData;
 
 
-    time_t startTime = time(NULL);
+    time_t startTime = loggerClock.now_sec();
     time_t nextHourLogTime = startTime + SEC_IN_HOUR;
     time_t nextDayLogTime = startTime + SEC_IN_DAY;
 
     // Create new thread (hour logger)
 #ifdef _WIN32
-    ThreadData params_hour = {db, serialPort, &nextHourLogTime, &hourlyAverageValue, &hourlyRecordCounter, &portData, semaphore};
+    ThreadData params_hour = {db, &serialPort, &nextHourLogTime, &hourlyAverageValue, &hourlyRecordCounter, &portData, semaphore};
     InitializeCriticalSection(&params_hour.dataMutex);
     HANDLE threadHour = CreateThread(NULL, 0, hourly_log_thread, &params_hour, 0, NULL);
     if (threadHour == NULL) {
@@ -230,7 +286,7 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 #else
-    ThreadData params_hour = {db, serialPort, &nextHourLogTime, &hourlyAverageValue, &hourlyRecordCounter, &portData, semaphore};
+    ThreadData params_hour = {db, &serialPort, &nextHourLogTime, &hourlyAverageValue, &hourlyRecordCounter, &portData, semaphore};
     pthread_t threadHour;
     int status = pthread_create(&threadHour, NULL, hourly_log_thread, &params_hour);
     if (status != 0) {
@@ -241,7 +297,7 @@ int main(int argc, char *argv[]) {
 #endif
     // Create new thread (day logger)
 #ifdef _WIN32
-    ThreadData params_day = {db, serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
+    ThreadData params_day = {db, &serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
     InitializeCriticalSection(&params_day.dataMutex);
     HANDLE threadDay = CreateThread(NULL, 0, daily_log_thread, &params_day, 0, NULL);
     if (threadDay == NULL) {
@@ -249,7 +305,7 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 #else
-    ThreadData params_day = {db, serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
+    ThreadData params_day = {db, &serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
     pthread_t threadDay;
     status = pthread_create(&threadDay, NULL, daily_log_thread, &params_day);
     if (status != 0) {
@@ -261,21 +317,26 @@ int main(int argc, char *argv[]) {
     
     // Create new thread (data processing)
 #ifdef _WIN32
-    ThreadData params_data = {db, serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
+    ThreadData params_data = {db, &serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
     InitializeCriticalSection(&params_data.dataMutex);
-    HANDLE threadData = CreateThread(NULL, 0, data_processing_thread, &params_data, 0, NULL);
-    if (threadData == NULL) {
-        perror("CreateThread (thr_data)");
-        exit(EXIT_FAILURE);
+    HANDLE threadData = NULL;
+    if (!replaying) {
+        threadData = CreateThread(NULL, 0, data_processing_thread, &params_data, 0, NULL);
+        if (threadData == NULL) {
+            perror("CreateThread (thr_data)");
+            exit(EXIT_FAILURE);
+        }
     }
 #else
-    ThreadData params_data = {db, serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
+    ThreadData params_data = {db, &serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
     pthread_t threadData;
-    status = pthread_create(&threadData, NULL, data_processing_thread, &params_data);
-    if (status != 0) {
-        perror("pthread_create (thr_data)");
-        free_resources(lastRecordFile, &db, &serialPort);
-        exit(EXIT_FAILURE);
+    if (!replaying) {
+        status = pthread_create(&threadData, NULL, data_processing_thread, &params_data);
+        if (status != 0) {
+            perror("pthread_create (thr_data)");
+            free_resources(lastRecordFile, &db, &serialPort);
+            exit(EXIT_FAILURE);
+        }
     }
 #endif
 
@@ -283,38 +344,54 @@ int main(int argc, char *argv[]) {
     
     // Web server setup
 #ifdef _WIN32
-    ThreadData params_web = {db, serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
+    ThreadData params_web = {db, &serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
     InitializeCriticalSection(&params_web.dataMutex);
-    HANDLE threadWeb = CreateThread(NULL, 0, web_server_thread, &params_web, 0, NULL);
-    if (threadWeb == NULL) {
-        perror("CreateThread (thr_web)");
-        exit(EXIT_FAILURE);
+    HANDLE threadWeb = NULL;
+    if (!replaying) {
+        threadWeb = CreateThread(NULL, 0, web_server_thread, &params_web, 0, NULL);
+        if (threadWeb == NULL) {
+            perror("CreateThread (thr_web)");
+            exit(EXIT_FAILURE);
+        }
     }
 #else
-    ThreadData params_web = {db, serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
+    ThreadData params_web = {db, &serialPort, &nextDayLogTime, &dailyAverageValue, &dailyRecordCounter, &portData, semaphore};
     pthread_t threadWeb;
-    status = pthread_create(&threadWeb, NULL, web_server_thread, &params_web);
-    if (status != 0) {
-        perror("pthread_create (thr_web)");
-        free_resources(lastRecordFile, &db, &serialPort);
-        exit(EXIT_FAILURE);
+    if (!replaying) {
+        status = pthread_create(&threadWeb, NULL, web_server_thread, &params_web);
+        if (status != 0) {
+            perror("pthread_create (thr_web)");
+            free_resources(lastRecordFile, &db, &serialPort);
+            exit(EXIT_FAILURE);
+        }
     }
 #endif
 
+    // Replay runs the data processing here, then stops the period threads
+    if (replaying) {
+        replay_samples(&params_data, replay);
+        need_exit = 1;
+        loggerClock.stop();
+    }
+
 #ifdef _WIN32
     WaitForSingleObject(threadHour, INFINITE);
     CloseHandle(threadHour);
     WaitForSingleObject(threadDay, INFINITE);
     CloseHandle(threadDay);
-    WaitForSingleObject(threadData, INFINITE);
-    CloseHandle(threadData);
-    WaitForSingleObject(threadWeb, INFINITE);
-    CloseHandle(threadWeb);
+    if (!replaying) {
+        WaitForSingleObject(threadData, INFINITE);
+        CloseHandle(threadData);
+        WaitForSingleObject(threadWeb, INFINITE);
+        CloseHandle(threadWeb);
+    }
 #else
     pthread_join(threadHour, NULL);
     pthread_join(threadDay, NULL);
-    pthread_join(threadData, NULL);
-    pthread_join(threadWeb, NULL);
+    if (!replaying) {
+        pthread_join(threadData, NULL);
+        pthread_join(threadWeb, NULL);
+    }
 #endif
 
 #ifdef _WIN32
@@ -327,10 +404,10 @@ int main(int argc, char *argv[]) {
     *lastRecordFile << lastRecordPosition[1] << "\n";
 #endif
 #ifdef _WIN32
-    close_port(serialPort);
+    serialPort.close();
     free_resources(&lastRecordFile, &db, &semaphore, &serialPort);
 #else
-    close_port(serialPort);
+    serialPort.close();
     free_resources(lastRecordFile, &db, &serialPort);
 #endif
     sqlite3_close(db);
@@ -341,7 +418,30 @@ int main(int argc, char *argv[]) {
 void make_fixed_length_record(std::string& fixed_record, const std::string& record) {
     fixed_record.assign(RECORD_LENGTH - 1, ' ');
     size_t copy_len = std::min(record.size(), static_cast<size_t>(RECORD_LENGTH - 1));
-    fixed_record.replace(0, copy_len, record.substr(0, copy_len));
+    fixed_record.replace(0, copy_len, record, 0, copy_len);
+}
+
+std::string get_current_time() {
+    TimestampCache timestamp;
+    return std::string(timestamp.format(loggerClock.now()), TIMESTAMP_LENGTH);
+}
+
+sqlite3_stmt* prepare_sample_insert(sqlite3* db) {
+    sqlite3_stmt* insert = nullptr;
+    if (sqlite3_prepare_v2(db, "INSERT INTO logs (timestamp, temperature) VALUES (?, ?);", -1, &insert, nullptr) != SQLITE_OK) {
+        std::cerr << "SQL prepare error: " << sqlite3_errmsg(db) << std::endl;
+        return nullptr;
+    }
+    return insert;
+}
+
+void write_sample_to_db(sqlite3_stmt* insert, const char* timestamp, const char* record, size_t size) {
+    // The buffers stay untouched until the statement is reset, SQLite does not need a copy
+    sqlite3_bind_text(insert, 1, timestamp, TIMESTAMP_LENGTH, SQLITE_STATIC);
+    sqlite3_bind_text(insert, 2, record, static_cast<int>(size), SQLITE_STATIC);
+    if (sqlite3_step(insert) != SQLITE_DONE)
+        std::cerr << "SQL error: " << sqlite3_errmsg(sqlite3_db_handle(insert)) << std::endl;
+    sqlite3_reset(insert);
 }
 
 std::string http_response(const std::string& body, int status_code, const std::string& content_type) {
@@ -493,20 +593,6 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
         return FALSE;
     }
 
-    std::string get_current_time() {
-        SYSTEMTIME st;
-        GetLocalTime(&st);
-        std::ostringstream oss;
-        oss << std::setfill('0') << std::setw(4) << st.wYear << "-"
-            << std::setw(2) << st.wMonth << "-"
-            << std::setw(2) << st.wDay << " "
-            << std::setw(2) << st.wHour << ":"
-            << std::setw(2) << st.wMinute << ":"
-            << std::setw(2) << st.wSecond << "."
-            << std::setw(3) << st.wMilliseconds;
-        return oss.str();
-    }
-
     void write_log_to_db(sqlite3* db, const std::string& record) {
         std::string query = "INSERT INTO logs (timestamp, temperature) VALUES ('" + get_current_time() + "', '" + record + "');";
         char* error_message = nullptr;
@@ -518,11 +604,11 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
         }
     }
 
-    void free_resources(HANDLE* lastRecordFile, sqlite3** db, HANDLE* sem, HANDLE* serialPort) {
+    void free_resources(HANDLE* lastRecordFile, sqlite3** db, HANDLE* sem, SerialPort* serialPort) {
         if (lastRecordFile != nullptr) { CloseHandle(*lastRecordFile); *lastRecordFile = nullptr; }
         if (db != nullptr) {sqlite3_close(*db); *db = nullptr; }
         if (sem != nullptr) { CloseHandle(*sem); *sem = nullptr; }
-        if (serialPort != nullptr) {  *serialPort = nullptr; }
+        if (serialPort != nullptr) { serialPort->close(); }
     }
 
     void read_last_records(HANDLE fileHandle, int *value1, int *value2) {
@@ -552,59 +638,118 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
 
     DWORD WINAPI data_processing_thread(void *args) {
         ThreadData *params = (ThreadData*)args;
-        std::vector<char> buffer(255);
-        std::string logRecord;
-        std::string currentTime;
+        FrameDecoder decoder(frameMode);
+        std::string_view frame;
+        // Per-sample buffers and the insert statement are reused so that the loop does not allocate
+        TimestampCache timestamps;
+        FixedRecordBuilder logRecord(RECORD_LENGTH);
+        sqlite3_stmt* insert = prepare_sample_insert(params->db);
+        if (insert == nullptr) {
+            need_exit = 1;
+            return 0;
+        }
         double currentTemperature;
+        // The readings of one read go through the filters together, the database keeps them as they came
+        FilterStage filters(filterChain, 1);
+        std::vector<double> batch;
         while (!need_exit) {
-            DWORD bytesRead;
-            if (ReadFile(params->serialPort, buffer.data(), buffer.size(), &bytesRead, NULL)) {
-                if (bytesRead > 0) {
-                    currentTime = get_current_time();
-                    std::string tempStr(buffer.data(), bytesRead);
-                    size_t first = tempStr.find_first_not_of(" \t\n\r");
-                    size_t last = tempStr.find_last_not_of(" \t\n\r");
-                        if (first != std::string::npos && last != std::string::npos)
-                        tempStr = tempStr.substr(first, (last - first + 1));
-                    else
-                        tempStr = "";
-                    
-                    try {
-                            currentTemperature = std::stod(tempStr);
-                        }
-                        catch (const std::invalid_argument& e) {
-                            std::cerr << "Invalid argument in temperature string: " << tempStr << std::endl;
-                            currentTemperature = 0.0;
-                        }
-
-                    logRecord = std::to_string(currentTemperature);
-                    std::string fixed_record;
-                    make_fixed_length_record(fixed_record, logRecord);
-                    write_log_to_db(params->db, fixed_record);
-                    
-                    EnterCriticalSection(&params->dataMutex);
-                    *params->portData = std::to_string(currentTemperature);
+            // Returns as soon as data arrives, wakes up at least every PORT_SPEED_MS to check need_exit
+            int bytesRead = params->serialPort->read_some(decoder.write_ptr(), decoder.write_space(), PORT_SPEED_MS);
+            if (bytesRead >= 0) {
+                decoder.commit(bytesRead);
+                // A read may carry several readings or only a part of one
+                while (decoder.next_frame(&frame)) {
+                    const char* currentTime = timestamps.now();
+                    if (!parse_sample_value(frame, currentTemperature)) {
+                        std::cerr << "Invalid argument in temperature string: " << frame << std::endl;
+                        continue;
+                    }
+
+                    // "%f" of the value, RECORD_LENGTH - 1 characters without the '\n' the builder ends with
+                    const char* fixed_record = logRecord.clear().append_fixed(currentTemperature, 6).finish();
+                    write_sample_to_db(insert, currentTime, fixed_record, RECORD_LENGTH - 1);
+                    batch.push_back(currentTemperature);
+                }
+                filters.process(0, batch.data(), batch.size());
+
+                EnterCriticalSection(&params->dataMutex);
+                if (!batch.empty())
+                    params->portData->assign(logRecord.text());
+                for (double value : batch) {
                     *params->recordCounter = *params->recordCounter + 1;
-                    *params->averageValue += (currentTemperature - *params->averageValue) / *params->recordCounter;
-                    LeaveCriticalSection(&params->dataMutex);
+                    *params->averageValue += (value - *params->averageValue) / *params->recordCounter;
                 }
+                LeaveCriticalSection(&params->dataMutex);
+                batch.clear();
             }
             else {
                 perror("ReadFile (pd)");
                 break;
             }
-            
-            Sleep(PORT_SPEED_MS);
+        }
+        sqlite3_finalize(insert);
+        // Link quality: sequence gaps and repeats, damaged frames
+        if (frameMode == FrameMode::SEQUENCED) {
+            std::cout << PORT_RD << ": " << decoder.frames() << " frames, " << decoder.lost_frames() << " lost, "
+                      << decoder.duplicate_frames() << " duplicated, " << decoder.crc_errors() << " CRC errors, "
+                      << decoder.dropped_bytes() << " bytes skipped" << std::endl;
         }
         return 0;
     }
 
+    void replay_samples(ThreadData *params, ReplaySource& replay) {
+        TimestampCache timestamps;
+        FixedRecordBuilder logRecord(RECORD_LENGTH);
+        sqlite3_stmt* insert = prepare_sample_insert(params->db);
+        if (insert == nullptr)
+            return;
+        // A single sensor here: the first one of the log
+        std::string sensorId = replay.sensor_ids()[0];
+        ReplaySample sample;
+        double currentTemperature;
+        FilterStage filters(filterChain, 1);
+        unsigned long long replayed = 0;
+        std::chrono::steady_clock::time_point replayStart = std::chrono::steady_clock::now();
+        sqlite3_exec(params->db, "BEGIN;", nullptr, nullptr, nullptr);
+        while (!need_exit && replay.next(sample)) {
+            if (sample.sensorId != sensorId)
+                continue;
+            // Returns once the periods that ended before this sample have been written
+            loggerClock.advance_to(sample.time);
+            if (!parse_sample_value(sample.value, currentTemperature)) {
+                std::cerr << "Invalid argument in temperature string: " << sample.value << std::endl;
+                continue;
+            }
+
+            const char* currentTime = timestamps.format(loggerClock.now());
+            const char* fixed_record = logRecord.clear().append_fixed(currentTemperature, 6).finish();
+            write_sample_to_db(insert, currentTime, fixed_record, RECORD_LENGTH - 1);
+            // One at a time: the next sample may already close the period
+            filters.process(0, &currentTemperature, 1);
+
+            EnterCriticalSection(&params->dataMutex);
+            params->portData->assign(logRecord.text());
+            *params->recordCounter = *params->recordCounter + 1;
+            *params->averageValue += (currentTemperature - *params->averageValue) / *params->recordCounter;
+            LeaveCriticalSection(&params->dataMutex);
+            if (++replayed % REPLAY_BATCH_ROWS == 0)
+                sqlite3_exec(params->db, "COMMIT; BEGIN;", nullptr, nullptr, nullptr);
+        }
+        loggerClock.advance_to(replay.end_time());   // Periods that end with the series are written too
+        sqlite3_exec(params->db, "COMMIT;", nullptr, nullptr, nullptr);
+        sqlite3_finalize(insert);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+        std::cout << "replayed " << replayed << " samples in " << std::fixed << std::setprecision(2) << seconds << " s, "
+                  << std::setprecision(0) << replayed / (seconds > 0 ? seconds : 1) << " samples/s" << std::endl;
+    }
+
     DWORD WINAPI hourly_log_thread(void *args) {
         ThreadData *params = (ThreadData*)args;
         std::string currentTime;
         std::string logRecord;
+        int sleeper = loggerClock.register_sleeper();
         while (!need_exit) {
-            time_t current_time = time(NULL);
+            time_t current_time = loggerClock.now_sec();
             if (current_time >= *params->nextLogTime) {
 
                 SemaphoreWait(params->threadSemaphore);
@@ -628,7 +773,12 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
                 *params->recordCounter = 0;
                 LeaveCriticalSection(&params->dataMutex);
             }
-            Sleep(PORT_SPEED_MS);
+            // A replay sleeps in the replayed time until the next period ends, see LoggerClock
+            if (loggerClock.is_replay()) {
+                if (loggerClock.sleep_until(sleeper, *params->nextLogTime))
+                    break;
+            }
+            else Sleep(PORT_SPEED_MS);
         }
         return 0;
     }
@@ -638,8 +788,9 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
         ThreadData *params = (ThreadData*)args;
         std::string currentTime;
         std::string logRecord;
+        int sleeper = loggerClock.register_sleeper();
         while (!need_exit) {
-            time_t current_time = time(NULL);
+            time_t current_time = loggerClock.now_sec();
             if (current_time >= *params->nextLogTime) {
 
                 SemaphoreWait(params->threadSemaphore);
@@ -663,7 +814,12 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
                 *params->recordCounter = 0;
                 LeaveCriticalSection(&params->dataMutex);
             }
-            Sleep(PORT_SPEED_MS);
+            // A replay sleeps in the replayed time until the next period ends, see LoggerClock
+            if (loggerClock.is_replay()) {
+                if (loggerClock.sleep_until(sleeper, *params->nextLogTime))
+                    break;
+            }
+            else Sleep(PORT_SPEED_MS);
         }
         return 0;
     }
@@ -829,23 +985,6 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
             need_exit = 1;
     }
 
-    std::string get_current_time() {
-        std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
-        std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-        std::tm* tmp = std::localtime(&now_c);
-
-        if (tmp == nullptr) {
-            perror("localtime");
-            exit(EXIT_FAILURE);
-        }
-
-        std::ostringstream oss;
-        oss << std::put_time(tmp, "%Y-%m-%d %H:%M:%S");
-        long ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
-        oss << "." << std::setfill('0') << std::setw(3) << ms;
-        return oss.str();
-    }
-
     void write_log_to_db(sqlite3* db, const std::string& record) {
         std::string query = "INSERT INTO logs (timestamp, temperature) VALUES ('" + get_current_time() + "', '" + record + "');";
         char* error_message = nullptr;
@@ -857,9 +996,9 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
         }
     }
 
-    void free_resources(std::fstream* lastRecordFile, sqlite3** db, int* fd) {
+    void free_resources(std::fstream* lastRecordFile, sqlite3** db, SerialPort* serialPort) {
         if (lastRecordFile != nullptr) { lastRecordFile->close(); delete lastRecordFile; }
-        if (fd != nullptr) { close_port(*fd); *fd = -1; }
+        if (serialPort != nullptr) { serialPort->close(); }
         if (db != nullptr) {sqlite3_close(*db); *db = nullptr; }
         sem_unlink(SEMAPHORE_OBJECT_NAME);
     }
@@ -874,51 +1013,119 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
 
     void* data_processing_thread(void *args) {
         ThreadData *params = (ThreadData*)args;
-        std::vector<char> buffer(255);
-        std::string logRecord;
-        std::string currentTime;
+        FrameDecoder decoder(frameMode);
+        std::string_view frame;
+        // Per-sample buffers and the insert statement are reused so that the loop does not allocate
+        TimestampCache timestamps;
+        FixedRecordBuilder logRecord(RECORD_LENGTH);
+        sqlite3_stmt* insert = prepare_sample_insert(params->db);
+        if (insert == nullptr) {
+            need_exit = 1;
+            return NULL;
+        }
         double currentTemperature;
+        // The readings of one read go through the filters together, the database keeps them as they came
+        FilterStage filters(filterChain, 1);
+        std::vector<double> batch;
         while (!need_exit) {
-            ssize_t bytesRead = read(params->serialPort, buffer.data(), buffer.size());
+            // Returns as soon as data arrives, wakes up at least every PORT_SPEED_MS to check need_exit
+            int bytesRead = params->serialPort->read_some(decoder.write_ptr(), decoder.write_space(), PORT_SPEED_MS);
+            if (bytesRead < 0) {
+                perror("read (pd)");
+                break;
+            }
             if (bytesRead > 0) {
-                std::string tempStr(buffer.data(), bytesRead);
-                size_t first = tempStr.find_first_not_of(" \t\n\r");
-                size_t last = tempStr.find_last_not_of(" \t\n\r");
-                if (first != std::string::npos && last != std::string::npos)
-                    tempStr = tempStr.substr(first, (last - first + 1));
-                else
-                    tempStr = "";
-                try {
-                    currentTemperature = std::stod(tempStr);
+                decoder.commit(bytesRead);
+            }
+            // A read may carry several readings or only a part of one
+            while (decoder.next_frame(&frame)) {
+                if (!parse_sample_value(frame, currentTemperature)) {
+                    std::cerr << "Invalid argument in temperature string: " << frame << std::endl;
+                    continue;
                 }
-                catch (const std::invalid_argument& e) {
-                        std::cerr << "Invalid argument in temperature string: " << tempStr << std::endl;
-                        currentTemperature = 0.0;
-                    }
 
-                currentTime = get_current_time();
-                logRecord = std::to_string(currentTemperature);
-                std::string fixed_record;
-                make_fixed_length_record(fixed_record, logRecord);
-                write_log_to_db(params->db, fixed_record);
-                
-                params->dataMutex.lock();
-                *params->portData = std::to_string(currentTemperature);
+                const char* currentTime = timestamps.now();
+                // "%f" of the value, RECORD_LENGTH - 1 characters without the '\n' the builder ends with
+                const char* fixed_record = logRecord.clear().append_fixed(currentTemperature, 6).finish();
+                write_sample_to_db(insert, currentTime, fixed_record, RECORD_LENGTH - 1);
+                batch.push_back(currentTemperature);
+            }
+            if (batch.empty())
+                continue;
+            filters.process(0, batch.data(), batch.size());
+
+            params->dataMutex.lock();
+            params->portData->assign(logRecord.text());
+            for (double value : batch) {
                 *params->recordCounter = *params->recordCounter + 1;
-                *params->averageValue += (currentTemperature - *params->averageValue) / *params->recordCounter;
-                params->dataMutex.unlock();
+                *params->averageValue += (value - *params->averageValue) / *params->recordCounter;
             }
-            usleep(1000 * PORT_SPEED_MS);
+            params->dataMutex.unlock();
+            batch.clear();
+        }
+        sqlite3_finalize(insert);
+        // Link quality: sequence gaps and repeats, damaged frames
+        if (frameMode == FrameMode::SEQUENCED) {
+            std::cout << PORT_RD << ": " << decoder.frames() << " frames, " << decoder.lost_frames() << " lost, "
+                      << decoder.duplicate_frames() << " duplicated, " << decoder.crc_errors() << " CRC errors, "
+                      << decoder.dropped_bytes() << " bytes skipped" << std::endl;
         }
         return 0;
     }
 
+    void replay_samples(ThreadData *params, ReplaySource& replay) {
+        TimestampCache timestamps;
+        FixedRecordBuilder logRecord(RECORD_LENGTH);
+        sqlite3_stmt* insert = prepare_sample_insert(params->db);
+        if (insert == nullptr)
+            return;
+        // A single sensor here: the first one of the log
+        std::string sensorId = replay.sensor_ids()[0];
+        ReplaySample sample;
+        double currentTemperature;
+        FilterStage filters(filterChain, 1);
+        unsigned long long replayed = 0;
+        std::chrono::steady_clock::time_point replayStart = std::chrono::steady_clock::now();
+        sqlite3_exec(params->db, "BEGIN;", nullptr, nullptr, nullptr);
+        while (!need_exit && replay.next(sample)) {
+            if (sample.sensorId != sensorId)
+                continue;
+            // Returns once the periods that ended before this sample have been written
+            loggerClock.advance_to(sample.time);
+            if (!parse_sample_value(sample.value, currentTemperature)) {
+                std::cerr << "Invalid argument in temperature string: " << sample.value << std::endl;
+                continue;
+            }
+
+            const char* currentTime = timestamps.format(loggerClock.now());
+            const char* fixed_record = logRecord.clear().append_fixed(currentTemperature, 6).finish();
+            write_sample_to_db(insert, currentTime, fixed_record, RECORD_LENGTH - 1);
+            // One at a time: the next sample may already close the period
+            filters.process(0, &currentTemperature, 1);
+
+            params->dataMutex.lock();
+            params->portData->assign(logRecord.text());
+            *params->recordCounter = *params->recordCounter + 1;
+            *params->averageValue += (currentTemperature - *params->averageValue) / *params->recordCounter;
+            params->dataMutex.unlock();
+            if (++replayed % REPLAY_BATCH_ROWS == 0)
+                sqlite3_exec(params->db, "COMMIT; BEGIN;", nullptr, nullptr, nullptr);
+        }
+        loggerClock.advance_to(replay.end_time());   // Periods that end with the series are written too
+        sqlite3_exec(params->db, "COMMIT;", nullptr, nullptr, nullptr);
+        sqlite3_finalize(insert);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+        std::cout << "replayed " << replayed << " samples in " << std::fixed << std::setprecision(2) << seconds << " s, "
+                  << std::setprecision(0) << replayed / (seconds > 0 ? seconds : 1) << " samples/s" << std::endl;
+    }
+
     void* hourly_log_thread(void *args) {
         ThreadData *params = (ThreadData*)args;
         std::string currentTime;
         std::string logRecord;
+        int sleeper = loggerClock.register_sleeper();
         while (!need_exit) {
-            time_t current_time = time(NULL);
+            time_t current_time = loggerClock.now_sec();
             if (current_time >= *params->nextLogTime) {
 
                 SemaphoreWait(params->threadSemaphore);
@@ -944,7 +1151,12 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
                 *params->recordCounter = 0;
                 SemaphorePost(params->threadSemaphore);
             }
-            usleep(1000 * PORT_SPEED_MS);
+            // A replay sleeps in the replayed time until the next period ends, see LoggerClock
+            if (loggerClock.is_replay()) {
+                if (loggerClock.sleep_until(sleeper, *params->nextLogTime))
+                    break;
+            }
+            else usleep(1000 * PORT_SPEED_MS);
         }
         return 0;
     }
@@ -953,8 +1165,9 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
         ThreadData *params = (ThreadData*)args;
         std::string currentTime;
         std::string logRecord;
+        int sleeper = loggerClock.register_sleeper();
         while (!need_exit) {
-            time_t current_time = time(NULL);
+            time_t current_time = loggerClock.now_sec();
             if (current_time >= *params->nextLogTime) {
 
                 SemaphoreWait(params->threadSemaphore);
@@ -980,7 +1193,12 @@ std::string get_stats_from_db(sqlite3* db, const std::string& start_time, const
                 *params->recordCounter = 0;
                 SemaphorePost(params->threadSemaphore);
             }
-            usleep(1000 * PORT_SPEED_MS);
+            // A replay sleeps in the replayed time until the next period ends, see LoggerClock
+            if (loggerClock.is_replay()) {
+                if (loggerClock.sleep_until(sleeper, *params->nextLogTime))
+                    break;
+            }
+            else usleep(1000 * PORT_SPEED_MS);
         }
         return 0;
     }
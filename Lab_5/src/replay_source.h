@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "log_query.h"
+
+// Samples for the replay mode: the records of a text log (oldest first), or a generated series of
+// one reading per second and sensor
+
+#define REPLAY_GENERATED_YEAR 2024   // Generated series start on January 1 of this year, local time
+
+struct ReplaySample {
+    std::chrono::system_clock::time_point time;
+    std::string_view sensorId;
+    std::string_view value;   // As the sensor sent it
+};
+
+// Local time "YYYY-MM-DD hh:mm:ss.sss"; mktime only runs when the second changes
+class TimestampParser {
+public:
+    bool parse(const char* text, std::chrono::system_clock::time_point& time) {
+        if (!cached || memcmp(text, cachedText, RING_LOG_TIME_PREFIX) != 0) {
+            std::tm local = {};
+            if (!field(text, 0, 4, local.tm_year) || !field(text, 5, 2, local.tm_mon) || !field(text, 8, 2, local.tm_mday) ||
+                !field(text, 11, 2, local.tm_hour) || !field(text, 14, 2, local.tm_min) || !field(text, 17, 2, local.tm_sec)) {
+                return false;
+            }
+            local.tm_year -= 1900;
+            local.tm_mon -= 1;
+            local.tm_isdst = -1;
+            cachedSecond = mktime(&local);
+            memcpy(cachedText, text, RING_LOG_TIME_PREFIX);
+            cached = true;
+        }
+        int milliseconds = 0;
+        if (text[RING_LOG_TIME_PREFIX] == '.' && !field(text, RING_LOG_TIME_PREFIX + 1, 3, milliseconds)) {
+            return false;
+        }
+        time = std::chrono::system_clock::from_time_t(cachedSecond) + std::chrono::milliseconds(milliseconds);
+        return true;
+    }
+
+private:
+    static bool field(const char* text, size_t offset, size_t length, int& value) {
+        std::from_chars_result result = std::from_chars(text + offset, text + offset + length, value);
+        return result.ec == std::errc() && result.ptr == text + offset + length;
+    }
+
+    bool cached = false;
+    char cachedText[RING_LOG_TIME_PREFIX];
+    std::time_t cachedSecond = 0;
+};
+
+class ReplaySource {
+public:
+    // "<log>" or "generate:<days>"
+    bool open(const std::string& spec, const std::vector<std::string>& generatedIds) {
+        if (spec.compare(0, 9, "generate:") == 0) {
+            long long days = 0;
+            std::from_chars_result result = std::from_chars(spec.data() + 9, spec.data() + spec.size(), days);
+            if (result.ec != std::errc() || result.ptr != spec.data() + spec.size() || days <= 0 || generatedIds.empty()) {
+                return false;
+            }
+            std::tm start = {};
+            start.tm_year = REPLAY_GENERATED_YEAR - 1900;
+            start.tm_mday = 1;
+            start.tm_isdst = -1;
+            open_generated(generatedIds, days * 24 * 3600, mktime(&start));
+            return true;
+        }
+        return open_log(spec);
+    }
+
+    // Records of a text log written by SerialLogger, oldest first
+    bool open_log(const std::string& path) {
+        generated = false;
+        nextIndex = 0;
+        ids.clear();
+        if (!log.open(path) || log.size() == 0) {
+            return false;
+        }
+        // Sensor ids in the order they first appear, and the time span
+        ReplaySample sample;
+        bool haveFirst = false;
+        for (std::uint64_t i = 0; i < log.size(); ++i) {
+            if (!parse_record(log.record(i), sample)) continue;
+            if (!haveFirst) {
+                first = sample.time;
+                last = sample.time;
+                haveFirst = true;
+            }
+            last = std::max(last, sample.time);
+            bool known = false;
+            for (const std::string& id : ids) {
+                if (id == sample.sensorId) {
+                    known = true;
+                    break;
+                }
+            }
+            if (!known) ids.emplace_back(sample.sensorId);
+        }
+        // Like a generated series, the replay ends a second after the last record, so that the period the log
+        // completes (the last hour of a full day) is emitted too
+        last += std::chrono::seconds(1);
+        return haveFirst;
+    }
+
+    // seconds of readings of every sensor, the first at start
+    void open_generated(const std::vector<std::string>& sensorIds, std::int64_t seconds, std::time_t start) {
+        generated = true;
+        nextIndex = 0;
+        ids = sensorIds;
+        first = std::chrono::system_clock::from_time_t(start);
+        last = first + std::chrono::seconds(seconds);
+        count = static_cast<std::uint64_t>(seconds) * ids.size();
+    }
+
+    const std::vector<std::string>& sensor_ids() const { return ids; }
+    std::chrono::system_clock::time_point start_time() const { return first; }
+    std::chrono::system_clock::time_point end_time() const { return last; }   // A second after the last sample
+
+    // The sample stays valid until the next call
+    bool next(ReplaySample& sample) {
+        if (generated) {
+            if (nextIndex >= count) return false;
+            std::uint64_t second = nextIndex / ids.size();
+            size_t sensor = static_cast<size_t>(nextIndex % ids.size());
+            ++nextIndex;
+            sample.time = first + std::chrono::seconds(second);
+            sample.sensorId = ids[sensor];
+            sample.value = generated_value(second, sensor);
+            return true;
+        }
+        while (nextIndex < log.size()) {
+            if (parse_record(log.record(nextIndex++), sample)) return true;
+        }
+        return false;
+    }
+
+private:
+    // "<time> <sensor_id> <value>", padded with spaces; damaged records are skipped
+    bool parse_record(const char* record, ReplaySample& sample) {
+        std::string_view text(record, static_cast<size_t>(log.record_length() - 1));
+        if (text.size() <= LOG_QUERY_TIME_LENGTH + 1 || text[LOG_QUERY_TIME_LENGTH] != ' ' || !timestamps.parse(record, sample.time)) {
+            return false;
+        }
+        text.remove_prefix(LOG_QUERY_TIME_LENGTH + 1);
+        size_t idEnd = text.find(' ');
+        if (idEnd == 0 || idEnd == std::string_view::npos) return false;
+        sample.sensorId = text.substr(0, idEnd);
+        text.remove_prefix(idEnd + 1);
+        sample.value = text.substr(0, text.find(' '));
+        return !sample.value.empty();
+    }
+
+    // Daily cycle around 20 degrees with a little deterministic noise, one decimal like temperature_simulator
+    std::string_view generated_value(std::uint64_t second, size_t sensor) {
+        std::uint64_t noise = (second * 6364136223846793005ULL + sensor * 1442695040888963407ULL) >> 40;
+        double value = 20.0 + 5.0 * std::sin(2.0 * 3.14159265358979323846 * static_cast<double>(second % 86400) / 86400.0 + static_cast<double>(sensor)) +
+                       static_cast<double>(noise % 100) / 100.0;
+        std::to_chars_result result = std::to_chars(valueText, valueText + sizeof(valueText), value, std::chars_format::fixed, 1);
+        return std::string_view(valueText, static_cast<size_t>(result.ptr - valueText));
+    }
+
+    bool generated = false;
+    LogQuery log;
+    TimestampParser timestamps;
+    std::vector<std::string> ids;
+    std::chrono::system_clock::time_point first;
+    std::chrono::system_clock::time_point last;
+    std::uint64_t count = 0;        // Generated samples
+    std::uint64_t nextIndex = 0;
+    char valueText[32];
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+// Per-sample formatting without heap allocations or iostreams: the serial loggers call these for every reading
+
+#define TIMESTAMP_LENGTH 23   // "YYYY-MM-DD hh:mm:ss.sss", local time
+
+// Local time "YYYY-MM-DD hh:mm:ss.sss". The date and time up to the seconds are formatted once per second,
+// every other call only rewrites the milliseconds
+class TimestampCache {
+public:
+    // TIMESTAMP_LENGTH characters plus '\0', valid until the next call
+    const char* now() { return format(std::chrono::system_clock::now()); }
+
+    const char* format(std::chrono::system_clock::time_point time) {
+        long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+        long long second = ms >= 0 ? ms / 1000 : (ms - 999) / 1000;
+        if (second != cachedSecond) {
+            std::time_t seconds = static_cast<std::time_t>(second);
+            std::tm local;
+#ifdef _WIN32
+            localtime_s(&local, &seconds);
+#else
+            localtime_r(&seconds, &local);
+#endif
+            strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S.", &local);
+            cachedSecond = second;
+        }
+        int milliseconds = static_cast<int>(ms - second * 1000);
+        text[20] = static_cast<char>('0' + milliseconds / 100);
+        text[21] = static_cast<char>('0' + milliseconds / 10 % 10);
+        text[22] = static_cast<char>('0' + milliseconds % 10);
+        text[TIMESTAMP_LENGTH] = '\0';
+        return text;
+    }
+
+private:
+    long long cachedSecond = LLONG_MIN;
+    char text[TIMESTAMP_LENGTH + 2];   // strftime needs room for its terminator after the '.'
+};
+
+// Reading as sent by the sensor, surrounding whitespace ignored. Like atof, a number followed by garbage
+// yields the number; false (and 0) if there is no number at all
+inline bool parse_sample_value(std::string_view text, double& value) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    while (first < last && (*first == ' ' || *first == '\t' || *first == '\r' || *first == '\n')) ++first;
+    if (first < last && *first == '+') ++first;   // from_chars does not take a plus sign
+    std::from_chars_result result = std::from_chars(first, last, value);
+    if (result.ec != std::errc()) {
+        value = 0.0;
+        return false;
+    }
+    return true;
+}
+
+// Fixed-length record built in place, the same layout as make_fixed_length_record(): the text is cut at
+// length - 1 characters, padded with spaces and terminated by '\n'. The buffer is allocated once
+class FixedRecordBuilder {
+public:
+    explicit FixedRecordBuilder(size_t length) : record(length, ' ') { record.back() = '\n'; }
+
+    FixedRecordBuilder& clear() {
+        used = 0;
+        return *this;
+    }
+
+    FixedRecordBuilder& append(std::string_view text) {
+        size_t count = std::min(text.size(), record.size() - 1 - used);
+        memcpy(&record[used], text.data(), count);
+        used += count;
+        return *this;
+    }
+
+    FixedRecordBuilder& append(char c) { return append(std::string_view(&c, 1)); }
+
+    // printf("%.<precision>f") without the locale and the format string parsing
+    FixedRecordBuilder& append_fixed(double value, int precision) {
+        char number[64];
+        std::to_chars_result result = std::to_chars(number, number + sizeof(number), value, std::chars_format::fixed, precision);
+        return append(std::string_view(number, result.ec == std::errc() ? static_cast<size_t>(result.ptr - number) : 0));
+    }
+
+    // Pads what is left of the previous record; the record stays valid until the next clear()
+    const char* finish() {
+        std::fill(record.begin() + used, record.end() - 1, ' ');
+        return record.data();
+    }
+
+    size_t size() const { return record.size(); }
+    std::string_view text() const { return std::string_view(record.data(), used); }   // Without the padding
+
+private:
+    std::string record;
+    size_t used = 0;
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define SIGNAL_FILTER_SSE2 1
+#endif
+
+// Conditioning of the readings between the frame decoder and the statistics: a chain of filters per sensor, run
+// over batches of consecutive samples of that sensor. Median and Hampel windows are causal (the sample and the
+// window - 1 before it), their history starts as copies of the first sample. The SSE2 kernels compute two outputs
+// per instruction with a min/max sorting network; the scalar kernels are the reference they are checked against.
+
+#define FILTER_MAX_WINDOW 15
+#define FILTER_HAMPEL_SCALE 1.4826   // MAD to standard deviation, for normally distributed noise
+
+enum class FilterKind {
+    MEDIAN,   // Median of the window
+    EMA,      // Exponential moving average
+    HAMPEL    // A sample further than threshold scaled MADs from the window median is replaced by the median
+};
+
+struct FilterSpec {
+    FilterKind kind = FilterKind::MEDIAN;
+    int window = 5;          // MEDIAN, HAMPEL: odd, 3..FILTER_MAX_WINDOW
+    double alpha = 0.2;      // EMA: weight of the new sample, (0, 1]
+    double threshold = 3.0;  // HAMPEL
+};
+
+// "median:<window>", "ema:<alpha>" or "hampel:<window>[:<threshold>]", several separated by commas
+inline bool parse_filter_chain(const std::string& text, std::vector<FilterSpec>& chain) {
+    chain.clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(start, end - start);
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) return false;
+        std::string name = item.substr(0, colon);
+        const char* args = item.c_str() + colon + 1;
+        char* rest = nullptr;
+        FilterSpec spec;
+        if (name == "ema") {
+            spec.kind = FilterKind::EMA;
+            spec.alpha = strtod(args, &rest);
+            if (rest == args || *rest != '\0' || !(spec.alpha > 0.0 && spec.alpha <= 1.0)) return false;
+        }
+        else if (name == "median" || name == "hampel") {
+            spec.kind = name == "median" ? FilterKind::MEDIAN : FilterKind::HAMPEL;
+            spec.window = static_cast<int>(strtol(args, &rest, 10));
+            if (rest == args || spec.window < 3 || spec.window > FILTER_MAX_WINDOW || spec.window % 2 == 0) return false;
+            if (spec.kind == FilterKind::HAMPEL && *rest == ':') {
+                const char* threshold = rest + 1;
+                spec.threshold = strtod(threshold, &rest);
+                if (rest == threshold || !(spec.threshold > 0.0)) return false;
+            }
+            if (*rest != '\0') return false;
+        }
+        else {
+            return false;
+        }
+        chain.push_back(spec);
+        start = end + 1;
+    }
+    return true;
+}
+
+// Scalar kernels. in[-(window - 1)] .. in[-1] hold the history, out does not overlap in
+
+inline void filter_sort_scalar(const double* in, double* sorted, int window) {
+    for (int j = 0; j < window; ++j) {
+        double value = in[j];
+        int k = j;
+        for (; k > 0 && sorted[k - 1] > value; --k) sorted[k] = sorted[k - 1];
+        sorted[k] = value;
+    }
+}
+
+inline void filter_median_scalar(const double* in, double* out, size_t count, int window) {
+    double sorted[FILTER_MAX_WINDOW];
+    for (size_t i = 0; i < count; ++i) {
+        filter_sort_scalar(in + i - (window - 1), sorted, window);
+        out[i] = sorted[window / 2];
+    }
+}
+
+inline void filter_hampel_scalar(const double* in, double* out, size_t count, int window, double threshold) {
+    double sorted[FILTER_MAX_WINDOW], deviations[FILTER_MAX_WINDOW];
+    for (size_t i = 0; i < count; ++i) {
+        const double* samples = in + i - (window - 1);
+        filter_sort_scalar(samples, sorted, window);
+        double median = sorted[window / 2];
+        for (int j = 0; j < window; ++j) deviations[j] = std::fabs(samples[j] - median);
+        filter_sort_scalar(deviations, sorted, window);
+        double limit = threshold * FILTER_HAMPEL_SCALE * sorted[window / 2];
+        out[i] = std::fabs(in[i] - median) > limit ? median : in[i];
+    }
+}
+
+inline void filter_ema_scalar(const double* in, double* out, size_t count, double alpha, double& state) {
+    for (size_t i = 0; i < count; ++i) {
+        state += alpha * (in[i] - state);
+        out[i] = state;
+    }
+}
+
+#ifdef SIGNAL_FILTER_SSE2
+// Odd-even transposition sort of W vectors, lane by lane
+template <int W>
+inline void filter_sort_network(__m128d* v) {
+    for (int round = 0; round < W; ++round) {
+        for (int j = round & 1; j + 1 < W; j += 2) {
+            __m128d low = _mm_min_pd(v[j], v[j + 1]);
+            v[j + 1] = _mm_max_pd(v[j], v[j + 1]);
+            v[j] = low;
+        }
+    }
+}
+
+template <int W>
+inline void filter_median_sse2(const double* in, double* out, size_t count) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const double* samples = in + i - (W - 1);
+        __m128d v[W];
+        for (int j = 0; j < W; ++j) v[j] = _mm_loadu_pd(samples + j);
+        filter_sort_network<W>(v);
+        _mm_storeu_pd(out + i, v[W / 2]);
+    }
+    filter_median_scalar(in + i, out + i, count - i, W);
+}
+
+template <int W>
+inline void filter_hampel_sse2(const double* in, double* out, size_t count, double threshold) {
+    const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const __m128d scale = _mm_set1_pd(threshold * FILTER_HAMPEL_SCALE);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const double* samples = in + i - (W - 1);
+        __m128d v[W], deviations[W];
+        for (int j = 0; j < W; ++j) v[j] = _mm_loadu_pd(samples + j);
+        filter_sort_network<W>(v);
+        __m128d median = v[W / 2];
+        for (int j = 0; j < W; ++j) deviations[j] = _mm_and_pd(_mm_sub_pd(_mm_loadu_pd(samples + j), median), absMask);
+        filter_sort_network<W>(deviations);
+        __m128d limit = _mm_mul_pd(scale, deviations[W / 2]);
+        __m128d current = _mm_loadu_pd(in + i);
+        __m128d outlier = _mm_cmpgt_pd(_mm_and_pd(_mm_sub_pd(current, median), absMask), limit);
+        _mm_storeu_pd(out + i, _mm_or_pd(_mm_and_pd(outlier, median), _mm_andnot_pd(outlier, current)));
+    }
+    filter_hampel_scalar(in + i, out + i, count - i, W, threshold);
+}
+
+// Two samples per step: [y0, y1] = [b, b^2] * state + [a, a * b] * x0 + [0, a] * x1 with b = 1 - a
+inline void filter_ema_sse2(const double* in, double* out, size_t count, double alpha, double& state) {
+    double keep = 1.0 - alpha;
+    const __m128d stateWeights = _mm_set_pd(keep * keep, keep);
+    const __m128d firstWeights = _mm_set_pd(alpha * keep, alpha);
+    const __m128d secondWeights = _mm_set_pd(alpha, 0.0);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d y = _mm_add_pd(_mm_mul_pd(stateWeights, _mm_set1_pd(state)),
+                               _mm_add_pd(_mm_mul_pd(firstWeights, _mm_set1_pd(in[i])), _mm_mul_pd(secondWeights, _mm_set1_pd(in[i + 1]))));
+        _mm_storeu_pd(out + i, y);
+        state = out[i + 1];
+    }
+    filter_ema_scalar(in + i, out + i, count - i, alpha, state);
+}
+#endif
+
+inline void filter_median(const double* in, double* out, size_t count, int window, bool simd) {
+#ifdef SIGNAL_FILTER_SSE2
+    if (simd) {
+        switch (window) {
+            case 3: filter_median_sse2<3>(in, out, count); return;
+            case 5: filter_median_sse2<5>(in, out, count); return;
+            case 7: filter_median_sse2<7>(in, out, count); return;
+            case 9: filter_median_sse2<9>(in, out, count); return;
+            case 11: filter_median_sse2<11>(in, out, count); return;
+            case 13: filter_median_sse2<13>(in, out, count); return;
+            case 15: filter_median_sse2<15>(in, out, count); return;
+        }
+    }
+#endif
+    filter_median_scalar(in, out, count, window);
+}
+
+inline void filter_hampel(const double* in, double* out, size_t count, int window, double threshold, bool simd) {
+#ifdef SIGNAL_FILTER_SSE2
+    if (simd) {
+        switch (window) {
+            case 3: filter_hampel_sse2<3>(in, out, count, threshold); return;
+            case 5: filter_hampel_sse2<5>(in, out, count, threshold); return;
+            case 7: filter_hampel_sse2<7>(in, out, count, threshold); return;
+            case 9: filter_hampel_sse2<9>(in, out, count, threshold); return;
+            case 11: filter_hampel_sse2<11>(in, out, count, threshold); return;
+            case 13: filter_hampel_sse2<13>(in, out, count, threshold); return;
+            case 15: filter_hampel_sse2<15>(in, out, count, threshold); return;
+        }
+    }
+#endif
+    filter_hampel_scalar(in, out, count, window, threshold);
+}
+
+inline void filter_ema(const double* in, double* out, size_t count, double alpha, double& state, bool simd) {
+#ifdef SIGNAL_FILTER_SSE2
+    if (simd) {
+        filter_ema_sse2(in, out, count, alpha, state);
+        return;
+    }
+#endif
+    filter_ema_scalar(in, out, count, alpha, state);
+}
+
+// One filter of the chain for one sensor, with the history it carries from batch to batch
+class SignalFilter {
+public:
+    explicit SignalFilter(const FilterSpec& spec) : spec(spec) {}
+
+    // Filters count consecutive samples, out must not overlap in; simd = false runs the scalar reference
+    void process(const double* in, double* out, size_t count, bool simd = true) {
+        if (count == 0) return;
+        if (!started) {
+            state = in[0];
+            window.assign(spec.kind == FilterKind::EMA ? 0 : spec.window - 1, in[0]);
+            started = true;
+        }
+        if (spec.kind == FilterKind::EMA) {
+            filter_ema(in, out, count, spec.alpha, state, simd);
+            return;
+        }
+        // The history and the batch in one buffer, so that every window is contiguous
+        size_t history = window.size();
+        window.insert(window.end(), in, in + count);
+        const double* current = window.data() + history;
+        if (spec.kind == FilterKind::MEDIAN)
+            filter_median(current, out, count, spec.window, simd);
+        else
+            filter_hampel(current, out, count, spec.window, spec.threshold, simd);
+        window.erase(window.begin(), window.end() - history);
+    }
+
+private:
+    FilterSpec spec;
+    bool started = false;
+    double state = 0.0;           // EMA
+    std::vector<double> window;   // MEDIAN, HAMPEL: the last window - 1 inputs
+};
+
+// The filter chain of every sensor
+class FilterStage {
+public:
+    FilterStage(const std::vector<FilterSpec>& chain, size_t sensors) : filters(sensors) {
+        for (std::vector<SignalFilter>& sensorFilters : filters) {
+            for (const FilterSpec& spec : chain) sensorFilters.emplace_back(spec);
+        }
+    }
+
+    bool empty() const { return filters.empty() || filters[0].empty(); }
+
+    // Filters count consecutive samples of sensor in place
+    void process(size_t sensor, double* values, size_t count, bool simd = true) {
+        for (SignalFilter& filter : filters[sensor]) {
+            input.assign(values, values + count);
+            filter.process(input.data(), values, count, simd);
+        }
+    }
+
+private:
+    std::vector<std::vector<SignalFilter>> filters;
+    std::vector<double> input;
+};